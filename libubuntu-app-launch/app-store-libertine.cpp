@@ -19,10 +19,15 @@
 
 #include "app-store-libertine.h"
 #include "application-impl-libertine.h"
+#include "registry-impl.h"
 #include "string-util.h"
 
 #include "libertine.h"
 
+#include <algorithm>
+#include <future>
+#include <sys/stat.h>
+
 namespace ubuntu
 {
 namespace app_launch
@@ -35,10 +40,141 @@ Libertine::Libertine(const std::shared_ptr<Registry::Impl>& registry)
 {
 }
 
+/** The monitors call back into us on the GLib thread, so they need to
+    be disconnected there to make sure none are in progress. If the
+    registry is gone so is its thread and nothing can call us. */
 Libertine::~Libertine()
 {
+    try
+    {
+        auto reg = getReg();
+        reg->thread.executeOnThread<bool>([this]() {
+            dropMonitors();
+            return true;
+        });
+    }
+    catch (std::runtime_error& e)
+    {
+        dropMonitors();
+    }
+}
+
+namespace
+{
+
+/** Asks liblibertine for the applications in a container and parses
+    them into AppIDs. This reads the container's data off of disk so it
+    is safe to call on any thread.
+
+    \param container Container name
+*/
+std::shared_ptr<std::vector<AppID>> appsForContainer(const std::string& container)
+{
+    auto retval = std::make_shared<std::vector<AppID>>();
+    auto apps = unique_gcharv(libertine_list_apps_for_container(container.c_str()));
+
+    for (int i = 0; apps && apps.get()[i] != nullptr; i++)
+    {
+        try
+        {
+            retval->emplace_back(AppID::parse(apps.get()[i]));
+        }
+        catch (std::runtime_error& e)
+        {
+            g_debug("Unable to parse libertine appid '%s': %s", apps.get()[i], e.what());
+        }
+    }
+
+    return retval;
+}
+
+/** Creates a monitor for a file or directory and connects the changed
+    signal to @callback. Must be called on the GLib thread.
+
+    \param path Path to monitor
+    \param directory Whether @path is a directory
+    \param callback Handler for the GFileMonitor::changed signal
+    \param user_data Data for @callback
+*/
+std::unique_ptr<GFileMonitor, unity::util::GObjectDeleter> monitorPath(const std::string& path,
+                                                                       bool directory,
+                                                                       GCallback callback,
+                                                                       gpointer user_data)
+{
+    auto gfile = unity::util::unique_gobject(g_file_new_for_path(path.c_str()));
+
+    GError* error = nullptr;
+    auto monitor = unity::util::unique_gobject(
+        directory ? g_file_monitor_directory(gfile.get(), G_FILE_MONITOR_WATCH_MOVES, nullptr, &error)
+                  : g_file_monitor_file(gfile.get(), G_FILE_MONITOR_NONE, nullptr, &error));
+
+    if (error != nullptr)
+    {
+        std::string message = std::string{"Unable to create file monitor for '"} + path + "': " + error->message;
+        g_error_free(error);
+        throw std::runtime_error{message};
+    }
+
+    g_signal_connect(monitor.get(), "changed", callback, user_data);
+
+    return monitor;
+}
+
+/** Adds a monitor for @path and every directory beneath it, as desktop
+    files can be in subdirectories of the applications directory.
+    Directories that are already in @directories are skipped, and we
+    don't follow symlinks back up to a directory we're already in.
+
+    \param path Directory to monitor
+    \param container Container name to put on the monitors
+    \param callback Handler for the GFileMonitor::changed signal
+    \param user_data Data for @callback
+    \param directories Paths that are already monitored, gets @path added
+    \param monitors Set to put the new monitors in
+    \param parents Device and inode of the directories above @path
+*/
+void monitorTree(const std::string& path,
+                 const std::string& container,
+                 GCallback callback,
+                 gpointer user_data,
+                 std::set<std::string>& directories,
+                 std::set<std::unique_ptr<GFileMonitor, unity::util::GObjectDeleter>>& monitors,
+                 std::set<std::pair<dev_t, ino_t>> parents = {})
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && !parents.emplace(info.st_dev, info.st_ino).second)
+    {
+        g_debug("Not monitoring '%s' in libertine container '%s', it loops", path.c_str(), container.c_str());
+        return;
+    }
+
+    if (directories.find(path) == directories.end())
+    {
+        auto monitor = monitorPath(path, true, callback, user_data);
+        g_object_set_data_full(G_OBJECT(monitor.get()), "container", g_strdup(container.c_str()), g_free);
+        monitors.insert(std::move(monitor));
+        directories.insert(path);
+    }
+
+    auto dir = unity::util::unique_glib(g_dir_open(path.c_str(), 0, nullptr));
+    if (!dir)
+    {
+        return;
+    }
+
+    const gchar* file;
+    while ((file = g_dir_read_name(dir.get())) != nullptr)
+    {
+        auto subpath = unique_gchar(g_build_filename(path.c_str(), file, nullptr));
+        if (g_file_test(subpath.get(), G_FILE_TEST_IS_DIR))
+        {
+            monitorTree(subpath.get(), container, callback, user_data, directories, monitors, parents);
+        }
+    }
 }
 
+}  // namespace
+
 /** Checks the AppID by making sure the version is "0.0" and then
     calling verifyAppname() to check the rest.
 
@@ -70,18 +206,8 @@ bool Libertine::hasAppId(const AppID& appid)
 */
 bool Libertine::verifyPackage(const AppID::Package& package)
 {
-    auto containers = unique_gcharv(libertine_list_containers());
-
-    for (int i = 0; containers.get()[i] != nullptr; i++)
-    {
-        auto container = containers.get()[i];
-        if (container == package.value())
-        {
-            return true;
-        }
-    }
-
-    return false;
+    auto list = containers();
+    return std::find(list->begin(), list->end(), package.value()) != list->end();
 }
 
 /** Gets the list of applications from the container using liblibertine
@@ -93,18 +219,15 @@ bool Libertine::verifyPackage(const AppID::Package& package)
 */
 bool Libertine::verifyAppname(const AppID::Package& package, const AppID::AppName& appname)
 {
-    auto apps = unique_gcharv(libertine_list_apps_for_container(package.value().c_str()));
-
-    for (int i = 0; apps.get()[i] != nullptr; i++)
+    if (!verifyPackage(package))
     {
-        auto appid = AppID::parse(apps.get()[i]);
-        if (appid.appname.value() == appname.value())
-        {
-            return true;
-        }
+        return false;
     }
 
-    return false;
+    auto apps = containerApps({package.value()})[package.value()];
+
+    return std::any_of(apps->begin(), apps->end(),
+                       [&appname](const AppID& appid) { return appid.appname.value() == appname.value(); });
 }
 
 /** We don't really have a way to implement this for Libertine, any
@@ -135,24 +258,20 @@ std::list<std::shared_ptr<Application>> Libertine::list()
     std::list<std::shared_ptr<Application>> applist;
 
     auto reg = getReg();
-    auto containers = unique_gcharv(libertine_list_containers());
 
-    for (int i = 0; containers.get()[i] != nullptr; i++)
+    for (const auto& container : containerApps(*containers()))
     {
-        auto container = containers.get()[i];
-        auto apps = unique_gcharv(libertine_list_apps_for_container(container));
-
-        for (int j = 0; apps.get()[j] != nullptr; j++)
+        for (const auto& appid : *container.second)
         {
             try
             {
-                auto appid = AppID::parse(apps.get()[j]);
                 auto sapp = std::make_shared<app_impls::Libertine>(appid.package, appid.appname, reg);
                 applist.emplace_back(sapp);
             }
             catch (std::runtime_error& e)
             {
-                g_debug("Unable to create application for libertine appname '%s': %s", apps.get()[j], e.what());
+                g_debug("Unable to create application for libertine appname '%s': %s",
+                        appid.appname.value().c_str(), e.what());
             }
         }
     }
@@ -165,6 +284,382 @@ std::shared_ptr<app_impls::Base> Libertine::create(const AppID& appid)
     return std::make_shared<app_impls::Libertine>(appid.package, appid.appname, getReg());
 }
 
+/** Gets the list of containers, using the cached version if the
+    configuration hasn't changed since it was last read. */
+std::shared_ptr<std::vector<std::string>> Libertine::containers()
+{
+    setupMonitors();
+
+    unsigned long generation;
+    {
+        std::lock_guard<std::mutex> lock(cacheLock_);
+        if (containers_)
+        {
+            return containers_;
+        }
+        generation = cacheGeneration_;
+    }
+
+    auto list = std::make_shared<std::vector<std::string>>();
+    auto containers = unique_gcharv(libertine_list_containers());
+    for (int i = 0; containers && containers.get()[i] != nullptr; i++)
+    {
+        list->emplace_back(containers.get()[i]);
+    }
+
+    /* We can only cache if we're going to hear about changes */
+    if (!configMonitor_ || !watchContainers(*list))
+    {
+        return list;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheLock_);
+    if (generation == cacheGeneration_)
+    {
+        containers_ = list;
+    }
+
+    return list;
+}
+
+/** Gets the applications for each of the containers. Containers that
+    aren't in the cache are all looked up in parallel as each one requires
+    reading its own metadata off of disk.
+
+    \param containers Containers to get the applications for
+*/
+std::map<std::string, std::shared_ptr<std::vector<AppID>>> Libertine::containerApps(
+    const std::vector<std::string>& containers)
+{
+    std::map<std::string, std::shared_ptr<std::vector<AppID>>> retval;
+    std::vector<std::string> missing;
+    unsigned long generation;
+
+    {
+        std::lock_guard<std::mutex> lock(cacheLock_);
+        generation = cacheGeneration_;
+
+        for (const auto& container : containers)
+        {
+            auto cached = containerApps_.find(container);
+            if (cached != containerApps_.end())
+            {
+                retval[container] = cached->second;
+            }
+            else
+            {
+                missing.push_back(container);
+            }
+        }
+    }
+
+    if (missing.empty())
+    {
+        return retval;
+    }
+
+    /* No reason to spin up a thread for a single container */
+    auto policy = missing.size() > 1 ? std::launch::async : std::launch::deferred;
+
+    std::vector<std::pair<std::string, std::future<std::shared_ptr<std::vector<AppID>>>>> lookups;
+    for (const auto& container : missing)
+    {
+        lookups.emplace_back(container, std::async(policy, appsForContainer, container));
+    }
+
+    for (auto& lookup : lookups)
+    {
+        retval[lookup.first] = lookup.second.get();
+    }
+
+    std::lock_guard<std::mutex> lock(cacheLock_);
+    /* A valid container list means the monitors for the containers in
+       it are setup and nothing has changed while we were looking */
+    if (containers_ && generation == cacheGeneration_)
+    {
+        for (const auto& container : missing)
+        {
+            if (std::find(containers_->begin(), containers_->end(), container) != containers_->end())
+            {
+                containerApps_[container] = retval[container];
+            }
+        }
+    }
+
+    return retval;
+}
+
+/** Makes sure we have monitors on the application directories of all the
+    containers in @containers and drops the ones for containers that have
+    been removed. Containers we already watch are walked again to pick up
+    directories that were created since.
+
+    \param containers The current list of containers
+*/
+bool Libertine::watchContainers(const std::vector<std::string>& containers)
+{
+    try
+    {
+        auto reg = getReg();
+        return reg->thread.executeOnThread<bool>([this, &containers]() {
+            bool allwatched = true;
+
+            for (auto it = containerMonitors_.begin(); it != containerMonitors_.end();)
+            {
+                if (std::find(containers.begin(), containers.end(), it->first) == containers.end())
+                {
+                    it = containerMonitors_.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+
+            for (const auto& container : containers)
+            {
+                try
+                {
+                    auto container_path = unique_gchar(libertine_container_path(container.c_str()));
+                    auto container_home = unique_gchar(libertine_container_home_path(container.c_str()));
+
+                    if (!container_path || !container_home)
+                    {
+                        throw std::runtime_error{"Unable to get paths for container"};
+                    }
+
+                    auto system_apps =
+                        unique_gchar(g_build_filename(container_path.get(), "usr", "share", "applications", nullptr));
+                    auto local_apps = unique_gchar(
+                        g_build_filename(container_home.get(), ".local", "share", "applications", nullptr));
+
+                    watchDirectory(container, system_apps.get());
+                    watchDirectory(container, local_apps.get());
+                }
+                catch (std::runtime_error& e)
+                {
+                    g_debug("Unable to monitor libertine container '%s': %s", container.c_str(), e.what());
+                    allwatched = false;
+                }
+            }
+
+            return allwatched;
+        });
+    }
+    catch (std::runtime_error& e)
+    {
+        g_debug("Unable to watch libertine containers: %s", e.what());
+        return false;
+    }
+}
+
+/** Adds monitors for @path and the directories beneath it that aren't
+    already watched for @container. Must be called on the GLib thread.
+
+    \param container Container name
+    \param path Directory in the container
+*/
+void Libertine::watchDirectory(const std::string& container, const std::string& path)
+{
+    auto& watch = containerMonitors_[container];
+    monitorTree(path, container, G_CALLBACK(&Libertine::containerMonitorChanged), this, watch.directories,
+                watch.monitors);
+}
+
+/** Handler for changes in a container's application directories. New
+    directories get watched as they can have desktop files too, and the
+    desktop files that changed get signaled up the stack. */
+void Libertine::containerMonitorChanged(
+    GFileMonitor* monitor, GFile* file, GFile* other, GFileMonitorEvent type, gpointer user_data)
+{
+    if (type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED || type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
+    {
+        return;
+    }
+
+    auto pthis = static_cast<Libertine*>(user_data);
+    std::string container = static_cast<const gchar*>(g_object_get_data(G_OBJECT(monitor), "container"));
+
+    if (type == G_FILE_MONITOR_EVENT_CREATED || type == G_FILE_MONITOR_EVENT_MOVED_IN)
+    {
+        auto path = unique_gchar(g_file_get_path(file));
+        if (path && g_file_test(path.get(), G_FILE_TEST_IS_DIR) &&
+            pthis->containerMonitors_.find(container) != pthis->containerMonitors_.end())
+        {
+            try
+            {
+                pthis->watchDirectory(container, path.get());
+            }
+            catch (std::runtime_error& e)
+            {
+                g_debug("Unable to monitor new directory '%s': %s", path.get(), e.what());
+            }
+        }
+    }
+
+    pthis->containerChanged(container);
+
+    if (type == G_FILE_MONITOR_EVENT_RENAMED)
+    {
+        pthis->desktopChanged(container, file, G_FILE_MONITOR_EVENT_MOVED_OUT);
+        pthis->desktopChanged(container, other, G_FILE_MONITOR_EVENT_MOVED_IN);
+    }
+    else
+    {
+        pthis->desktopChanged(container, file, type);
+    }
+}
+
+/** Turns a change to a desktop file in @container into the info watcher
+    signals, the same way the legacy store does for its directories.
+    Must be called on the GLib thread.
+
+    \param container Container name
+    \param file File that changed
+    \param type What happened to @file
+*/
+void Libertine::desktopChanged(const std::string& container, GFile* file, GFileMonitorEvent type)
+{
+    if (file == nullptr)
+    {
+        return;
+    }
+
+    auto cdesktopname = unique_gchar(g_file_get_basename(file));
+    std::string desktopname{cdesktopname ? cdesktopname.get() : ""};
+    const std::string suffix{".desktop"};
+    if (desktopname.size() <= suffix.size() ||
+        desktopname.compare(desktopname.size() - suffix.size(), suffix.size(), suffix) != 0)
+    {
+        return;
+    }
+
+    AppID appid{AppID::Package::from_raw(container),
+                AppID::AppName::from_raw(desktopname.substr(0, desktopname.size() - suffix.size())),
+                AppID::Version::from_raw("0.0")};
+
+    std::shared_ptr<Application> app;
+    try
+    {
+        app = std::make_shared<app_impls::Libertine>(appid.package, appid.appname, getReg());
+    }
+    catch (std::runtime_error& e)
+    {
+        g_debug("Libertine application '%s' is gone: %s", std::string(appid).c_str(), e.what());
+    }
+
+    switch (type)
+    {
+        case G_FILE_MONITOR_EVENT_CREATED:
+        case G_FILE_MONITOR_EVENT_MOVED_IN:
+            if (app)
+            {
+                appAdded_(app);
+            }
+            break;
+        case G_FILE_MONITOR_EVENT_CHANGED:
+            if (app)
+            {
+                infoChanged_(app);
+            }
+            break;
+        case G_FILE_MONITOR_EVENT_DELETED:
+        case G_FILE_MONITOR_EVENT_MOVED_OUT:
+            /* It could still be in the container's other directory */
+            if (app)
+            {
+                infoChanged_(app);
+            }
+            else
+            {
+                appRemoved_(appid);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/** Sets up a monitor on the libertine configuration file so that
+    we know when containers get added or removed. */
+void Libertine::setupMonitors()
+{
+    std::call_once(monitorsSetup_, [this]() {
+        try
+        {
+            auto reg = getReg();
+            configMonitor_ = reg->thread.executeOnThread<std::unique_ptr<GFileMonitor, unity::util::GObjectDeleter>>(
+                [this]() {
+                    auto config = unique_gchar(
+                        g_build_filename(g_get_user_data_dir(), "libertine", "ContainersConfig.json", nullptr));
+
+                    return monitorPath(
+                        config.get(), false,
+                        G_CALLBACK(+[](GFileMonitor*, GFile*, GFile*, GFileMonitorEvent type, gpointer user_data) {
+                            if (type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+                            {
+                                return;
+                            }
+
+                            auto pthis = static_cast<Libertine*>(user_data);
+                            pthis->configChanged();
+                        }),
+                        this);
+                });
+        }
+        catch (std::runtime_error& e)
+        {
+            g_debug("Unable to monitor libertine configuration, not caching: %s", e.what());
+        }
+    });
+}
+
+/** Disconnect from and free all of the monitors. Must be called on the
+    GLib thread if it is running. */
+void Libertine::dropMonitors()
+{
+    if (configMonitor_)
+    {
+        g_signal_handlers_disconnect_by_data(configMonitor_.get(), this);
+        configMonitor_.reset();
+    }
+
+    for (const auto& container : containerMonitors_)
+    {
+        for (const auto& monitor : container.second.monitors)
+        {
+            g_signal_handlers_disconnect_by_data(monitor.get(), this);
+        }
+    }
+    containerMonitors_.clear();
+}
+
+/** Drop everything, the containers could have changed or apps could
+    have been installed into them. */
+void Libertine::configChanged()
+{
+    g_debug("Libertine configuration changed");
+
+    std::lock_guard<std::mutex> lock(cacheLock_);
+    cacheGeneration_++;
+    containers_.reset();
+    containerApps_.clear();
+}
+
+/** An application directory in @container changed so we need to
+    reload its list of applications.
+
+    \param container Container name
+*/
+void Libertine::containerChanged(const std::string& container)
+{
+    g_debug("Libertine container '%s' changed", container.c_str());
+
+    std::lock_guard<std::mutex> lock(cacheLock_);
+    cacheGeneration_++;
+    containerApps_.erase(container);
+}
+
 }  // namespace app_store
 }  // namespace app_launch
 }  // namespace ubuntu
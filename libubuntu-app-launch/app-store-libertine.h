@@ -21,6 +21,14 @@
 
 #include "app-store-base.h"
 
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include <gio/gio.h>
+#include <unity/util/GObjectMemory.h>
+
 namespace ubuntu
 {
 namespace app_launch
@@ -46,6 +54,45 @@ public:
 
     /* Application Creation */
     virtual std::shared_ptr<app_impls::Base> create(const AppID& appid) override;
+
+private:
+    /** Protects the cached containers and their application lists */
+    std::mutex cacheLock_;
+    /** Incremented every time the cache is invalidated so that lookups
+        that started before a change don't store stale results */
+    unsigned long cacheGeneration_ = 0;
+    /** Cached list of containers, null if it needs to be reloaded */
+    std::shared_ptr<std::vector<std::string>> containers_;
+    /** Cached list of applications for each container */
+    std::map<std::string, std::shared_ptr<std::vector<AppID>>> containerApps_;
+
+    /** Monitor on the libertine containers configuration */
+    std::unique_ptr<GFileMonitor, unity::util::GObjectDeleter> configMonitor_;
+    std::once_flag monitorsSetup_;
+    /** Monitors on the application directories of a container */
+    struct ContainerMonitors
+    {
+        /** Paths of the directories being watched */
+        std::set<std::string> directories;
+        std::set<std::unique_ptr<GFileMonitor, unity::util::GObjectDeleter>> monitors;
+    };
+    /** Monitors for each container, only accessed on the GLib thread */
+    std::map<std::string, ContainerMonitors> containerMonitors_;
+
+    std::shared_ptr<std::vector<std::string>> containers();
+    std::map<std::string, std::shared_ptr<std::vector<AppID>>> containerApps(
+        const std::vector<std::string>& containers);
+    bool watchContainers(const std::vector<std::string>& containers);
+    void watchDirectory(const std::string& container, const std::string& path);
+    void setupMonitors();
+    void dropMonitors();
+
+    static void containerMonitorChanged(
+        GFileMonitor* monitor, GFile* file, GFile* other, GFileMonitorEvent type, gpointer user_data);
+
+    void configChanged();
+    void containerChanged(const std::string& container);
+    void desktopChanged(const std::string& container, GFile* file, GFileMonitorEvent type);
 };
 
 }  // namespace app_store
@@ -196,7 +196,7 @@ std::list<std::shared_ptr<Application>> Snap::list()
 
     auto lifecycleApps = reg->snapdInfo.appsForInterface(LIFECYCLE_INTERFACE);
 
-    auto lifecycleForApp = [&](const AppID& appID) {
+    auto lifecycleForApp = [&](const InternedAppID& appID) {
         auto iterator = lifecycleApps.find(appID);
         if (iterator == lifecycleApps.end())
         {
@@ -214,12 +214,12 @@ std::list<std::shared_ptr<Application>> Snap::list()
             auto interfaceInfo = std::make_tuple(xMirEnable, lifecycleForApp(id));
             try
             {
-                auto app = std::make_shared<app_impls::Snap>(id, reg, interfaceInfo);
+                auto app = std::make_shared<app_impls::Snap>(id.appid(), reg, interfaceInfo);
                 apps.emplace(app);
             }
             catch (std::runtime_error& e)
             {
-                g_debug("Unable to make Snap object for '%s': %s", std::string(id).c_str(), e.what());
+                g_debug("Unable to make Snap object for '%s': %s", id.str().c_str(), e.what());
             }
         }
     };
@@ -82,6 +82,10 @@ struct AppID
         anyting other than debug messages. */
     operator std::string() const;
 
+    /** The same string as the std::string conversion, sized up front so
+        it is built with a single allocation. */
+    std::string str() const;
+
     /** Turn the structure into a string suitable for use in DBus paths.
         Turn this back into an AppID with parseDBusID(). This is otherwise not
         a valid AppID string. */
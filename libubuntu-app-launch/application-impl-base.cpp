@@ -120,6 +120,13 @@ std::string Base::getInstance(const std::shared_ptr<app_info::Desktop>& desktop)
 
 std::shared_ptr<Application::Instance> Base::findInstance(const pid_t& pid)
 {
+    /* The jobs manager can usually tell from the PID alone */
+    auto found = registry_->jobs()->findInstanceByPid(pid);
+    if (found.first)
+    {
+        return found.first->appId() == appId() ? found.second : nullptr;
+    }
+
     for (auto instance : instances())
     {
         if (instance->hasPid(pid))
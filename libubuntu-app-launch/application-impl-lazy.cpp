@@ -0,0 +1,151 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "application-impl-lazy.h"
+#include "registry-impl.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+namespace app_impls
+{
+
+Lazy::Lazy(const std::string& sappid, const std::shared_ptr<Registry::Impl>& registry)
+    : sappid_(sappid)
+    , registry_(registry)
+{
+}
+
+/** Gets the AppID without creating the application. Fully qualified
+    AppIDs are just parsed, anything else needs the registry to find the
+    current version. If that fails the AppID is empty, and stays that way
+    without searching again. */
+AppID Lazy::appId() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+
+    if (!appidLookedUp_)
+    {
+        appid_ = AppID::parse(sappid_);
+        if (appid_.empty())
+        {
+            appid_ = registry_->find(sappid_);
+        }
+        appidLookedUp_ = true;
+    }
+
+    return appid_;
+}
+
+/** Asks the app stores if they have the AppID, the same check creating
+    the application does, without creating it. Only asked once, and not
+    at all if the application has already been created. */
+bool Lazy::valid()
+{
+    auto appid = appId();
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!checked_)
+    {
+        valid_ = !appid.empty() && std::any_of(registry_->appStores().begin(), registry_->appStores().end(),
+                                               [&appid](const std::shared_ptr<app_store::Base>& store) {
+                                                   return store->hasAppId(appid);
+                                               });
+        checked_ = true;
+    }
+
+    return valid_;
+}
+
+/** Creates the real application the first time it is called. This is
+    where an AppID no app store has gets found out, and that answer is
+    kept so using it again doesn't ask the stores again. */
+std::shared_ptr<Application> Lazy::app()
+{
+    auto appid = appId();
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!app_)
+    {
+        if (appid.empty() || (checked_ && !valid_))
+        {
+            throw std::runtime_error("Invalid app ID: " + sappid_);
+        }
+
+        try
+        {
+            app_ = registry_->createApp(appid);
+        }
+        catch (std::runtime_error&)
+        {
+            checked_ = true;
+            valid_ = false;
+            throw;
+        }
+
+        checked_ = true;
+        valid_ = true;
+    }
+
+    return app_;
+}
+
+bool Lazy::materialized() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return bool(app_);
+}
+
+std::shared_ptr<Application::Info> Lazy::info()
+{
+    return app()->info();
+}
+
+bool Lazy::hasInstances()
+{
+    return app()->hasInstances();
+}
+
+std::vector<std::shared_ptr<Application::Instance>> Lazy::instances()
+{
+    return app()->instances();
+}
+
+std::shared_ptr<Application::Instance> Lazy::launch(const std::vector<Application::URL>& urls)
+{
+    return app()->launch(urls);
+}
+
+std::shared_ptr<Application::Instance> Lazy::launchTest(const std::vector<Application::URL>& urls)
+{
+    return app()->launchTest(urls);
+}
+
+std::shared_ptr<Application::Instance> Lazy::findInstance(const pid_t& pid)
+{
+    return app()->findInstance(pid);
+}
+
+}  // namespace app_impls
+}  // namespace app_launch
+}  // namespace ubuntu
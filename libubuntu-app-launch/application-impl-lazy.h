@@ -0,0 +1,85 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include <mutex>
+
+#include "application.h"
+#include "registry.h"
+
+#pragma once
+
+namespace ubuntu
+{
+namespace app_launch
+{
+namespace app_impls
+{
+
+/** A stand in for an application that only does the work of finding and
+    creating the real application object the first time it is needed.
+    Used for the manager signals where most of the time only the AppID
+    is looked at, and creating the application can mean parsing desktop
+    files or talking to snapd.
+
+    If the application can't be created the functions that need it will
+    throw a std::runtime_error.
+*/
+class Lazy : public Application
+{
+public:
+    Lazy(const std::string& sappid, const std::shared_ptr<Registry::Impl>& registry);
+
+    AppID appId() const override;
+
+    std::shared_ptr<Info> info() override;
+
+    bool hasInstances() override;
+    std::vector<std::shared_ptr<Instance>> instances() override;
+
+    std::shared_ptr<Instance> launch(const std::vector<Application::URL>& urls = {}) override;
+    std::shared_ptr<Instance> launchTest(const std::vector<Application::URL>& urls = {}) override;
+
+    std::shared_ptr<Instance> findInstance(const pid_t& pid) override;
+
+    /** Whether the real application object has been created yet */
+    bool materialized() const;
+    /** Whether the AppID was found and an app store has it */
+    bool valid();
+
+private:
+    std::string sappid_;
+    std::shared_ptr<Registry::Impl> registry_;
+
+    mutable std::mutex lock_;
+    /** The AppID once we've looked it up, empty if it wasn't found */
+    mutable AppID appid_;
+    /** Set once we've looked for the AppID so a failed search isn't
+        repeated */
+    mutable bool appidLookedUp_ = false;
+    /** Set once we've asked the app stores about the AppID */
+    bool checked_ = false;
+    bool valid_ = false;
+    std::shared_ptr<Application> app_;
+
+    std::shared_ptr<Application> app();
+};
+
+}  // namespace app_impls
+}  // namespace app_launch
+}  // namespace ubuntu
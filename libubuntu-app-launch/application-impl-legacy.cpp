@@ -143,7 +143,7 @@ std::vector<std::shared_ptr<Application::Instance>> Legacy::instances()
     the exec line and whether it needs XMir. Also we set the path if that
     is specified in the desktop file. We can also set an AppArmor profile
     if requested. */
-std::list<std::pair<std::string, std::string>> Legacy::launchEnv(const std::string& instance)
+std::list<std::pair<std::string, std::string>> Legacy::buildLaunchEnv()
 {
     std::list<std::pair<std::string, std::string>> retval;
 
@@ -206,6 +206,26 @@ std::list<std::pair<std::string, std::string>> Legacy::launchEnv(const std::stri
         retval.emplace_back(std::make_pair("APP_EXEC_POLICY", "unconfined"));
     }
 
+    return retval;
+}
+
+/** Get the launch environment for an instance. Everything but the
+    instance comes from the desktop file, so that part is cached by
+    the registry until the desktop file changes. */
+std::list<std::pair<std::string, std::string>> Legacy::launchEnv(const std::string& instance)
+{
+    auto retval = *registry_->launchEnvTemplate(appId(), [this]() { return buildLaunchEnv(); });
+
+    /* The temporary directory was made when the environment was cached,
+       make sure nobody has cleaned it up since */
+    for (const auto& var : retval)
+    {
+        if (var.first == "TMPDIR")
+        {
+            g_mkdir_with_parents(var.second.c_str(), 0700);
+        }
+    }
+
     retval.emplace_back(std::make_pair("INSTANCE_ID", instance));
 
     return retval;
@@ -72,6 +72,7 @@ private:
     std::string desktopPath_;
     std::regex instanceRegex_;
 
+    std::list<std::pair<std::string, std::string>> buildLaunchEnv();
     std::list<std::pair<std::string, std::string>> launchEnv(const std::string& instance);
 };
 
@@ -24,6 +24,11 @@
 
 #include <unity/util/GlibMemory.h>
 
+#include <map>
+#include <mutex>
+
+#include <sys/stat.h>
+
 using namespace unity::util;
 
 namespace ubuntu
@@ -90,44 +95,225 @@ std::shared_ptr<GKeyFile> Libertine::keyfileFromPath(const std::string& pathname
     return keyfile;
 }
 
+namespace
+{
+
+/** The parts of a stat() we use to tell whether a file or directory
+    has changed since we last looked at it */
+struct FileStamp
+{
+    time_t sec = 0;
+    long nsec = 0;
+    off_t size = 0;
+
+    bool operator==(const FileStamp& other) const
+    {
+        return sec == other.sec && nsec == other.nsec && size == other.size;
+    }
+    bool operator!=(const FileStamp& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/** Get the stamp for @path, returns false if it doesn't exist */
+bool stampPath(const std::string& path, FileStamp& stamp)
+{
+    struct stat statbuf;
+    if (stat(path.c_str(), &statbuf) != 0)
+    {
+        return false;
+    }
+
+    stamp.sec = statbuf.st_mtim.tv_sec;
+    stamp.nsec = statbuf.st_mtim.tv_nsec;
+    stamp.size = statbuf.st_size;
+    return true;
+}
+
+/** Index of where the desktop files are in a directory tree. Built
+    in the same order as a recursive search would find them, so files
+    closer to the root shadow ones in subdirectories. */
+struct DesktopIndex
+{
+    /** A desktop file that we've found, and if we've loaded it, the keyfile
+        along with the stamp of the file when we loaded it */
+    struct Entry
+    {
+        std::string path;
+        FileStamp stamp;
+        std::shared_ptr<GKeyFile> keyfile;
+    };
+
+    bool built = false;
+    /** Filename to the desktop file entry */
+    std::map<std::string, Entry> files;
+    /** Directories that were scanned and their stamps when we scanned them */
+    std::map<std::string, FileStamp> dirs;
+};
+
+/** Indexes for all the directories we've looked in, keyed by the full
+    path of the directory */
+std::mutex indexesLock;
+std::map<std::string, DesktopIndex> indexes;
+
+/** Drops the indexes for directories that no longer exist, like those
+    of removed containers. Called with indexesLock held. */
+void pruneIndexes()
+{
+    for (auto it = indexes.begin(); it != indexes.end();)
+    {
+        FileStamp stamp;
+        if (!stampPath(it->first, stamp))
+        {
+            it = indexes.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+/** Walks @dirpath adding all the files to the index, files in the
+    directory itself are added before looking in subdirectories. */
+void indexDirectory(const std::string& dirpath, DesktopIndex& index)
+{
+    FileStamp dirstamp;
+    if (!stampPath(dirpath, dirstamp))
+    {
+        return;
+    }
+    index.dirs[dirpath] = dirstamp;
+
+    auto dir = unique_glib(g_dir_open(dirpath.c_str(), 0, nullptr));
+    if (!dir)
+    {
+        return;
+    }
+
+    std::list<std::string> subdirs;
+    const gchar* file;
+    while ((file = g_dir_read_name(dir.get())) != nullptr)
+    {
+        auto fullpath = unique_gchar(g_build_filename(dirpath.c_str(), file, nullptr));
+        if (g_file_test(fullpath.get(), G_FILE_TEST_IS_DIR))
+        {
+            subdirs.emplace_back(fullpath.get());
+        }
+        else if (g_file_test(fullpath.get(), G_FILE_TEST_IS_REGULAR))
+        {
+            DesktopIndex::Entry entry;
+            entry.path = fullpath.get();
+            index.files.emplace(file, entry);
+        }
+    }
+
+    for (const auto& subdir : subdirs)
+    {
+        indexDirectory(subdir, index);
+    }
+}
+
+/** Checks the stamps of all the directories we scanned, if any have
+    changed then files could have been added or removed */
+bool indexStale(const DesktopIndex& index)
+{
+    for (const auto& dir : index.dirs)
+    {
+        FileStamp stamp;
+        if (!stampPath(dir.first, stamp) || stamp != dir.second)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+}  // namespace
+
+/** Finds the desktop file named @filename in @subpath of @basepath or any
+    of its subdirectories. Once a directory has been indexed finding a known
+    desktop file is a single stat() and the keyfile is only reloaded if that
+    shows it has changed. We only rescan if we're asked for a file we don't
+    know about and the directories have changed since we last looked.
+
+    Asking for a file that isn't there stats each of the indexed
+    directories, as one could have been added to any of them. Indexes for
+    directories that have gone away are dropped.
+
+    \param basepath Directory to start in
+    \param subpath Path below @basepath to look in
+    \param filename Name of the desktop file
+*/
 std::shared_ptr<GKeyFile> Libertine::findDesktopFile(const std::string& basepath,
                                                      const std::string& subpath,
                                                      const std::string& filename)
 {
-    auto fullpath = unique_gchar(g_build_filename(basepath.c_str(), subpath.c_str(), filename.c_str(), nullptr));
-    std::string sfullpath(fullpath.get());
+    auto dirpath = unique_gchar(g_build_filename(basepath.c_str(), subpath.c_str(), nullptr));
 
-    if (g_file_test(sfullpath.c_str(), G_FILE_TEST_IS_REGULAR))
+    std::lock_guard<std::mutex> lock(indexesLock);
+
+    FileStamp dirstamp;
+    if (!stampPath(dirpath.get(), dirstamp))
     {
-        return keyfileFromPath(sfullpath);
+        indexes.erase(dirpath.get());
+        return {};
     }
 
-    GError* error = nullptr;
-    auto dirpath = unique_gchar(g_build_filename(basepath.c_str(), subpath.c_str(), nullptr));
-    auto dir = unique_glib(g_dir_open(dirpath.get(), 0, &error));
-    if (error != nullptr)
+    if (indexes.find(dirpath.get()) == indexes.end())
     {
-        g_error_free(error);
-        return {};
+        pruneIndexes();
     }
+    auto& index = indexes[dirpath.get()];
 
-    const gchar* file;
-    while ((file = g_dir_read_name(dir.get())) != nullptr)
+    auto rebuild = [&index, &dirpath]() {
+        index.files.clear();
+        index.dirs.clear();
+        indexDirectory(dirpath.get(), index);
+        index.built = true;
+    };
+
+    if (!index.built)
+    {
+        rebuild();
+    }
+
+    auto entry = index.files.find(filename);
+    if (entry == index.files.end())
     {
-        auto new_subpath = unique_gchar(g_build_filename(subpath.c_str(), file, nullptr));
-        auto new_fullpath = unique_gchar(g_build_filename(basepath.c_str(), new_subpath.get(), nullptr));
-        if (g_file_test(new_fullpath.get(), G_FILE_TEST_IS_DIR))
+        if (indexStale(index))
         {
-            auto desktop_file = findDesktopFile(basepath, new_subpath.get(), filename);
+            rebuild();
+            entry = index.files.find(filename);
+        }
 
-            if (desktop_file)
-            {
-                return desktop_file;
-            }
+        if (entry == index.files.end())
+        {
+            return {};
+        }
+    }
+
+    FileStamp stamp;
+    if (!stampPath(entry->second.path, stamp))
+    {
+        /* Removed, perhaps there is another one deeper in the tree */
+        rebuild();
+        entry = index.files.find(filename);
+        if (entry == index.files.end() || !stampPath(entry->second.path, stamp))
+        {
+            return {};
         }
     }
 
-    return {};
+    if (!entry->second.keyfile || stamp != entry->second.stamp)
+    {
+        entry->second.keyfile = keyfileFromPath(entry->second.path);
+        entry->second.stamp = stamp;
+    }
+
+    return entry->second.keyfile;
 }
 
 std::shared_ptr<Application::Info> Libertine::info()
@@ -150,7 +336,7 @@ std::vector<std::shared_ptr<Application::Instance>> Libertine::instances()
     can be overridden with the UBUNTU_APP_LAUNCH_LIBERTINE_LAUNCH
     environment variable.
 */
-std::list<std::pair<std::string, std::string>> Libertine::launchEnv()
+std::list<std::pair<std::string, std::string>> Libertine::buildLaunchEnv()
 {
     std::list<std::pair<std::string, std::string>> retval;
 
@@ -171,6 +357,15 @@ std::list<std::pair<std::string, std::string>> Libertine::launchEnv()
     auto execline = std::string(libertine_launch) + " \"--id=" + _container.value() + "\" " + desktopexec;
     retval.emplace_back(std::make_pair("APP_EXEC", execline));
 
+    return retval;
+}
+
+/** Get the launch environment, the container setup only changes when
+    the desktop file does so it comes from the registry's cache */
+std::list<std::pair<std::string, std::string>> Libertine::launchEnv()
+{
+    auto retval = *registry_->launchEnvTemplate(appId(), [this]() { return buildLaunchEnv(); });
+
     /* TODO: Go multi instance */
     retval.emplace_back(std::make_pair("INSTANCE_ID", ""));
 
@@ -76,8 +76,11 @@ private:
     std::string _basedir;
     std::shared_ptr<app_info::Desktop> appinfo_;
 
+    std::list<std::pair<std::string, std::string>> buildLaunchEnv();
     std::list<std::pair<std::string, std::string>> launchEnv();
     static std::shared_ptr<GKeyFile> keyfileFromPath(const std::string& pathname);
+    /* Looks up the desktop file in a per-directory index of desktop file
+       locations, only touching the filesystem when something has changed. */
     static std::shared_ptr<GKeyFile> findDesktopFile(const std::string& basepath,
                                                      const std::string& subpath,
                                                      const std::string& filename);
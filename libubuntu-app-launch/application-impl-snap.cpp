@@ -204,7 +204,7 @@ Snap::Snap(const AppID& appid, const std::shared_ptr<Registry::Impl>& registry,
 
     info_ = std::make_shared<SnapInfo>(appid_, registry_, interfaceInfo, pkgInfo_->directory);
 
-    g_debug("Application Snap object for AppID '%s'", std::string(appid).c_str());
+    g_debug("Application Snap object for AppID '%s'", appid.str().c_str());
 }
 
 /** Uses the findInterfaceInfo() function to find the interface if we don't
@@ -286,10 +286,10 @@ std::vector<std::shared_ptr<Application::Instance>> Snap::instances()
     return std::vector<std::shared_ptr<Application::Instance>>(vbase.begin(), vbase.end());
 }
 
-/** Return the launch environment for this snap. That includes whether
+/** Build the launch environment for this snap. That includes whether
     or not it needs help from XMir (including Libertine helpers)
 */
-std::list<std::pair<std::string, std::string>> Snap::launchEnv()
+std::list<std::pair<std::string, std::string>> Snap::buildLaunchEnv()
 {
     g_debug("Getting snap specific environment");
     std::list<std::pair<std::string, std::string>> retval;
@@ -318,6 +318,16 @@ std::list<std::pair<std::string, std::string>> Snap::launchEnv()
     return retval;
 }
 
+/** Return the launch environment for this snap from the registry's
+    cache. It is the same for every launch of a revision with the same
+    interfaces connected, and those can change without a new revision,
+    so the XMir setting they give us is part of the key. */
+std::list<std::pair<std::string, std::string>> Snap::launchEnv()
+{
+    return *registry_->launchEnvTemplate(appid_, [this]() { return buildLaunchEnv(); },
+                                         info_->xMirEnable().value() ? "xmir" : "");
+}
+
 /** Create a new instance of this Snap
 
     \param urls URLs to pass to the command
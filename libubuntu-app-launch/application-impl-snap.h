@@ -79,6 +79,7 @@ private:
     /** Information that we get from Snapd on the package */
     std::shared_ptr<snapd::Info::PkgInfo> pkgInfo_;
 
+    std::list<std::pair<std::string, std::string>> buildLaunchEnv();
     std::list<std::pair<std::string, std::string>> launchEnv();
 };
 
@@ -28,10 +28,8 @@ extern "C" {
 #include "registry.h"
 
 #include <functional>
-#include <iomanip>
 #include <iostream>
-#include <locale>
-#include <regex>
+#include <sstream>
 
 namespace ubuntu
 {
@@ -67,22 +65,154 @@ AppID::AppID(Package pkg, AppName app, Version ver)
 {
 }
 
-#define REGEX_PKGNAME "([a-z0-9][a-z0-9+.-]+)"
-#define REGEX_APPNAME "([A-Za-z0-9+-.:~-][\\sA-Za-z0-9+-.:~-]+)"
-#define REGEX_VERSION "([\\d+:]?[A-Za-z0-9.+:~-]+?(?:-[A-Za-z0-9+.~]+)?)"
+namespace
+{
+
+/* Hand written versions of the regular expressions that AppIDs were
+   matched with, they accept exactly the same strings:
+
+     package  ([a-z0-9][a-z0-9+.-]+)
+     appname  ([A-Za-z0-9+-.:~-][\sA-Za-z0-9+-.:~-]+)
+     version  ([\d+:]?[A-Za-z0-9.+:~-]+?(?:-[A-Za-z0-9+.~]+)?)
+
+   In the appname '+-.' is a range, so it includes ','. Everything the
+   version allows is in its middle set, so it is any run of those. None
+   of them include '_', which makes splitting on it unambiguous. */
+
+/** Part of a string, without copying it */
+struct Part
+{
+    const char* data;
+    std::size_t size;
+};
+
+inline bool isAlnum(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+bool validPackage(const Part& part)
+{
+    auto first = part.size > 0 ? part.data[0] : '\0';
+    if (part.size < 2 || !((first >= 'a' && first <= 'z') || (first >= '0' && first <= '9')))
+    {
+        return false;
+    }
+
+    for (std::size_t i = 1; i < part.size; i++)
+    {
+        auto c = part.data[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '.' || c == '-'))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+inline bool isAppNameChar(char c)
+{
+    return isAlnum(c) || (c >= '+' && c <= '.') || c == ':' || c == '~';
+}
+
+bool validAppName(const Part& part)
+{
+    if (part.size < 2 || !isAppNameChar(part.data[0]))
+    {
+        return false;
+    }
+
+    for (std::size_t i = 1; i < part.size; i++)
+    {
+        auto c = part.data[i];
+        if (!(isAppNameChar(c) || c == ' ' || (c >= '\t' && c <= '\r')))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
 
-const std::regex full_appid_regex("^" REGEX_PKGNAME "_" REGEX_APPNAME "_" REGEX_VERSION "$");
-const std::regex short_appid_regex("^" REGEX_PKGNAME "_" REGEX_APPNAME "$");
-const std::regex legacy_appid_regex("^" REGEX_APPNAME "$");
+bool validVersion(const Part& part)
+{
+    if (part.size < 1)
+    {
+        return false;
+    }
+
+    for (std::size_t i = 0; i < part.size; i++)
+    {
+        auto c = part.data[i];
+        if (!(isAlnum(c) || c == '.' || c == '+' || c == ':' || c == '~' || c == '-'))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** Splits the string on '_', returning the number of parts or zero if
+    there are more than three */
+std::size_t splitAppID(const std::string& sappid, Part (&parts)[3])
+{
+    std::size_t count = 0;
+    std::size_t start = 0;
+
+    while (true)
+    {
+        auto end = sappid.find('_', start);
+        if (count == 3)
+        {
+            return 0;
+        }
+
+        parts[count++] = {sappid.data() + start, (end == std::string::npos ? sappid.size() : end) - start};
+
+        if (end == std::string::npos)
+        {
+            return count;
+        }
+        start = end + 1;
+    }
+}
+
+inline std::string partString(const Part& part)
+{
+    return std::string(part.data, part.size);
+}
+
+const char hexDigits[] = "0123456789abcdef";
+
+inline int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+}  // namespace
 
 AppID AppID::parse(const std::string& sappid)
 {
-    std::smatch match;
+    Part parts[3];
 
-    if (std::regex_match(sappid, match, full_appid_regex))
+    if (splitAppID(sappid, parts) == 3 && validPackage(parts[0]) && validAppName(parts[1]) && validVersion(parts[2]))
     {
-        return {AppID::Package::from_raw(match[1].str()), AppID::AppName::from_raw(match[2].str()),
-                AppID::Version::from_raw(match[3].str())};
+        return {AppID::Package::from_raw(partString(parts[0])), AppID::AppName::from_raw(partString(parts[1])),
+                AppID::Version::from_raw(partString(parts[2]))};
     }
     else
     {
@@ -93,7 +223,10 @@ AppID AppID::parse(const std::string& sappid)
 
 bool AppID::valid(const std::string& sappid)
 {
-    return std::regex_match(sappid, full_appid_regex);
+    Part parts[3];
+
+    return splitAppID(sappid, parts) == 3 && validPackage(parts[0]) && validAppName(parts[1]) &&
+           validVersion(parts[2]);
 }
 
 AppID AppID::find(const std::string& sappid)
@@ -109,18 +242,19 @@ AppID AppID::find(const std::shared_ptr<Registry>& registry, const std::string&
 
 AppID Registry::Impl::find(const std::string& sappid)
 {
-    std::smatch match;
+    Part parts[3];
+    auto count = splitAppID(sappid, parts);
 
-    if (std::regex_match(sappid, match, full_appid_regex))
+    if (count == 3 && validPackage(parts[0]) && validAppName(parts[1]) && validVersion(parts[2]))
     {
-        return {AppID::Package::from_raw(match[1].str()), AppID::AppName::from_raw(match[2].str()),
-                AppID::Version::from_raw(match[3].str())};
+        return {AppID::Package::from_raw(partString(parts[0])), AppID::AppName::from_raw(partString(parts[1])),
+                AppID::Version::from_raw(partString(parts[2]))};
     }
-    else if (std::regex_match(sappid, match, short_appid_regex))
+    else if (count == 2 && validPackage(parts[0]) && validAppName(parts[1]))
     {
-        return discover(match[1].str(), match[2].str(), AppID::VersionWildcard::CURRENT_USER_VERSION);
+        return discover(partString(parts[0]), partString(parts[1]), AppID::VersionWildcard::CURRENT_USER_VERSION);
     }
-    else if (std::regex_match(sappid, match, legacy_appid_regex))
+    else if (count == 1 && validAppName(parts[0]))
     {
         return {AppID::Package::from_raw({}), AppID::AppName::from_raw(sappid), AppID::Version::from_raw({})};
     }
@@ -130,21 +264,22 @@ AppID Registry::Impl::find(const std::string& sappid)
     }
 }
 
-AppID::operator std::string() const
+std::string AppID::str() const
 {
     if (package.value().empty() && version.value().empty())
     {
-        if (appname.value().empty())
-        {
-            return {};
-        }
-        else
-        {
-            return appname.value();
-        }
+        return appname.value();
     }
 
-    return package.value() + "_" + appname.value() + "_" + version.value();
+    std::string built;
+    built.reserve(package.value().size() + appname.value().size() + version.value().size() + 2);
+    built.append(package.value()).append(1, '_').append(appname.value()).append(1, '_').append(version.value());
+    return built;
+}
+
+AppID::operator std::string() const
+{
+    return str();
 }
 
 std::string AppID::persistentID() const
@@ -161,25 +296,46 @@ std::string AppID::persistentID() const
         }
     }
 
-    return package.value() + "_" + appname.value();
+    std::string retval;
+    retval.reserve(package.value().size() + appname.value().size() + 1);
+    retval.append(package.value()).append(1, '_').append(appname.value());
+    return retval;
 }
 
 std::string AppID::dbusID() const
 {
-    std::string bytes = operator std::string();
+    std::string bytes = str();
+
+    auto keep = [](char chr, std::size_t i) { return isAlnum(chr) && !(i == 0 && chr >= '0' && chr <= '9'); };
+
+    /* Size it first so we only allocate once */
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < bytes.size(); ++i)
+    {
+        /* Bytes above 0x7f are negative when char is signed and print as
+           eight hex digits, like they did through std::ostringstream */
+        size += keep(bytes[i], i) ? 1 : (int(bytes[i]) < 0 ? 9 : 3);
+    }
+
     std::string encoded;
+    encoded.reserve(size);
 
-    for (size_t i = 0; i < bytes.size(); ++i) {
+    for (std::size_t i = 0; i < bytes.size(); ++i)
+    {
         char chr = bytes[i];
 
-        if (std::isalpha(chr, std::locale::classic()) ||
-            (std::isdigit(chr, std::locale::classic()) && i != 0)) {
+        if (keep(chr, i))
+        {
             encoded += chr;
-        } else {
-            std::ostringstream hex;
-            hex << std::setw(2) << std::setfill('0') << std::hex;
-            hex << int(chr);
-            encoded += '_' + hex.str();
+        }
+        else
+        {
+            auto value = static_cast<unsigned int>(int(chr));
+            encoded += '_';
+            for (int shift = (int(chr) < 0 ? 28 : 4); shift >= 0; shift -= 4)
+            {
+                encoded += hexDigits[(value >> shift) & 0xf];
+            }
         }
     }
 
@@ -189,17 +345,33 @@ std::string AppID::dbusID() const
 AppID AppID::parseDBusID(const std::string& dbusid)
 {
     std::string decoded;
+    decoded.reserve(dbusid.size());
 
-    for (size_t i = 0; i < dbusid.size(); ++i) {
+    for (size_t i = 0; i < dbusid.size(); ++i)
+    {
         char chr = dbusid[i];
 
-        if (chr == '_' && i + 2 < dbusid.size()) {
-            int result;
-            std::istringstream hex(dbusid.substr(i + 1, 2));
-            hex >> std::hex >> result;
-            decoded += (char)result;
+        if (chr == '_' && i + 2 < dbusid.size())
+        {
+            auto high = hexValue(dbusid[i + 1]);
+            auto low = hexValue(dbusid[i + 2]);
+
+            if (high >= 0 && low >= 0)
+            {
+                decoded += char(high << 4 | low);
+            }
+            else
+            {
+                /* Not something dbusID() made, decode it the way we always have */
+                int result;
+                std::istringstream hex(dbusid.substr(i + 1, 2));
+                hex >> std::hex >> result;
+                decoded += (char)result;
+            }
             i += 2;
-        } else {
+        }
+        else
+        {
             decoded += chr;
         }
     }
@@ -219,10 +391,10 @@ bool operator!=(const AppID& a, const AppID& b)
            a.version.value() != b.version.value();
 }
 
-/** Convert each AppID to a string and then compare the strings */
+/** Compare the string forms of the AppIDs */
 bool operator<(const AppID& a, const AppID& b)
 {
-    return std::string(a) < std::string(b);
+    return a.str() < b.str();
 }
 
 bool AppID::empty() const
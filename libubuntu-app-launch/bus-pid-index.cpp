@@ -0,0 +1,248 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "bus-pid-index.h"
+
+#include <unity/util/GlibMemory.h>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+namespace
+{
+
+/** Data for a GetConnectionUnixProcessID call in flight */
+struct PidRequest
+{
+    BusPidIndex* index;
+    std::string name;
+};
+
+}  // namespace
+
+BusPidIndex::BusPidIndex(GLib::ContextThread& thread, const std::shared_ptr<GDBusConnection>& bus)
+    : thread_(thread)
+    , bus_(bus)
+    , cancel_(g_cancellable_new(), [](GCancellable* cancel) {
+        if (cancel != nullptr)
+        {
+            g_cancellable_cancel(cancel);
+            g_object_unref(cancel);
+        }
+    })
+{
+    /* Subscribe before listing so that we don't miss names that come or
+       go while the list is on its way back, the bus delivers both in order */
+    handle_nameOwnerChanged = managedDBusSignalConnection(
+        g_dbus_connection_signal_subscribe(
+            bus_.get(),              /* bus */
+            "org.freedesktop.DBus",  /* sender */
+            "org.freedesktop.DBus",  /* interface */
+            "NameOwnerChanged",      /* signal */
+            "/org/freedesktop/DBus", /* path */
+            nullptr,                 /* arg0 */
+            G_DBUS_SIGNAL_FLAGS_NONE,
+            [](GDBusConnection*, const gchar*, const gchar*, const gchar*, const gchar*, GVariant* params,
+               gpointer user_data) -> void {
+                auto pthis = static_cast<BusPidIndex*>(user_data);
+                GLib::ContextThread::CallbackTimer timer(pthis->thread_);
+
+                if (!g_variant_check_format_string(params, "(sss)", FALSE))
+                {
+                    return;
+                }
+
+                const gchar* name{nullptr};
+                const gchar* oldowner{nullptr};
+                const gchar* newowner{nullptr};
+                g_variant_get(params, "(&s&s&s)", &name, &oldowner, &newowner);
+
+                /* Well known names move between connections, we only
+                   care about the connections themselves */
+                if (!g_dbus_is_unique_name(name))
+                {
+                    return;
+                }
+
+                if (newowner[0] == '\0')
+                {
+                    pthis->nameRemoved(name);
+                }
+                else
+                {
+                    pthis->nameAdded(name);
+                }
+            },        /* callback */
+            this,     /* user data */
+            nullptr), /* user data destroy */
+        bus_);
+
+    g_dbus_connection_call(bus_.get(),             /* bus */
+                           "org.freedesktop.DBus", /* name */
+                           "/",                    /* path */
+                           "org.freedesktop.DBus", /* interface */
+                           "ListNames",            /* method */
+                           nullptr,                /* params */
+                           G_VARIANT_TYPE("(as)"), /* return type */
+                           G_DBUS_CALL_FLAGS_NONE, /* flags */
+                           -1,                     /* timeout */
+                           cancel_.get(),          /* cancellable */
+                           listNamesCb,            /* callback */
+                           this);                  /* user data */
+}
+
+void BusPidIndex::listNamesCb(GObject* obj, GAsyncResult* res, gpointer user_data)
+{
+    GError* error{nullptr};
+    auto listnames = unity::util::unique_glib(g_dbus_connection_call_finish(G_DBUS_CONNECTION(obj), res, &error));
+
+    if (error != nullptr)
+    {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            g_warning("Unable to get list of names from DBus: %s", error->message);
+        }
+        g_error_free(error);
+        return;
+    }
+
+    auto pthis = static_cast<BusPidIndex*>(user_data);
+    GLib::ContextThread::CallbackTimer timer(pthis->thread_);
+
+    GVariantIter* iter{nullptr};
+    const gchar* name{nullptr};
+    g_variant_get(listnames.get(), "(as)", &iter);
+    while (g_variant_iter_loop(iter, "&s", &name))
+    {
+        if (g_dbus_is_unique_name(name))
+        {
+            pthis->nameAdded(name);
+        }
+    }
+    g_variant_iter_free(iter);
+
+    pthis->listed_ = true;
+    g_debug("Bus PID index listed %zu connections", pthis->byName_.size());
+}
+
+/** A connection showed up, ask the bus who it is unless we already have */
+void BusPidIndex::nameAdded(const std::string& name)
+{
+    if (byName_.find(name) != byName_.end())
+    {
+        return;
+    }
+
+    byName_[name] = 0;
+    pending_++;
+
+    g_dbus_connection_call(bus_.get(),                         /* bus */
+                           "org.freedesktop.DBus",             /* name */
+                           "/",                                /* path */
+                           "org.freedesktop.DBus",             /* interface */
+                           "GetConnectionUnixProcessID",       /* method */
+                           g_variant_new("(s)", name.c_str()), /* params */
+                           G_VARIANT_TYPE("(u)"),              /* return type */
+                           G_DBUS_CALL_FLAGS_NONE,             /* flags */
+                           -1,                                 /* timeout */
+                           cancel_.get(),                      /* cancellable */
+                           pidCb,                              /* callback */
+                           new PidRequest{this, name});        /* user data */
+}
+
+void BusPidIndex::pidCb(GObject* obj, GAsyncResult* res, gpointer user_data)
+{
+    std::unique_ptr<PidRequest> request(static_cast<PidRequest*>(user_data));
+
+    GError* error{nullptr};
+    auto vpid = unity::util::unique_glib(g_dbus_connection_call_finish(G_DBUS_CONNECTION(obj), res, &error));
+
+    if (error != nullptr && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        g_error_free(error);
+        return;
+    }
+
+    GLib::ContextThread::CallbackTimer timer(request->index->thread_);
+    request->index->pending_--;
+
+    if (error != nullptr)
+    {
+        /* Most likely it went away before we asked */
+        g_debug("Unable to query PID for dbus name '%s': %s", request->name.c_str(), error->message);
+        g_error_free(error);
+        request->index->nameRemoved(request->name);
+        return;
+    }
+
+    guint pid{0};
+    g_variant_get(vpid.get(), "(u)", &pid);
+    request->index->pidReceived(request->name, pid);
+}
+
+void BusPidIndex::pidReceived(const std::string& name, pid_t pid)
+{
+    auto entry = byName_.find(name);
+    if (entry == byName_.end())
+    {
+        /* Left before we heard back */
+        return;
+    }
+
+    entry->second = pid;
+    byPid_[pid].insert(name);
+}
+
+void BusPidIndex::nameRemoved(const std::string& name)
+{
+    auto entry = byName_.find(name);
+    if (entry == byName_.end())
+    {
+        return;
+    }
+
+    auto names = byPid_.find(entry->second);
+    if (names != byPid_.end())
+    {
+        names->second.erase(name);
+        if (names->second.empty())
+        {
+            byPid_.erase(names);
+        }
+    }
+
+    byName_.erase(entry);
+}
+
+/** Get the unique names that are owned by a PID */
+std::vector<std::string> BusPidIndex::connections(pid_t pid) const
+{
+    auto names = byPid_.find(pid);
+    if (names == byPid_.end())
+    {
+        return {};
+    }
+
+    return std::vector<std::string>(names->second.begin(), names->second.end());
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
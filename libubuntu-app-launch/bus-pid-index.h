@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gio/gio.h>
+#include <sys/types.h>
+
+#include "glib-thread.h"
+#include "signal-unsubscriber.h"
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** Index of the unique names on the session bus by the PID that owns
+    them. The bus is listed once when the index is created and after that
+    it is kept up to date from NameOwnerChanged, so finding the connections
+    of an application doesn't need a query for each name on the bus.
+
+    Everything here must be used on the registry's thread. */
+class BusPidIndex
+{
+public:
+    BusPidIndex(GLib::ContextThread& thread, const std::shared_ptr<GDBusConnection>& bus);
+
+    /** Whether the index knows the PID of every name on the bus. While
+        it is still asking about some of them a lookup can miss. */
+    bool ready() const
+    {
+        return listed_ && pending_ == 0;
+    }
+
+    std::vector<std::string> connections(pid_t pid) const;
+
+    /** Number of unique names in the index */
+    std::size_t size() const
+    {
+        return byName_.size();
+    }
+
+private:
+    GLib::ContextThread& thread_;
+    std::shared_ptr<GDBusConnection> bus_;
+    /** Cancelled when we go away so outstanding calls don't call back
+        into a deleted index */
+    std::shared_ptr<GCancellable> cancel_;
+    ManagedDBusSignalConnection handle_nameOwnerChanged{DBusSignalUnsubscriber{}};
+
+    /** PID for each unique name, zero while we're asking for it */
+    std::unordered_map<std::string, pid_t> byName_;
+    /** Unique names for each PID */
+    std::unordered_map<pid_t, std::set<std::string>> byPid_;
+    /** Whether we've got the initial list of names */
+    bool listed_ = false;
+    /** Number of PID requests that haven't returned */
+    std::size_t pending_ = 0;
+
+    void nameAdded(const std::string& name);
+    void nameRemoved(const std::string& name);
+    void pidReceived(const std::string& name, pid_t pid);
+
+    static void listNamesCb(GObject* obj, GAsyncResult* res, gpointer user_data);
+    static void pidCb(GObject* obj, GAsyncResult* res, gpointer user_data);
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
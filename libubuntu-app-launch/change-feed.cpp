@@ -0,0 +1,84 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "change-feed.h"
+
+#include <stdexcept>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+ChangeFeed::ChangeFeed(std::size_t capacity)
+    : ring_(capacity)
+{
+    if (capacity == 0)
+    {
+        throw std::runtime_error{"Change feed needs room for at least one change"};
+    }
+}
+
+/** Add a change to the feed, replacing the oldest if it is full
+
+    \param change Change to add, its sequence number is set here
+*/
+std::uint64_t ChangeFeed::add(Registry::Change change)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+
+    change.sequence = ++last_;
+    ring_[change.sequence % ring_.size()] = std::move(change);
+
+    return last_;
+}
+
+/** Copy the changes after a sequence number
+
+    \param after Last sequence number the caller has seen
+    \param changes Changes after \p after are added to the end
+    \return False if some of the changes after \p after have been
+            dropped, or \p after is from a different feed
+*/
+bool ChangeFeed::since(std::uint64_t after, std::vector<Registry::Change>& changes) const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+
+    if (after > last_)
+    {
+        return false;
+    }
+
+    std::uint64_t oldest = last_ >= ring_.size() ? last_ - ring_.size() + 1 : 1;
+    if (after + 1 < oldest)
+    {
+        return false;
+    }
+
+    changes.reserve(changes.size() + (last_ - after));
+    for (auto seq = after + 1; seq <= last_; seq++)
+    {
+        changes.emplace_back(ring_[seq % ring_.size()]);
+    }
+
+    return true;
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
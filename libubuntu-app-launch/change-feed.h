@@ -0,0 +1,65 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "registry.h"
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** Ordered feed of the changes to running instances. Each change gets
+    the next sequence number when it is added and they're kept in a ring
+    so that the oldest are dropped when it is full. Changes are added on
+    the registry's thread but can be read from any thread. */
+class ChangeFeed
+{
+public:
+    explicit ChangeFeed(std::size_t capacity);
+
+    std::uint64_t add(Registry::Change change);
+    bool since(std::uint64_t after, std::vector<Registry::Change>& changes) const;
+
+    /** Sequence number of the last change added, zero if there are none */
+    std::uint64_t sequence() const
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        return last_;
+    }
+
+    std::size_t capacity() const
+    {
+        return ring_.size();
+    }
+
+private:
+    mutable std::mutex lock_;
+    /** Change N is at N % capacity */
+    std::vector<Registry::Change> ring_;
+    std::uint64_t last_{0};
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
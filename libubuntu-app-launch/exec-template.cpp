@@ -0,0 +1,291 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "exec-template.h"
+
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+#include <glib.h>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** Number of Exec lines we'll keep compiled */
+static const std::size_t maxCachedTemplates{128};
+
+/** Split the Exec line into arguments and find the field codes in them.
+    Throws a std::runtime_error if the line can't be parsed. */
+ExecTemplate::ExecTemplate(const std::string& execline)
+{
+    GError* error{nullptr};
+    gchar** splitexec{nullptr};
+    gint execitems{0};
+
+    /* Undo the desktop file quoting, each string is then its own argument */
+    g_shell_parse_argv(execline.c_str(), &execitems, &splitexec, &error);
+
+    if (error != nullptr)
+    {
+        auto message = std::string{"Unable to parse exec line '"} + execline + "': " + error->message;
+        g_error_free(error);
+        throw std::runtime_error{message};
+    }
+
+    args_.reserve(execitems);
+    for (gint i = 0; i < execitems; i++)
+    {
+        std::string segment{splitexec[i]};
+
+        /* No empty strings */
+        if (segment.empty())
+        {
+            continue;
+        }
+
+        args_.emplace_back(compileArg(segment));
+    }
+
+    g_strfreev(splitexec);
+}
+
+/** Look at a single argument for field codes */
+ExecTemplate::Arg ExecTemplate::compileArg(const std::string& segment)
+{
+    /* Handle %F and %U as an argument on their own as per the spec */
+    if (segment == "%U")
+    {
+        return {Arg::Type::URI_LIST, {}};
+    }
+    if (segment == "%F")
+    {
+        return {Arg::Type::FILE_LIST, {}};
+    }
+
+    Arg arg{Arg::Type::PIECES, {}};
+
+    auto appendLiteral = [&arg](const std::string& text) {
+        if (text.empty())
+        {
+            return;
+        }
+        if (!arg.pieces.empty() && arg.pieces.back().type == Piece::Type::LITERAL)
+        {
+            arg.pieces.back().text += text;
+        }
+        else
+        {
+            arg.pieces.push_back(Piece{Piece::Type::LITERAL, text});
+        }
+    };
+
+    auto percent = segment.find('%');
+    appendLiteral(segment.substr(0, percent));
+
+    bool previousPercent = false;
+    while (percent != std::string::npos)
+    {
+        auto start = percent + 1;
+        percent = segment.find('%', start);
+        auto chunk = segment.substr(start, percent == std::string::npos ? std::string::npos : percent - start);
+
+        /* Handle the case of %%F printing "%F" */
+        if (previousPercent)
+        {
+            appendLiteral(chunk);
+            previousPercent = false;
+            continue;
+        }
+
+        if (chunk.empty())
+        {
+            /* %% is the literal */
+            appendLiteral("%");
+            previousPercent = true;
+            continue;
+        }
+
+        switch (chunk[0])
+        {
+            case 'f':
+                arg.pieces.push_back(Piece{Piece::Type::FILE, {}});
+                break;
+            case 'u':
+                arg.pieces.push_back(Piece{Piece::Type::URI, {}});
+                break;
+            case 'd':
+            case 'D':
+            case 'n':
+            case 'N':
+            case 'v':
+            case 'm':
+                /* Deprecated */
+            case 'i':
+            case 'c':
+            case 'k':
+                /* Perhaps?  Not sure anyone uses these */
+                break;
+            case 'F':
+                g_warning("Exec line segment has a '%%F' that isn't its own argument '%s', ignoring.", segment.c_str());
+                break;
+            case 'U':
+                g_warning("Exec line segment has a '%%U' that isn't its own argument '%s', ignoring.", segment.c_str());
+                break;
+            default:
+                g_warning("Desktop Exec line code '%%%c' unknown, skipping.", chunk[0]);
+                break;
+        }
+
+        appendLiteral(chunk.substr(1));
+    }
+
+    return arg;
+}
+
+/** Get the compiled template for an Exec line. Applications get launched
+    with the same Exec line each time so we keep them around. */
+std::shared_ptr<const ExecTemplate> ExecTemplate::compile(const std::string& execline)
+{
+    static std::mutex cacheLock;
+    static std::map<std::string, std::shared_ptr<const ExecTemplate>> cache;
+
+    {
+        std::lock_guard<std::mutex> lock(cacheLock);
+        auto it = cache.find(execline);
+        if (it != cache.end())
+        {
+            return it->second;
+        }
+    }
+
+    auto compiled = std::make_shared<const ExecTemplate>(execline);
+
+    std::lock_guard<std::mutex> lock(cacheLock);
+    if (cache.size() >= maxCachedTemplates)
+    {
+        cache.clear();
+    }
+    cache.emplace(execline, compiled);
+
+    return compiled;
+}
+
+/** Convert a URI into a file */
+static std::string uri2file(const std::string& uri)
+{
+    GError* error{nullptr};
+    gchar* cfile = g_filename_from_uri(uri.c_str(), nullptr, &error);
+
+    if (error != nullptr)
+    {
+        g_warning("Unable to resolve '%s' to a filename: %s", uri.c_str(), error->message);
+        g_error_free(error);
+    }
+
+    std::string file;
+    if (cfile != nullptr)
+    {
+        file = cfile;
+        g_free(cfile);
+    }
+
+    g_debug("Converting URI '%s' to file '%s'", uri.c_str(), file.c_str());
+    return file;
+}
+
+/** Build the argument list for a launch with the URIs */
+std::vector<std::string> ExecTemplate::expand(const std::vector<std::string>& uris) const
+{
+    std::vector<std::string> retval;
+    retval.reserve(args_.size() + uris.size());
+
+    /* Only convert the first file once */
+    std::string firstFile;
+    bool haveFirstFile = false;
+
+    for (const auto& arg : args_)
+    {
+        switch (arg.type)
+        {
+            case Arg::Type::URI_LIST:
+                for (const auto& uri : uris)
+                {
+                    if (!uri.empty())
+                    {
+                        retval.emplace_back(uri);
+                    }
+                }
+                break;
+            case Arg::Type::FILE_LIST:
+                for (const auto& uri : uris)
+                {
+                    auto file = uri2file(uri);
+                    if (!file.empty())
+                    {
+                        retval.emplace_back(std::move(file));
+                    }
+                }
+                break;
+            case Arg::Type::PIECES:
+            {
+                std::string value;
+                for (const auto& piece : arg.pieces)
+                {
+                    switch (piece.type)
+                    {
+                        case Piece::Type::LITERAL:
+                            value += piece.text;
+                            break;
+                        case Piece::Type::URI:
+                            if (!uris.empty())
+                            {
+                                value += uris[0];
+                            }
+                            break;
+                        case Piece::Type::FILE:
+                            if (!uris.empty())
+                            {
+                                if (!haveFirstFile)
+                                {
+                                    firstFile = uri2file(uris[0]);
+                                    haveFirstFile = true;
+                                }
+                                value += firstFile;
+                            }
+                            break;
+                    }
+                }
+
+                if (!value.empty())
+                {
+                    retval.emplace_back(std::move(value));
+                }
+                break;
+            }
+        }
+    }
+
+    return retval;
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
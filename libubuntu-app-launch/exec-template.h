@@ -0,0 +1,88 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** A desktop file Exec line that has already been split into arguments
+    and had its field codes found. Expanding it for a launch only needs
+    to splice in the URIs. It follows the same rules as desktop_exec_parse()
+    in utils.c.
+
+    More info: https://specifications.freedesktop.org/desktop-entry-spec/latest/ar01s07.html
+*/
+class ExecTemplate
+{
+public:
+    explicit ExecTemplate(const std::string& execline);
+
+    static std::shared_ptr<const ExecTemplate> compile(const std::string& execline);
+
+    std::vector<std::string> expand(const std::vector<std::string>& uris) const;
+
+    /** Number of arguments in the Exec line before expanding */
+    std::size_t size() const
+    {
+        return args_.size();
+    }
+
+private:
+    /** Part of an argument */
+    struct Piece
+    {
+        enum class Type
+        {
+            LITERAL, /**< Text copied as is */
+            URI,     /**< The first URI, %u */
+            FILE     /**< The first URI as a file path, %f */
+        };
+
+        Type type;
+        std::string text;
+    };
+
+    /** A single argument in the Exec line */
+    struct Arg
+    {
+        enum class Type
+        {
+            PIECES,   /**< Built from the pieces */
+            URI_LIST, /**< All the URIs as their own arguments, %U */
+            FILE_LIST /**< All the URIs as files as their own arguments, %F */
+        };
+
+        Type type;
+        std::vector<Piece> pieces;
+    };
+
+    std::vector<Arg> args_;
+
+    static Arg compileArg(const std::string& segment);
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -18,7 +18,13 @@
  */
 
 #include "glib-thread.h"
+#include "ubuntu-app-launch-trace.h"
 
+#include <cerrno>
+#include <cstring>
+#include <glib-unix.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #include <unity/util/GlibMemory.h>
 
 using namespace unity::util;
@@ -26,8 +32,57 @@ using namespace unity::util;
 namespace GLib
 {
 
+/** Number of tasks to run before letting the main loop dispatch
+    other sources */
+static const int maxTasksPerDispatch{128};
+
+/** Work that runs longer than this gets put in the slow task log */
+static const std::chrono::milliseconds slowTaskThreshold{10};
+
+/** Number of entries kept in the slow task log */
+static const std::size_t maxSlowTasks{32};
+
+/** Task wrapping a std::function for async work, owns itself and
+    is deleted once it has run */
+class FunctionTask : public ContextThread::Task
+{
+public:
+    FunctionTask(std::function<void()>&& work)
+        : work_(std::move(work))
+    {
+    }
+
+    void run() override
+    {
+        std::unique_ptr<FunctionTask> self(this);
+        work_();
+    }
+
+    void abandon() override
+    {
+        delete this;
+    }
+
+private:
+    std::function<void()> work_;
+};
+
 ContextThread::ContextThread(const std::function<void()>& beforeLoop, const std::function<void()>& afterLoop)
+    : queueHead_(&queueStub_)
+    , queueTail_(&queueStub_)
 {
+    for (std::size_t i = 0; i < histogramBuckets; i++)
+    {
+        queueTime_[i] = 0;
+        execTime_[i] = 0;
+    }
+
+    wakeupFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeupFd_ < 0)
+    {
+        throw std::runtime_error("Unable to create eventfd for GLib Thread");
+    }
+
     _cancel = std::shared_ptr<GCancellable>(g_cancellable_new(), [](GCancellable* cancel) {
         if (cancel != nullptr)
         {
@@ -51,6 +106,18 @@ ContextThread::ContextThread(const std::function<void()>& beforeLoop, const std:
 
         g_main_context_push_thread_default(context.get());
 
+        /* One source for all the work queued to the thread, it stays
+           around for the life of the context. */
+        auto wakeup = unique_glib(g_unix_fd_source_new(wakeupFd_, G_IO_IN));
+        g_source_set_callback(wakeup.get(),
+                              reinterpret_cast<GSourceFunc>(+[](gint fd, GIOCondition, gpointer user_data) -> gboolean {
+                                  auto pthis = static_cast<ContextThread*>(user_data);
+                                  pthis->drainQueue();
+                                  return G_SOURCE_CONTINUE;
+                              }),
+                              this, nullptr);
+        g_source_attach(wakeup.get(), context.get());
+
         beforeLoop();
 
         /* Free's the constructor to continue */
@@ -62,6 +129,9 @@ ContextThread::ContextThread(const std::function<void()>& beforeLoop, const std:
         }
 
         std::call_once(*afterFlag_, afterLoop_);
+
+        g_source_destroy(wakeup.get());
+        abandonQueue();
     });
 
     /* We need to have the context and the mainloop ready before
@@ -83,6 +153,10 @@ ContextThread::ContextThread(const std::function<void()>& beforeLoop, const std:
 ContextThread::~ContextThread()
 {
     quit();
+
+    /* Anything that got queued while we were shutting down */
+    abandonQueue();
+    close(wakeupFd_);
 }
 
 void ContextThread::quit()
@@ -119,47 +193,332 @@ std::shared_ptr<GCancellable> ContextThread::getCancellable()
     return _cancel;
 }
 
-guint ContextThread::simpleSource(std::function<GSource*()> srcBuilder, std::function<void()> work)
+/** Data for a source added with simpleSource(), owned by the source */
+struct SimpleSourceData
+{
+    ContextThread* thread;
+    std::function<void()> work;
+    ContextThread::CallSite site;
+    /** Anything that runs after this was delayed by other work on the thread */
+    std::chrono::steady_clock::time_point due;
+};
+
+guint ContextThread::simpleSource(std::function<GSource*()> srcBuilder,
+                                  std::function<void()> work,
+                                  std::chrono::steady_clock::duration lateAfter,
+                                  const CallSite& site)
 {
     if (isCancelled())
     {
         throw std::runtime_error("Trying to execute work on a GLib thread that is shutting down.");
     }
 
-    /* Copy the work so that we can reuse it */
     /* Lifecycle is handled with the source pointer when we attach
        it to the context. */
-    auto heapWork = new std::function<void()>(work);
+    auto data = new SimpleSourceData{this, std::move(work), site, std::chrono::steady_clock::now() + lateAfter};
 
     auto source = unique_glib(srcBuilder());
     g_source_set_callback(source.get(),
-                          [](gpointer data) {
-                              auto heapWork = static_cast<std::function<void()>*>(data);
-                              (*heapWork)();
+                          [](gpointer user_data) {
+                              auto data = static_cast<SimpleSourceData*>(user_data);
+
+                              auto start = std::chrono::steady_clock::now();
+                              data->work();
+                              auto end = std::chrono::steady_clock::now();
+
+                              data->thread->record(Kind::TIMEOUT, data->site,
+                                                   std::max(start - data->due, std::chrono::steady_clock::duration{0}),
+                                                   end - start);
                               return G_SOURCE_REMOVE;
                           },
-                          heapWork,
-                          [](gpointer data) {
-                              auto heapWork = static_cast<std::function<void()>*>(data);
-                              delete heapWork;
+                          data,
+                          [](gpointer user_data) {
+                              auto data = static_cast<SimpleSourceData*>(user_data);
+                              delete data;
                           });
 
     return g_source_attach(source.get(), _context.get());
 }
 
-guint ContextThread::executeOnThread(std::function<void()> work)
+/** Queue work to run on the thread, doesn't block. */
+void ContextThread::executeOnThread(std::function<void()> work, CallSite site)
+{
+    executeOnThread(new FunctionTask(std::move(work)), site);
+}
+
+/** Queue a task to run on the thread. The task must stay valid
+    until either run() or abandon() is called on it. */
+void ContextThread::executeOnThread(Task* task, CallSite site)
+{
+    if (isCancelled())
+    {
+        task->abandon();
+        throw std::runtime_error("Trying to execute work on a GLib thread that is shutting down.");
+    }
+
+    task->site_ = site;
+    task->queued_ = std::chrono::steady_clock::now();
+
+    auto depth = ++queueDepth_;
+    auto maxDepth = maxQueueDepth_.load();
+    while (depth > maxDepth && !maxQueueDepth_.compare_exchange_weak(maxDepth, depth))
+    {
+    }
+
+    pushTask(task);
+    wakeup();
+}
+
+/** Signal the eventfd, only the first task after the thread drains the
+    queue needs to wake it up */
+void ContextThread::wakeup()
+{
+    if (!wakeupPending_.exchange(true))
+    {
+        uint64_t one = 1;
+        if (write(wakeupFd_, &one, sizeof(one)) != sizeof(one))
+        {
+            g_warning("Unable to wake up GLib thread");
+        }
+    }
+}
+
+/** Adds a task on the head of the queue, safe to call from any thread */
+void ContextThread::pushTask(Task* task)
+{
+    task->next_.store(nullptr, std::memory_order_relaxed);
+    auto prev = queueHead_.exchange(task, std::memory_order_acq_rel);
+    prev->next_.store(task, std::memory_order_release);
+}
+
+/** Removes the task at the tail of the queue. Returns nullptr if the queue
+    is empty or a producer is in the middle of adding a task, in which case
+    it'll wake us up again once it is done. Only called on the thread. */
+ContextThread::Task* ContextThread::popTask()
+{
+    auto tail = queueTail_;
+    auto next = tail->next_.load(std::memory_order_acquire);
+
+    if (tail == &queueStub_)
+    {
+        if (next == nullptr)
+        {
+            return nullptr;
+        }
+        queueTail_ = next;
+        tail = next;
+        next = next->next_.load(std::memory_order_acquire);
+    }
+
+    if (next != nullptr)
+    {
+        queueTail_ = next;
+        return tail;
+    }
+
+    if (tail != queueHead_.load(std::memory_order_acquire))
+    {
+        return nullptr;
+    }
+
+    pushTask(&queueStub_);
+
+    next = tail->next_.load(std::memory_order_acquire);
+    if (next != nullptr)
+    {
+        queueTail_ = next;
+        return tail;
+    }
+
+    return nullptr;
+}
+
+/** Called when the eventfd is signaled to run everything in the queue */
+void ContextThread::drainQueue()
+{
+    uint64_t count;
+    if (read(wakeupFd_, &count, sizeof(count)) < 0 && errno != EAGAIN)
+    {
+        g_warning("Unable to read GLib thread wakeup: %s", g_strerror(errno));
+    }
+
+    /* Clear before draining so anything added after this point
+       signals again */
+    wakeupPending_.store(false);
+
+    /* Don't starve the other sources on the context if work keeps
+       getting added, do a batch and come back for more */
+    for (int i = 0; i < maxTasksPerDispatch; i++)
+    {
+        auto task = popTask();
+        if (task == nullptr)
+        {
+            return;
+        }
+        queueDepth_--;
+
+        /* The task can be gone once it has run */
+        auto site = task->site_;
+        auto start = std::chrono::steady_clock::now();
+        auto queued = start - task->queued_;
+
+        task->run();
+
+        record(Kind::TASK, site, queued, std::chrono::steady_clock::now() - start);
+    }
+
+    wakeup();
+}
+
+/** Tell all the tasks left in the queue that they won't be run */
+void ContextThread::abandonQueue()
+{
+    Task* task;
+    while ((task = popTask()) != nullptr)
+    {
+        queueDepth_--;
+        task->abandon();
+    }
+}
+
+/** Find the histogram bucket for a duration, powers of two in microseconds */
+static std::size_t histogramBucket(std::chrono::microseconds time)
+{
+    if (time.count() < 1)
+    {
+        return 0;
+    }
+
+    std::size_t bits = 64 - __builtin_clzll(time.count());
+    return std::min(bits, ContextThread::histogramBuckets - 1);
+}
+
+/** Add a piece of work that has been run on the thread to the stats */
+void ContextThread::record(Kind kind,
+                           const CallSite& site,
+                           std::chrono::steady_clock::duration queued,
+                           std::chrono::steady_clock::duration executed)
+{
+    auto queuedUs = std::chrono::duration_cast<std::chrono::microseconds>(queued);
+    auto executedUs = std::chrono::duration_cast<std::chrono::microseconds>(executed);
+
+    switch (kind)
+    {
+        case Kind::TASK:
+            tasks_++;
+            break;
+        case Kind::TIMEOUT:
+            timeouts_++;
+            break;
+        case Kind::CALLBACK:
+            callbacks_++;
+            break;
+    }
+
+    /* Callbacks are dispatched by GLib directly, we don't know when
+       they were ready to run */
+    if (kind != Kind::CALLBACK)
+    {
+        queueTime_[histogramBucket(queuedUs)]++;
+    }
+    execTime_[histogramBucket(executedUs)]++;
+
+    tracepoint(ubuntu_app_launch, thread_task, static_cast<int>(kind), site.file, site.line, site.function,
+               queuedUs.count(), executedUs.count(), queueDepth_.load());
+
+    if (executed < slowTaskThreshold)
+    {
+        return;
+    }
+
+    tracepoint(ubuntu_app_launch, thread_task_slow, static_cast<int>(kind), site.file, site.line, site.function,
+               queuedUs.count(), executedUs.count());
+    g_debug("Slow work on GLib thread from %s: queued %lldus, executed %lldus", site.str().c_str(),
+            static_cast<long long>(queuedUs.count()), static_cast<long long>(executedUs.count()));
+
+    std::lock_guard<std::mutex> lock(slowTasksLock_);
+    slowTasks_.push_back(SlowTask{kind, site, queuedUs, executedUs});
+    if (slowTasks_.size() > maxSlowTasks)
+    {
+        slowTasks_.pop_front();
+    }
+}
+
+/** Get a copy of the current instrumentation values */
+ContextThread::Stats ContextThread::stats()
+{
+    Stats retval;
+
+    retval.queueDepth = queueDepth_.load();
+    retval.maxQueueDepth = maxQueueDepth_.load();
+    retval.tasks = tasks_.load();
+    retval.timeouts = timeouts_.load();
+    retval.callbacks = callbacks_.load();
+
+    for (std::size_t i = 0; i < histogramBuckets; i++)
+    {
+        retval.queueTime[i] = queueTime_[i].load();
+        retval.execTime[i] = execTime_[i].load();
+    }
+
+    std::lock_guard<std::mutex> lock(slowTasksLock_);
+    retval.slowTasks.assign(slowTasks_.begin(), slowTasks_.end());
+
+    return retval;
+}
+
+/** Clear the counters, histograms and slow task log. The current
+    queue depth is left as it is. */
+void ContextThread::resetStats()
+{
+    maxQueueDepth_ = queueDepth_.load();
+    tasks_ = 0;
+    timeouts_ = 0;
+    callbacks_ = 0;
+
+    for (std::size_t i = 0; i < histogramBuckets; i++)
+    {
+        queueTime_[i] = 0;
+        execTime_[i] = 0;
+    }
+
+    std::lock_guard<std::mutex> lock(slowTasksLock_);
+    slowTasks_.clear();
+}
+
+/** A short form of the call site, just the file name without the path */
+std::string ContextThread::CallSite::str() const
+{
+    auto basename = std::strrchr(file, '/');
+
+    return std::string(basename != nullptr ? basename + 1 : file) + ":" + std::to_string(line) + " (" + function +
+           ")";
+}
+
+ContextThread::CallbackTimer::CallbackTimer(ContextThread& thread, CallSite site)
+    : thread_(thread)
+    , site_(site)
+    , start_(std::chrono::steady_clock::now())
+{
+}
+
+ContextThread::CallbackTimer::~CallbackTimer()
 {
-    return simpleSource(g_idle_source_new, work);
+    thread_.record(Kind::CALLBACK, site_, std::chrono::steady_clock::duration{0},
+                   std::chrono::steady_clock::now() - start_);
 }
 
-guint ContextThread::timeout(const std::chrono::milliseconds& length, std::function<void()> work)
+guint ContextThread::timeout(const std::chrono::milliseconds& length, std::function<void()> work, CallSite site)
 {
-    return simpleSource([length]() { return g_timeout_source_new(length.count()); }, work);
+    return simpleSource([length]() { return g_timeout_source_new(length.count()); }, work, length, site);
 }
 
-guint ContextThread::timeoutSeconds(const std::chrono::seconds& length, std::function<void()> work)
+guint ContextThread::timeoutSeconds(const std::chrono::seconds& length, std::function<void()> work, CallSite site)
 {
-    return simpleSource([length]() { return g_timeout_source_new_seconds(length.count()); }, work);
+    /* GLib is allowed to push second timeouts out to the next second
+       so they line up with others, that isn't the thread being slow */
+    return simpleSource([length]() { return g_timeout_source_new_seconds(length.count()); }, work,
+                        length + std::chrono::seconds{1}, site);
 }
 
 void ContextThread::removeSource(guint sourceid)
@@ -19,9 +19,19 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <future>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
 #include <gio/gio.h>
 
@@ -30,6 +40,99 @@ namespace GLib
 
 class ContextThread
 {
+public:
+    /** Where a piece of work came from. The defaults are evaluated by the
+        compiler at the call site, so callers don't need to fill it in. */
+    struct CallSite
+    {
+        CallSite(const char* sitefile = __builtin_FILE(),
+                 int siteline = __builtin_LINE(),
+                 const char* sitefunction = __builtin_FUNCTION())
+            : file(sitefile)
+            , line(siteline)
+            , function(sitefunction)
+        {
+        }
+
+        const char* file;
+        int line;
+        const char* function;
+
+        std::string str() const;
+    };
+
+    /** The different ways work gets run on the thread */
+    enum class Kind
+    {
+        TASK,    /**< Queued with executeOnThread() */
+        TIMEOUT, /**< Added with timeout() or timeoutSeconds() */
+        CALLBACK /**< A signal or async callback measured with CallbackTimer */
+    };
+
+    /** Number of buckets in the latency histograms. Bucket 0 is under a
+        microsecond, bucket N is [2^(N-1), 2^N) microseconds and the last
+        bucket has everything longer. */
+    static const std::size_t histogramBuckets{20};
+
+    /** Work that took longer than slowTaskThreshold to execute */
+    struct SlowTask
+    {
+        Kind kind;
+        CallSite site;
+        std::chrono::microseconds queued;
+        std::chrono::microseconds executed;
+    };
+
+    /** A snapshot of the thread's instrumentation */
+    struct Stats
+    {
+        std::size_t queueDepth;
+        std::size_t maxQueueDepth;
+        std::uint64_t tasks;
+        std::uint64_t timeouts;
+        std::uint64_t callbacks;
+        std::array<std::uint64_t, histogramBuckets> queueTime;
+        std::array<std::uint64_t, histogramBuckets> execTime;
+        std::vector<SlowTask> slowTasks;
+    };
+
+    /** A piece of work queued to run on the thread. Tasks are linked
+        directly into the queue so posting one doesn't need any allocation
+        beyond the task itself. */
+    class Task
+    {
+    public:
+        virtual ~Task() = default;
+
+        /** Do the work, the queue no longer references the task once
+            this is called. */
+        virtual void run() = 0;
+        /** The thread is shutting down and the task won't be run. */
+        virtual void abandon() = 0;
+
+    private:
+        friend class ContextThread;
+        std::atomic<Task*> next_{nullptr};
+        std::chrono::steady_clock::time_point queued_;
+        CallSite site_;
+    };
+
+    /** Measures a callback that the GLib context dispatches directly,
+        like a DBus signal handler, for the thread's stats. Create one
+        at the top of the callback. */
+    class CallbackTimer
+    {
+    public:
+        CallbackTimer(ContextThread& thread, CallSite site = CallSite());
+        ~CallbackTimer();
+
+    private:
+        ContextThread& thread_;
+        CallSite site_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+private:
     std::thread _thread;
     std::shared_ptr<GMainContext> _context;
     std::shared_ptr<GMainLoop> _loop;
@@ -38,6 +141,43 @@ class ContextThread
     std::function<void(void)> afterLoop_;
     std::shared_ptr<std::once_flag> afterFlag_;
 
+    /** Placeholder task that keeps the queue from ever being empty */
+    class StubTask : public Task
+    {
+    public:
+        void run() override
+        {
+        }
+        void abandon() override
+        {
+        }
+    };
+
+    /* Intrusive multi-producer single-consumer queue. Producers push on the
+       head, the thread pops from the tail. */
+    std::atomic<Task*> queueHead_;
+    Task* queueTail_;
+    StubTask queueStub_;
+
+    /** eventfd used to wake up the thread when there is work */
+    int wakeupFd_ = -1;
+    /** Set when a wakeup has been signaled but not yet handled so that
+        bursts of work only cause a single write on the eventfd */
+    std::atomic<bool> wakeupPending_{false};
+
+    /* Instrumentation, the counters are updated on the thread and can
+       be read from anywhere */
+    std::atomic<std::size_t> queueDepth_{0};
+    std::atomic<std::size_t> maxQueueDepth_{0};
+    std::atomic<std::uint64_t> tasks_{0};
+    std::atomic<std::uint64_t> timeouts_{0};
+    std::atomic<std::uint64_t> callbacks_{0};
+    std::array<std::atomic<std::uint64_t>, histogramBuckets> queueTime_;
+    std::array<std::atomic<std::uint64_t>, histogramBuckets> execTime_;
+    /** Most recent slow tasks, oldest first */
+    std::deque<SlowTask> slowTasks_;
+    std::mutex slowTasksLock_;
+
 public:
     ContextThread(const std::function<void()>& beforeLoop = [] {}, const std::function<void()>& afterLoop = [] {});
     ~ContextThread();
@@ -46,9 +186,10 @@ public:
     bool isCancelled();
     std::shared_ptr<GCancellable> getCancellable();
 
-    guint executeOnThread(std::function<void()> work);
+    void executeOnThread(std::function<void()> work, CallSite site = CallSite());
+    void executeOnThread(Task* task, CallSite site = CallSite());
     template <typename T>
-    auto executeOnThread(std::function<T()> work) -> T
+    auto executeOnThread(std::function<T()> work, CallSite site = CallSite()) -> T
     {
         if (std::this_thread::get_id() == _thread.get_id())
         {
@@ -56,42 +197,124 @@ public:
             return work();
         }
 
-        std::promise<T> promise;
-        std::function<void()> magicFunc = [&promise, &work]() {
-            try
-            {
-                promise.set_value(work());
-            }
-            catch (...)
-            {
-                promise.set_exception(std::current_exception());
-            }
-        };
-
-        executeOnThread(magicFunc);
-
-        auto future = promise.get_future();
-        future.wait();
-        return future.get();
+        SyncTask<T> task(work);
+        executeOnThread(&task, site);
+        return task.wait();
     }
 
-    guint timeout(const std::chrono::milliseconds& length, std::function<void()> work);
+    guint timeout(const std::chrono::milliseconds& length, std::function<void()> work, CallSite site = CallSite());
     template <class Rep, class Period>
-    guint timeout(const std::chrono::duration<Rep, Period>& length, std::function<void()> work)
+    guint timeout(const std::chrono::duration<Rep, Period>& length,
+                  std::function<void()> work,
+                  CallSite site = CallSite())
     {
-        return timeout(std::chrono::duration_cast<std::chrono::milliseconds>(length), work);
+        return timeout(std::chrono::duration_cast<std::chrono::milliseconds>(length), work, site);
     }
 
-    guint timeoutSeconds(const std::chrono::seconds& length, std::function<void()> work);
+    guint timeoutSeconds(const std::chrono::seconds& length, std::function<void()> work, CallSite site = CallSite());
     template <class Rep, class Period>
-    guint timeoutSeconds(const std::chrono::duration<Rep, Period>& length, std::function<void()> work)
+    guint timeoutSeconds(const std::chrono::duration<Rep, Period>& length,
+                         std::function<void()> work,
+                         CallSite site = CallSite())
     {
-        return timeoutSeconds(std::chrono::duration_cast<std::chrono::seconds>(length), work);
+        return timeoutSeconds(std::chrono::duration_cast<std::chrono::seconds>(length), work, site);
     }
 
     void removeSource(guint sourceid);
 
+    Stats stats();
+    void resetStats();
+
 private:
-    guint simpleSource(std::function<GSource*()> srcBuilder, std::function<void()> work);
+    /** A task that lives on the stack of the thread waiting for its
+        result. Replaces a promise/future pair so that a synchronous call
+        doesn't allocate any shared state. */
+    template <typename T>
+    class SyncTask : public Task
+    {
+    public:
+        SyncTask(std::function<T()>& work)
+            : work_(work)
+        {
+        }
+
+        ~SyncTask()
+        {
+            if (hasValue_)
+            {
+                reinterpret_cast<T*>(&value_)->~T();
+            }
+        }
+
+        void run() override
+        {
+            try
+            {
+                new (&value_) T(work_());
+                hasValue_ = true;
+            }
+            catch (...)
+            {
+                error_ = std::current_exception();
+            }
+
+            complete();
+        }
+
+        void abandon() override
+        {
+            error_ = std::make_exception_ptr(
+                std::runtime_error("Trying to execute work on a GLib thread that is shutting down."));
+            complete();
+        }
+
+        T wait()
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+            cond_.wait(lock, [this] { return done_; });
+
+            if (error_)
+            {
+                std::rethrow_exception(error_);
+            }
+
+            return std::move(*reinterpret_cast<T*>(&value_));
+        }
+
+    private:
+        std::function<T()>& work_;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type value_;
+        bool hasValue_ = false;
+        std::exception_ptr error_;
+
+        std::mutex lock_;
+        std::condition_variable cond_;
+        bool done_ = false;
+
+        void complete()
+        {
+            /* Notify with the lock held, the waiter owns this object and
+               can destroy it as soon as it sees we're done */
+            std::lock_guard<std::mutex> lock(lock_);
+            done_ = true;
+            cond_.notify_one();
+        }
+    };
+
+    void wakeup();
+    void pushTask(Task* task);
+    Task* popTask();
+    void drainQueue();
+    void abandonQueue();
+
+    void record(Kind kind,
+                const CallSite& site,
+                std::chrono::steady_clock::duration queued,
+                std::chrono::steady_clock::duration executed);
+
+    guint simpleSource(std::function<GSource*()> srcBuilder,
+                       std::function<void()> work,
+                       std::chrono::steady_clock::duration lateAfter,
+                       const CallSite& site);
 };
 }
@@ -88,7 +88,9 @@ private:
     AppID _appid;
     std::shared_ptr<Registry::Impl> registry_;
 
+    std::string execToolPath() const;
     std::list<std::pair<std::string, std::string>> defaultEnv();
+    void refillPool();
 };
 
 }  // namespace helper_impl
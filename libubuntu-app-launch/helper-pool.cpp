@@ -0,0 +1,362 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "helper-pool.h"
+#include "registry-impl.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+namespace
+{
+
+/** Header that tells a parked helper the rest is URLs, the same as
+    PARK_HEADER in systemd-helper-helper */
+const char parkHeader[] = "URLS";
+
+/** How long a unit gets to start listening on its socket before we
+    decide that it isn't going to */
+const gint64 parkReadyTimeout{10 * G_USEC_PER_SEC};
+
+/** Connect to a parked helper's socket. The name is in the abstract
+    namespace and padded out like systemd-helper-helper binds it. We
+    check that the other end is ours so nobody else can squat on the
+    name and get our URLs. On failure errno says why. */
+int parkConnect(const std::string& socketname)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct sockaddr_un socketaddr = {};
+    socketaddr.sun_family = AF_UNIX;
+    strncpy(socketaddr.sun_path, socketname.c_str(), sizeof(socketaddr.sun_path) - 1);
+    socketaddr.sun_path[0] = 0;
+
+    if (connect(fd, reinterpret_cast<const struct sockaddr*>(&socketaddr), sizeof(struct sockaddr_un)) != 0)
+    {
+        int connecterr = errno;
+        close(fd);
+        errno = connecterr;
+        return -1;
+    }
+
+    struct ucred cred = {};
+    socklen_t credlen = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) != 0 || cred.uid != getuid())
+    {
+        g_warning("Parked helper socket '%s' is owned by someone else", socketname.c_str() + 1);
+        close(fd);
+        errno = EPERM;
+        return -1;
+    }
+
+    return fd;
+}
+
+}  // namespace
+
+HelperPool::HelperPool(Registry::Impl& registry)
+    : registry_(registry)
+{
+}
+
+HelperPool::~HelperPool()
+{
+    for (const auto& units : parked_)
+    {
+        for (const auto& unit : units.second)
+        {
+            release(unit);
+        }
+    }
+}
+
+/** Set how many units to keep parked for each AppID of a helper type.
+    Shrinking the pool releases the extra units. */
+void HelperPool::setSize(const Helper::Type& type, unsigned int size)
+{
+    std::list<Parked> extra;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        sizes_[type.value()] = size;
+
+        for (auto& units : parked_)
+        {
+            if (units.first.first != type.value())
+            {
+                continue;
+            }
+
+            while (units.second.size() > size)
+            {
+                extra.splice(extra.end(), units.second, units.second.begin());
+            }
+        }
+    }
+
+    for (const auto& unit : extra)
+    {
+        release(unit);
+    }
+}
+
+unsigned int HelperPool::size(const Helper::Type& type)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    auto size = sizes_.find(type.value());
+    return size == sizes_.end() ? 0 : size->second;
+}
+
+/** Number of units waiting for a helper */
+std::size_t HelperPool::parked(const Helper::Type& type, const AppID& appid)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    auto units = parked_.find(Key{type.value(), appid});
+    return units == parked_.end() ? 0 : units->second.size();
+}
+
+/** Hand the URLs to the oldest parked unit for the helper. Units that
+    are still starting up and not listening yet go back in the pool, units
+    that have died or never started listening are stopped and dropped.
+
+    \returns The instance ID of the unit or an empty string if there
+             wasn't one that could take the URLs
+*/
+std::string HelperPool::claim(const Helper::Type& type, const AppID& appid, const std::vector<Helper::URL>& urls)
+{
+    std::string claimed;
+    std::list<Parked> starting;
+
+    while (claimed.empty())
+    {
+        Parked unit;
+
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            auto units = parked_.find(Key{type.value(), appid});
+            if (units == parked_.end() || units->second.empty())
+            {
+                break;
+            }
+
+            unit = units->second.front();
+            units->second.pop_front();
+        }
+
+        switch (deliver(unit, urls))
+        {
+            case Delivery::DELIVERED:
+                g_debug("Claimed parked helper '%s' for '%s'", unit.instance.c_str(), appid.str().c_str());
+                claimed = unit.instance;
+                break;
+            case Delivery::NOT_READY:
+                if (g_get_monotonic_time() - unit.started < parkReadyTimeout)
+                {
+                    g_debug("Parked helper '%s' isn't listening yet", unit.instance.c_str());
+                    starting.push_back(unit);
+                    break;
+                }
+            /* fall through */
+            case Delivery::FAILED:
+                g_debug("Parked helper '%s' can't be used", unit.instance.c_str());
+                stop(type, appid, unit);
+                break;
+        }
+    }
+
+    if (!starting.empty())
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto& units = parked_[Key{type.value(), appid}];
+        units.splice(units.begin(), starting);
+    }
+
+    if (!claimed.empty())
+    {
+        registry_.jobs()->parkedClaimed(appid, type.value(), claimed);
+    }
+
+    return claimed;
+}
+
+/** Start units until there are as many parked for the helper as the
+    pool size for its type. Must be called on the registry's thread so
+    that the launches don't block it.
+
+    \param type Helper type
+    \param appid Helper AppID
+    \param env Environment to launch the helper with
+*/
+void HelperPool::refill(const Helper::Type& type, const AppID& appid, const EnvList& env)
+{
+    std::list<Parked> start;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto size = sizes_.find(type.value());
+        if (size == sizes_.end())
+        {
+            return;
+        }
+
+        auto& units = parked_[Key{type.value(), appid}];
+        while (units.size() < size->second)
+        {
+            /* Time based like other helper instances, but they get
+               started together so make sure they're unique */
+            lastInstance_ = std::max(lastInstance_ + 1, g_get_real_time());
+            auto instance = std::to_string(lastInstance_);
+
+            units.emplace_back(Parked{instance, "/ual-helper-park-" + instance + "-" + std::to_string(g_random_int()),
+                                      g_get_monotonic_time()});
+            start.push_back(units.back());
+
+            unclaimed_.emplace(type.value(), appid.str(), instance);
+        }
+        unclaimedCount_ = unclaimed_.size();
+    }
+
+    for (const auto& unit : start)
+    {
+        std::function<EnvList()> envfunc = [env, unit]() {
+            auto retval = env;
+            retval.emplace_back(std::make_pair("UBUNTU_APP_LAUNCH_HELPER_PARK_SOCKET", unit.socket));
+            return retval;
+        };
+
+        try
+        {
+            registry_.jobs()->launch(appid, type.value(), unit.instance, {}, jobs::manager::launchMode::STANDARD,
+                                     envfunc);
+        }
+        catch (std::runtime_error& e)
+        {
+            g_warning("Unable to park helper for '%s': %s", appid.str().c_str(), e.what());
+
+            std::lock_guard<std::mutex> lock(lock_);
+            auto& units = parked_[Key{type.value(), appid}];
+            units.remove_if([&unit](const Parked& parked) { return parked.instance == unit.instance; });
+            unclaimed_.erase(std::make_tuple(type.value(), appid.str(), unit.instance));
+            unclaimedCount_ = unclaimed_.size();
+        }
+    }
+}
+
+/** Whether a unit is one of ours that nobody has claimed. Those are left
+    out of instance lists and signals. */
+bool HelperPool::unclaimed(const std::string& job, const std::string& appid, const std::string& instance)
+{
+    if (G_LIKELY(unclaimedCount_ == 0))
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    return unclaimed_.find(std::make_tuple(job, appid, instance)) != unclaimed_.end();
+}
+
+/** Stop treating a unit as unclaimed, because it has been claimed or
+    because it is gone. Called on the registry's thread, where the job
+    manager sends its signals. */
+void HelperPool::forget(const std::string& job, const std::string& appid, const std::string& instance)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    unclaimed_.erase(std::make_tuple(job, appid, instance));
+    unclaimedCount_ = unclaimed_.size();
+}
+
+/** Send the URLs to a parked unit. The socket is bound once the unit is
+    running, so nothing listening on it usually means it is still
+    starting. */
+HelperPool::Delivery HelperPool::deliver(const Parked& parked, const std::vector<Helper::URL>& urls)
+{
+    int fd = parkConnect(parked.socket);
+    if (fd < 0)
+    {
+        return (errno == ECONNREFUSED || errno == ENOENT) ? Delivery::NOT_READY : Delivery::FAILED;
+    }
+
+    std::string message{parkHeader, sizeof(parkHeader)};
+    for (const auto& url : urls)
+    {
+        message.append(url.value());
+        message.push_back('\0');
+    }
+
+    /* The helper can hang up on us at any time, that needs to be an
+       error and not a SIGPIPE that kills whoever is using the library */
+    std::size_t written = 0;
+    while (written < message.size())
+    {
+        auto thiswrite = send(fd, message.data() + written, message.size() - written, MSG_NOSIGNAL);
+        if (thiswrite <= 0)
+        {
+            if (thiswrite < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        written += thiswrite;
+    }
+
+    close(fd);
+    return written == message.size() ? Delivery::DELIVERED : Delivery::FAILED;
+}
+
+/** Tell a parked unit it isn't needed, hanging up without the header
+    makes it exit */
+void HelperPool::release(const Parked& parked)
+{
+    int fd = parkConnect(parked.socket);
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+/** Stop a unit that can't take URLs, otherwise it would wait for them
+    until it times out */
+void HelperPool::stop(const Helper::Type& type, const AppID& appid, const Parked& parked)
+{
+    try
+    {
+        registry_.jobs()->existing(appid, type.value(), parked.instance, {})->stop();
+    }
+    catch (std::runtime_error& e)
+    {
+        g_warning("Unable to stop parked helper '%s': %s", parked.instance.c_str(), e.what());
+    }
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,116 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <gio/gio.h>
+
+#include "appid.h"
+#include "helper.h"
+#include "registry.h"
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** Helper units that have been started ahead of time. A parked unit runs
+    systemd-helper-helper, which gets the parameters from the exec-tool
+    and then waits on an abstract socket for the URLs before executing
+    the helper. Claiming one is a connect and a write instead of a new
+    unit and an exec-tool run.
+
+    Units that are never claimed exit on their own after
+    UBUNTU_APP_LAUNCH_HELPER_PARK_TIMEOUT seconds. When the pool is
+    shrunk or destroyed we connect and hang up, which makes them exit
+    right away.
+
+    Until a unit is claimed it isn't a helper anyone asked for, so the
+    job manager leaves it out of instance lists and signals, and sends
+    the started signal when it is claimed. */
+class HelperPool
+{
+public:
+    typedef std::list<std::pair<std::string, std::string>> EnvList;
+
+    HelperPool(Registry::Impl& registry);
+    ~HelperPool();
+
+    void setSize(const Helper::Type& type, unsigned int size);
+    unsigned int size(const Helper::Type& type);
+    std::size_t parked(const Helper::Type& type, const AppID& appid);
+
+    std::string claim(const Helper::Type& type, const AppID& appid, const std::vector<Helper::URL>& urls);
+    void refill(const Helper::Type& type, const AppID& appid, const EnvList& env);
+
+    bool unclaimed(const std::string& job, const std::string& appid, const std::string& instance);
+    void forget(const std::string& job, const std::string& appid, const std::string& instance);
+
+private:
+    /** A unit waiting for its URLs */
+    struct Parked
+    {
+        std::string instance;
+        std::string socket;
+        gint64 started; /**< Monotonic time the unit was launched */
+    };
+    typedef std::pair<std::string, AppID> Key;
+
+    /** What happened when we tried to hand URLs to a unit */
+    enum class Delivery
+    {
+        DELIVERED, /**< The unit has the URLs */
+        NOT_READY, /**< Nothing listening on the socket, yet */
+        FAILED     /**< The unit can't be used */
+    };
+
+    Registry::Impl& registry_;
+
+    std::mutex lock_;
+    /** Number of units to keep parked for each helper type */
+    std::map<std::string, unsigned int> sizes_;
+    /** Parked units, oldest first */
+    std::map<Key, std::list<Parked>> parked_;
+    /** Last instance ID we gave a parked unit */
+    gint64 lastInstance_ = 0;
+    /** Units we started that haven't been claimed, by job, AppID and
+        instance. Including those that have left the pool but that the
+        job manager still knows about. */
+    std::set<std::tuple<std::string, std::string, std::string>> unclaimed_;
+    /** Size of unclaimed_ to check without the lock */
+    std::atomic<std::size_t> unclaimedCount_{0};
+
+    static Delivery deliver(const Parked& parked, const std::vector<Helper::URL>& urls);
+    static void release(const Parked& parked);
+    void stop(const Helper::Type& type, const AppID& appid, const Parked& parked);
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
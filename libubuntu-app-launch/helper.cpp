@@ -129,14 +129,10 @@ std::vector<Application::URL> appURL(const std::vector<Helper::URL>& in)
     return out;
 }
 
-/** Sets up the executable environment variable based on the appid and
- *  the type of helper. We look for the exec-tool, but if we can't find
- *  it we're cool with that and we just execute the helper. If we do find
- *  an exec-tool we'll use that to fill in the parameters. For legacy appid's
- *  we'll allow the exec-tool to set everything. */
-std::list<std::pair<std::string, std::string>> Base::defaultEnv()
+/** Path to the exec-tool for our type of helper, or an empty string
+    if there isn't one */
+std::string Base::execToolPath() const
 {
-    std::list<std::pair<std::string, std::string>> envs{};
     auto csnapenv = getenv("SNAP");
     std::string helperpath;
     if (csnapenv != nullptr)
@@ -148,9 +144,28 @@ std::list<std::pair<std::string, std::string>> Base::defaultEnv()
         helperpath = HELPER_EXEC_TOOL_DIR "/" + _type.value() + "/exec-tool";
     }
 
+    if (!g_file_test(helperpath.c_str(), G_FILE_TEST_IS_EXECUTABLE))
+    {
+        return {};
+    }
+
+    return helperpath;
+}
+
+/** Sets up the executable environment variable based on the appid and
+ *  the type of helper. We look for the exec-tool, but if we can't find
+ *  it we're cool with that and we just execute the helper. If we do find
+ *  an exec-tool we'll use that to fill in the parameters. For legacy appid's
+ *  we'll allow the exec-tool to set everything. */
+std::list<std::pair<std::string, std::string>> Base::defaultEnv()
+{
+    std::list<std::pair<std::string, std::string>> envs{};
+    auto csnapenv = getenv("SNAP");
+    auto helperpath = execToolPath();
+
     std::list<std::string> exec;
     /* We have an exec tool that'll give us params */
-    if (g_file_test(helperpath.c_str(), G_FILE_TEST_IS_EXECUTABLE))
+    if (!helperpath.empty())
     {
         const char* chelperenv = getenv("UBUNTU_APP_LAUNCH_HELPER_HELPER");
         if (chelperenv == nullptr)
@@ -212,13 +227,65 @@ std::list<std::pair<std::string, std::string>> Base::defaultEnv()
 
 std::shared_ptr<Helper::Instance> Base::launch(std::vector<Helper::URL> urls)
 {
+    std::shared_ptr<Helper::Instance> retval;
+    bool pooled = registry_->helperPool.size(_type) > 0;
+
+    /* See if there is one waiting for us */
+    if (pooled)
+    {
+        auto instanceid = registry_->helperPool.claim(_type, _appid, urls);
+        if (!instanceid.empty())
+        {
+            retval = std::make_shared<BaseInstance>(
+                _type, registry_->jobs()->existing(_appid, _type.value(), instanceid, appURL(urls)));
+        }
+    }
+
+    if (!retval)
+    {
+        auto defaultenv = defaultEnv();
+        std::function<std::list<std::pair<std::string, std::string>>()> envfunc = [defaultenv]() {
+            return defaultenv;
+        };
+
+        retval = std::make_shared<BaseInstance>(
+            _type, registry_->jobs()->launch(_appid, _type.value(), genInstanceId(), appURL(urls),
+                                             jobs::manager::launchMode::STANDARD, envfunc));
+    }
+
+    if (pooled)
+    {
+        refillPool();
+    }
+
+    return retval;
+}
+
+/** Start helpers to replace the one we're using. Only helpers with an
+    exec-tool use systemd-helper-helper, so they're the only ones that
+    can wait for their URLs. This is done on the thread after the launch
+    so that the caller doesn't wait on it. */
+void Base::refillPool()
+{
+    if (execToolPath().empty())
+    {
+        return;
+    }
+
     auto defaultenv = defaultEnv();
-    std::function<std::list<std::pair<std::string, std::string>>()> envfunc = [defaultenv]() { return defaultenv; };
+    auto type = _type;
+    auto appid = _appid;
+    std::weak_ptr<Registry::Impl> weakReg = registry_;
 
-    return std::make_shared<BaseInstance>(
-        _type,
-        registry_->jobs()->launch(_appid, _type.value(), genInstanceId(), appURL(urls),
-                                  jobs::manager::launchMode::STANDARD, envfunc));
+    registry_->thread.executeOnThread([weakReg, type, appid, defaultenv]() {
+        auto reg = weakReg.lock();
+        if (!reg)
+        {
+            return;
+        }
+
+        reg->helperPool.refill(type, appid, defaultenv);
+    });
 }
 
 class MirFDProxy
@@ -240,7 +307,7 @@ public:
                         close(fp);
                 })
         , handle(SignalUnsubscriber<proxySocketDemangler>{})
-        , name(g_dbus_connection_get_unique_name(reg->_dbus.get()))
+        , name(g_dbus_connection_get_unique_name(reg->dbus().get()))
     {
         if (appid.empty())
         {
@@ -290,7 +357,7 @@ public:
                     GError* error = nullptr;
                     std::string tryname = "/com/canonical/UbuntuAppLaunch/" + dbusAppid + "/" + std::to_string(rand());
 
-                    g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(skel.get()), reg->_dbus.get(),
+                    g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(skel.get()), reg->dbus().get(),
                                                      tryname.c_str(), &error);
 
                     if (error == nullptr)
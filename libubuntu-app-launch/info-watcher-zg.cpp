@@ -18,8 +18,13 @@
  */
 
 #include "info-watcher-zg.h"
+#include "registry-impl.h"
 
 #include <glib.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <zeitgeist.h>
 
 namespace ubuntu
 {
@@ -28,16 +33,262 @@ namespace app_launch
 namespace info_watcher
 {
 
+/** Number of events to ask Zeitgeist for when building the model */
+static const guint maxQueryEvents{10000};
+
+struct Zeitgeist::Model
+{
+    /** An access or leave event for an application */
+    struct Event
+    {
+        std::string uri;
+        bool access;
+        gint64 timestamp; /**< Milliseconds since the epoch, like Zeitgeist uses */
+    };
+
+    /** Usage of a single application */
+    struct Usage
+    {
+        gint64 total = 0;  /**< Milliseconds the application has been in use */
+        gint64 start = -1; /**< When the current use started, -1 if not in use */
+    };
+
+    std::mutex lock;
+    std::once_flag queryOnce;
+    /** Whether the initial query has finished */
+    bool loaded = false;
+    /** Events that we sent before the initial query finished */
+    std::vector<Event> pending;
+    std::unordered_map<std::string, Usage> usage;
+
+    /** Update the usage with an event, must be called with the lock held */
+    void apply(const Event& event)
+    {
+        auto& appusage = usage[event.uri];
+
+        if (event.access)
+        {
+            if (appusage.start < 0)
+            {
+                appusage.start = event.timestamp;
+            }
+        }
+        else
+        {
+            if (appusage.start >= 0 && event.timestamp >= appusage.start)
+            {
+                appusage.total += event.timestamp - appusage.start;
+            }
+            appusage.start = -1;
+        }
+    }
+
+    /** Whether @event is in @events, which are newest first */
+    static bool contains(const std::vector<Event>& events, const Event& event)
+    {
+        for (const auto& other : events)
+        {
+            if (other.timestamp < event.timestamp)
+            {
+                break;
+            }
+
+            if (other.timestamp == event.timestamp && other.access == event.access && other.uri == event.uri)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
 Zeitgeist::Zeitgeist(const std::shared_ptr<Registry::Impl>& registry)
     : Base(registry)
+    , model_(std::make_shared<Model>())
 {
     g_debug("Created a ZG Watcher");
 }
 
-/** Gets the popularity for a given Application ID */
+/** Build the URI that we use as the subject for events about @appid. It
+    doesn't include the version so that usage carries across upgrades. */
+std::string Zeitgeist::appUri(const AppID& appid)
+{
+    if (appid.package.value().empty())
+    {
+        return "application://" + appid.appname.value() + ".desktop";
+    }
+    else
+    {
+        return "application://" + appid.package.value() + "_" + appid.appname.value() + ".desktop";
+    }
+}
+
+/** Asks Zeitgeist for the access and leave events that we've sent
+    previously, once, and builds up the usage model from them. Until
+    that returns lookups come from the events that we've sent. */
+void Zeitgeist::loadModel()
+{
+    std::call_once(model_->queryOnce, [this]() {
+        std::shared_ptr<Registry::Impl> reg;
+        try
+        {
+            reg = getReg();
+        }
+        catch (std::runtime_error& e)
+        {
+            g_debug("Unable to query Zeitgeist: %s", e.what());
+            return;
+        }
+
+        auto model = model_;
+        auto cancel = reg->thread.getCancellable();
+
+        reg->thread.executeOnThread([model, cancel]() {
+            /* Things that need to stay around until the query is complete */
+            struct QueryData
+            {
+                std::shared_ptr<Model> model;
+                ZeitgeistLog* log;
+                GPtrArray* templates;
+                ZeitgeistTimeRange* time;
+            };
+            auto data = new QueryData{model, zeitgeist_log_new(), g_ptr_array_new_with_free_func(g_object_unref),
+                                      zeitgeist_time_range_new_anytime()};
+
+            for (const auto& eventtype : {ZEITGEIST_ZG_ACCESS_EVENT, ZEITGEIST_ZG_LEAVE_EVENT})
+            {
+                auto event = zeitgeist_event_new();
+                zeitgeist_event_set_actor(event, "application://ubuntu-app-launch.desktop");
+                zeitgeist_event_set_interpretation(event, eventtype);
+                zeitgeist_event_set_manifestation(event, ZEITGEIST_ZG_USER_ACTIVITY);
+                g_ptr_array_add(data->templates, event);
+            }
+
+            zeitgeist_log_find_events(
+                data->log,                                /* log */
+                data->time,                               /* time range */
+                data->templates,                          /* event templates */
+                ZEITGEIST_STORAGE_STATE_ANY,              /* storage state */
+                maxQueryEvents,                           /* num events */
+                ZEITGEIST_RESULT_TYPE_MOST_RECENT_EVENTS, /* result type */
+                cancel.get(),                             /* cancellable */
+                [](GObject* obj, GAsyncResult* res, gpointer user_data) {
+                    auto data = static_cast<QueryData*>(user_data);
+                    auto model = data->model;
+                    GError* error = nullptr;
+
+                    auto results = zeitgeist_log_find_events_finish(ZEITGEIST_LOG(obj), res, &error);
+
+                    g_object_unref(data->log);
+                    g_ptr_array_unref(data->templates);
+                    g_object_unref(data->time);
+                    delete data;
+
+                    /* Results are newest first, we want to play them back in order */
+                    std::vector<Model::Event> events;
+
+                    if (error != nullptr)
+                    {
+                        g_debug("Unable to get usage from Zeitgeist: %s", error->message);
+                        g_error_free(error);
+                    }
+                    else
+                    {
+                        while (zeitgeist_result_set_has_next(results))
+                        {
+                            auto event = zeitgeist_result_set_next_value(results);
+                            auto subject = zeitgeist_event_get_subject(event, 0);
+
+                            if (subject != nullptr && zeitgeist_subject_get_uri(subject) != nullptr)
+                            {
+                                events.emplace_back(Model::Event{
+                                    zeitgeist_subject_get_uri(subject),
+                                    g_strcmp0(zeitgeist_event_get_interpretation(event), ZEITGEIST_ZG_ACCESS_EVENT) ==
+                                        0,
+                                    zeitgeist_event_get_timestamp(event)});
+                            }
+
+                            g_clear_object(&subject);
+                            g_object_unref(event);
+                        }
+                        g_object_unref(results);
+                    }
+
+                    std::lock_guard<std::mutex> lock(model->lock);
+                    for (auto it = events.rbegin(); it != events.rend(); ++it)
+                    {
+                        model->apply(*it);
+                    }
+                    /* Events we sent before the query could have been inserted
+                       before Zeitgeist ran it, those are already counted */
+                    for (const auto& event : model->pending)
+                    {
+                        if (!Model::contains(events, event))
+                        {
+                            model->apply(event);
+                        }
+                    }
+                    model->pending.clear();
+                    model->loaded = true;
+
+                    g_debug("Zeitgeist usage model loaded with %d events", int(events.size()));
+                }, /* callback */
+                data); /* user data */
+        });
+    });
+}
+
+/** Update the model with an event that the registry has sent to
+    Zeitgeist.
+
+    \param appid Application the event is for
+    \param eventtype Either ZEITGEIST_ZG_ACCESS_EVENT or ZEITGEIST_ZG_LEAVE_EVENT
+    \param timestamp Milliseconds since the epoch when the event happened
+*/
+void Zeitgeist::eventSent(const AppID& appid, const std::string& eventtype, gint64 timestamp)
+{
+    loadModel();
+
+    Model::Event event{appUri(appid), eventtype == ZEITGEIST_ZG_ACCESS_EVENT, timestamp};
+
+    std::lock_guard<std::mutex> lock(model_->lock);
+    if (model_->loaded)
+    {
+        model_->apply(event);
+    }
+    else
+    {
+        model_->pending.emplace_back(event);
+    }
+}
+
+/** Gets the popularity for a given Application ID, which is the number
+    of seconds that it has been used. This comes from the model in memory
+    so it is cheap to call for every application. */
 Application::Info::Popularity Zeitgeist::lookupAppPopularity(const AppID& appid)
 {
-    return Application::Info::Popularity::from_raw(0);
+    loadModel();
+
+    std::lock_guard<std::mutex> lock(model_->lock);
+    auto usage = model_->usage.find(appUri(appid));
+    if (usage == model_->usage.end())
+    {
+        return Application::Info::Popularity::from_raw(0);
+    }
+
+    auto total = usage->second.total;
+    if (usage->second.start >= 0)
+    {
+        /* Currently in use, count that too */
+        auto now = g_get_real_time() / 1000;
+        if (now > usage->second.start)
+        {
+            total += now - usage->second.start;
+        }
+    }
+
+    return Application::Info::Popularity::from_raw(total / 1000);
 }
 
 }  // namespace info_watcher
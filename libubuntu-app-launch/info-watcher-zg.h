@@ -24,6 +24,8 @@
 #include "registry.h"
 
 #include <core/signal.h>
+#include <glib.h>
+#include <memory>
 #include <set>
 
 namespace ubuntu
@@ -40,6 +42,18 @@ public:
     virtual ~Zeitgeist() = default;
 
     virtual Application::Info::Popularity lookupAppPopularity(const AppID& appid);
+
+    void eventSent(const AppID& appid, const std::string& eventtype, gint64 timestamp);
+
+    static std::string appUri(const AppID& appid);
+
+private:
+    /** Usage data built from Zeitgeist, shared with the query so that
+        it can outlive us */
+    struct Model;
+    std::shared_ptr<Model> model_;
+
+    void loadModel();
 };
 
 }  // namespace info_watcher
@@ -0,0 +1,242 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "interned-appid.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+struct InternedAppID::Entry
+{
+    AppID appid;
+    std::string str;
+    std::size_t hash;
+    std::uint32_t id;
+    /** Handles pointing here. Only goes to zero with the table lock held,
+        so an entry that is found in the table is never being freed. */
+    std::atomic<std::size_t> refs;
+};
+
+/** The process wide table, keyed on the string form of the AppID */
+struct InternedAppID::Table
+{
+    std::mutex lock;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+    /** The empty AppID, which is never removed so that default
+        constructing a handle doesn't need the lock */
+    Entry* empty = nullptr;
+    std::uint32_t nextId = 0;
+};
+
+/** Allocated once and never freed so that handles held in static
+    objects stay valid through exit */
+InternedAppID::Table& InternedAppID::table()
+{
+    static Table* table = [] {
+        auto tab = new Table;
+
+        /* The table's reference keeps it from ever being removed */
+        std::unique_ptr<Entry> empty{new Entry};
+        empty->hash = std::hash<std::string>{}(empty->str);
+        empty->id = tab->nextId++;
+        empty->refs = 1;
+        tab->empty = empty.get();
+        tab->entries.emplace(std::string{}, std::move(empty));
+
+        return tab;
+    }();
+    return *table;
+}
+
+/** Removes an entry that has no references left, with the lock held */
+void InternedAppID::erase(Table& tab, Entry* entry)
+{
+    auto it = tab.entries.find(entry->str);
+    if (it != tab.entries.end() && it->second.get() == entry)
+    {
+        tab.entries.erase(it);
+    }
+}
+
+/** Gets the entry for @str, adding it if needed, with a reference for
+    the caller */
+InternedAppID::Entry* InternedAppID::intern(const std::string& str, const AppID* appid)
+{
+    auto& tab = table();
+    std::lock_guard<std::mutex> lock(tab.lock);
+
+    auto it = tab.entries.find(str);
+    if (it != tab.entries.end())
+    {
+        it->second->refs++;
+        return it->second.get();
+    }
+
+    std::unique_ptr<Entry> entry{new Entry};
+    if (appid != nullptr)
+    {
+        entry->appid = *appid;
+    }
+    else
+    {
+        entry->appid = AppID::parse(str);
+        if (entry->appid.empty() && !str.empty())
+        {
+            entry->appid = AppID{AppID::Package::from_raw({}), AppID::AppName::from_raw(str),
+                                 AppID::Version::from_raw({})};
+        }
+    }
+    entry->str = str;
+    entry->hash = std::hash<std::string>{}(str);
+    entry->id = tab.nextId++;
+    entry->refs = 1;
+
+    auto retval = entry.get();
+    tab.entries.emplace(str, std::move(entry));
+    return retval;
+}
+
+/** Drops a reference, removing the entry from the table with the last
+    one. Only the last reference needs the lock. */
+void InternedAppID::release(Entry* entry)
+{
+    auto refs = entry->refs.load();
+    while (refs > 1)
+    {
+        if (entry->refs.compare_exchange_weak(refs, refs - 1))
+        {
+            return;
+        }
+    }
+
+    auto& tab = table();
+    std::lock_guard<std::mutex> lock(tab.lock);
+    if (--entry->refs == 0)
+    {
+        erase(tab, entry);
+    }
+}
+
+InternedAppID::InternedAppID(Entry* entry)
+    : entry_(entry)
+{
+}
+
+InternedAppID::InternedAppID()
+    : entry_(table().empty)
+{
+    entry_->refs++;
+}
+
+InternedAppID::InternedAppID(const AppID& appid)
+    : entry_(intern(appid.str(), &appid))
+{
+}
+
+InternedAppID::InternedAppID(const InternedAppID& b)
+    : entry_(b.entry_)
+{
+    entry_->refs++;
+}
+
+InternedAppID::~InternedAppID()
+{
+    release(entry_);
+}
+
+InternedAppID& InternedAppID::operator=(const InternedAppID& b)
+{
+    if (entry_ != b.entry_)
+    {
+        b.entry_->refs++;
+        release(entry_);
+        entry_ = b.entry_;
+    }
+    return *this;
+}
+
+InternedAppID InternedAppID::fromString(const std::string& appid)
+{
+    return InternedAppID{intern(appid, nullptr)};
+}
+
+bool InternedAppID::find(const std::string& appid, InternedAppID& interned)
+{
+    auto& tab = table();
+    std::lock_guard<std::mutex> lock(tab.lock);
+
+    auto it = tab.entries.find(appid);
+    if (it == tab.entries.end())
+    {
+        return false;
+    }
+
+    /* Take the reference with the lock held, the old one can wait */
+    it->second->refs++;
+    auto old = interned.entry_;
+    interned.entry_ = it->second.get();
+
+    if (--old->refs == 0)
+    {
+        erase(tab, old);
+    }
+    return true;
+}
+
+const AppID& InternedAppID::appid() const
+{
+    return entry_->appid;
+}
+
+const std::string& InternedAppID::str() const
+{
+    return entry_->str;
+}
+
+std::size_t InternedAppID::hash() const
+{
+    return entry_->hash;
+}
+
+std::uint32_t InternedAppID::id() const
+{
+    return entry_->id;
+}
+
+bool InternedAppID::operator<(const InternedAppID& b) const
+{
+    return entry_->id < b.entry_->id;
+}
+
+std::size_t InternedAppID::tableSize()
+{
+    auto& tab = table();
+    std::lock_guard<std::mutex> lock(tab.lock);
+    return tab.entries.size();
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
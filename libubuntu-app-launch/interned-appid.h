@@ -0,0 +1,107 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include "appid.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** A handle to an AppID in a process wide table. All the handles for
+    the same AppID point at the same entry, so comparing and hashing
+    them is done on the entry instead of the strings, and a set of them
+    costs a pointer per AppID.
+
+    Interning is for AppIDs that get stored, lookups use find() so that
+    they don't add to the table. Entries are reference counted and
+    removed when the last handle goes away, the table only holds the
+    AppIDs that are in use. Ordering is by when the AppID was interned,
+    it is consistent but not alphabetical. */
+class InternedAppID
+{
+public:
+    /** The empty AppID */
+    InternedAppID();
+    /** Interns the AppID */
+    explicit InternedAppID(const AppID& appid);
+    InternedAppID(const InternedAppID& b);
+    ~InternedAppID();
+
+    InternedAppID& operator=(const InternedAppID& b);
+
+    /** Interns an AppID from its string form, as std::string(AppID)
+        makes it. Strings that don't parse are kept as a legacy appname,
+        which turns back into the same string. */
+    static InternedAppID fromString(const std::string& appid);
+    /** Looks for an AppID that is already interned, by its string form.
+        Nothing is added to the table. */
+    static bool find(const std::string& appid, InternedAppID& interned);
+
+    const AppID& appid() const;
+    const std::string& str() const;
+    std::size_t hash() const;
+    std::uint32_t id() const;
+
+    bool operator==(const InternedAppID& b) const
+    {
+        return entry_ == b.entry_;
+    }
+    bool operator!=(const InternedAppID& b) const
+    {
+        return entry_ != b.entry_;
+    }
+    bool operator<(const InternedAppID& b) const;
+
+    /** Number of AppIDs in the table, for testing */
+    static std::size_t tableSize();
+
+private:
+    struct Entry;
+    struct Table;
+    Entry* entry_;
+
+    static Table& table();
+
+    explicit InternedAppID(Entry* entry);
+    static Entry* intern(const std::string& str, const AppID* appid);
+    static void release(Entry* entry);
+    static void erase(Table& tab, Entry* entry);
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
+
+namespace std
+{
+template <>
+struct hash<ubuntu::app_launch::InternedAppID>
+{
+    std::size_t operator()(const ubuntu::app_launch::InternedAppID& appid) const
+    {
+        return appid.hash();
+    }
+};
+}  // namespace std
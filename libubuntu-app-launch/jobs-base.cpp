@@ -26,6 +26,7 @@
 #include <unity/util/ResourcePtr.h>
 
 #include "application-impl-base.h"
+#include "application-impl-lazy.h"
 #include "helper-impl.h"
 #include "jobs-base.h"
 #include "jobs-systemd.h"
@@ -211,7 +212,7 @@ core::Signal<const std::shared_ptr<Application>&,
             upstartEventData* data = new upstartEventData{reg};
 
             handle_appPaused = managedDBusSignalConnection(
-                g_dbus_connection_signal_subscribe(reg->_dbus.get(),                /* bus */
+                g_dbus_connection_signal_subscribe(reg->dbus().get(),               /* bus */
                                                    nullptr,                         /* sender */
                                                    "com.canonical.UbuntuAppLaunch", /* interface */
                                                    "ApplicationPaused",             /* signal */
@@ -229,6 +230,7 @@ core::Signal<const std::shared_ptr<Application>&,
                                                            return;
                                                        }
 
+                                                       GLib::ContextThread::CallbackTimer timer(reg->thread);
                                                        auto sparams = share_glib(g_variant_ref(params));
                                                        auto manager = std::dynamic_pointer_cast<Base>(reg->jobs());
                                                        manager->pauseEventEmitted(manager->sig_appPaused, sparams, reg);
@@ -238,7 +240,7 @@ core::Signal<const std::shared_ptr<Application>&,
                                                        auto data = reinterpret_cast<upstartEventData*>(user_data);
                                                        delete data;
                                                    }), /* user data destroy */
-                reg->_dbus);
+                reg->dbus());
 
             return true;
         });
@@ -260,7 +262,7 @@ core::Signal<const std::shared_ptr<Application>&,
             upstartEventData* data = new upstartEventData{reg};
 
             handle_appResumed = managedDBusSignalConnection(
-                g_dbus_connection_signal_subscribe(reg->_dbus.get(),                /* bus */
+                g_dbus_connection_signal_subscribe(reg->dbus().get(),               /* bus */
                                                    nullptr,                         /* sender */
                                                    "com.canonical.UbuntuAppLaunch", /* interface */
                                                    "ApplicationResumed",            /* signal */
@@ -278,6 +280,7 @@ core::Signal<const std::shared_ptr<Application>&,
                                                            return;
                                                        }
 
+                                                       GLib::ContextThread::CallbackTimer timer(reg->thread);
                                                        auto sparams = share_glib(g_variant_ref(params));
                                                        auto manager = std::dynamic_pointer_cast<Base>(reg->jobs());
                                                        manager->pauseEventEmitted(manager->sig_appResumed, sparams,
@@ -288,7 +291,7 @@ core::Signal<const std::shared_ptr<Application>&,
                                                        auto data = reinterpret_cast<upstartEventData*>(user_data);
                                                        delete data;
                                                    }), /* user data destroy */
-                reg->_dbus);
+                reg->dbus());
 
             return true;
         });
@@ -416,7 +419,11 @@ core::Signal<const std::shared_ptr<Helper>&, const std::shared_ptr<Helper::Insta
 }
 
 /** Take the GVariant of parameters and turn them into an application and
-    and instance. Easier to read in the smaller function */
+    and instance. Easier to read in the smaller function. The application
+    is a lazy handle, it isn't created until the manager uses more than
+    the AppID as most of the time that is all it needs. The app stores
+    aren't asked about it here, that would put them back on the GLib
+    thread for every signal, using an unknown application throws. */
 std::tuple<std::shared_ptr<Application>, std::shared_ptr<Application::Instance>> Base::managerParams(
     const std::shared_ptr<GVariant>& params, const std::shared_ptr<Registry::Impl>& reg)
 {
@@ -427,8 +434,12 @@ std::tuple<std::shared_ptr<Application>, std::shared_ptr<Application::Instance>>
     const gchar* cinstid = nullptr;
     g_variant_get(params.get(), "(&s&s)", &cappid, &cinstid);
 
-    auto appid = reg->find(cappid);
-    app = reg->createApp(appid);
+    if (cappid == nullptr || cappid[0] == '\0')
+    {
+        throw std::runtime_error{"Manager signal without an AppID"};
+    }
+
+    app = std::make_shared<app_impls::Lazy>(cappid, reg);
 
     /* TODO Instance */
 
@@ -467,7 +478,7 @@ guint Base::managerSignalHelper(const std::string& signalname,
     managerEventData* focusdata = new managerEventData{reg, responsefunc};
 
     return g_dbus_connection_signal_subscribe(
-        reg->_dbus.get(),                /* bus */
+        reg->dbus().get(),               /* bus */
         nullptr,                         /* sender */
         "com.canonical.UbuntuAppLaunch", /* interface */
         signalname.c_str(),              /* signal */
@@ -485,6 +496,8 @@ guint Base::managerSignalHelper(const std::string& signalname,
                 return;
             }
 
+            GLib::ContextThread::CallbackTimer timer(reg->thread);
+
             /* If we're still conneted and the manager has been cleared
                we'll just be a no-op */
             auto ljobs = std::dynamic_pointer_cast<Base>(reg->jobs());
@@ -560,7 +573,7 @@ void Base::setManager(std::shared_ptr<Registry::Manager> manager)
                                        this code. */
                                 });
                         }),
-                    reg->_dbus);
+                    reg->dbus());
                 handle_managerSignalStarting = managedDBusSignalConnection(
                     managerSignalHelper(
                         "UnityStartingBroadcast",
@@ -586,7 +599,7 @@ void Base::setManager(std::shared_ptr<Registry::Manager> manager)
                                     }
                                 });
                         }),
-                    reg->_dbus);
+                    reg->dbus());
                 handle_managerSignalResume = managedDBusSignalConnection(
                     managerSignalHelper(
                         "UnityResumeRequest",
@@ -611,7 +624,7 @@ void Base::setManager(std::shared_ptr<Registry::Manager> manager)
                                     }
                                 });
                         }),
-                    reg->_dbus);
+                    reg->dbus());
 
                 return true;
             }))
@@ -628,6 +641,19 @@ void Base::clearManager()
     manager_.reset();
 }
 
+/** A helper unit parked by the pool has been claimed, until now it was
+    hidden so it gets its started signal now. Waits so that the instance
+    is listed by the time the claim returns. */
+void Base::parkedClaimed(const AppID& appid, const std::string& job, const std::string& instance)
+{
+    auto reg = getReg();
+    reg->thread.executeOnThread<bool>([this, reg, appid, job, instance]() {
+        reg->helperPool.forget(job, appid.str(), instance);
+        jobStarted()(job, appid.str(), instance);
+        return true;
+    });
+}
+
 /** Get application objects for all of the applications based
     on the appids associated with the application jobs */
 std::list<std::shared_ptr<Application>> Base::runningApps()
@@ -681,6 +707,160 @@ std::list<std::shared_ptr<Helper>> Base::runningHelpers(const Helper::Type& type
     return helpers;
 }
 
+/** Checks whether an AppID string matches a watch filter, which is either
+    the full AppID or the package it is in. */
+bool Base::appIdMatches(const std::string& appid, const std::string& filter)
+{
+    if (appid.size() == filter.size())
+    {
+        return appid == filter;
+    }
+
+    return appid.size() > filter.size() && appid[filter.size()] == '_' && appid.compare(0, filter.size(), filter) == 0;
+}
+
+/** Watch on the job signals, filtered on the strings before
+    any application objects are built */
+class JobAppWatch : public Base::AppWatch
+{
+public:
+    JobAppWatch(core::Signal<const std::string&, const std::string&, const std::string&>& signal,
+                const std::list<std::string>& appjobs,
+                const std::string& filter,
+                const Base::AppWatchCallback& callback)
+        : connection_(signal.connect([appjobs, filter, callback](const std::string& job, const std::string& appid,
+                                                                 const std::string& instanceid) {
+            if (!Base::appIdMatches(appid, filter))
+            {
+                return;
+            }
+
+            if (std::find(appjobs.begin(), appjobs.end(), job) == appjobs.end())
+            {
+                /* Not an application */
+                return;
+            }
+
+            callback(appid, {});
+        }))
+    {
+    }
+
+private:
+    core::ScopedConnection connection_;
+};
+
+/** Data passed through GDBus for a pause or resume watch */
+struct PauseWatchData
+{
+    std::string filter;
+    Base::AppWatchCallback callback;
+};
+
+/** Watch on the pause and resume signals on the bus. When the filter is a
+    full AppID it is put in the match rule so the bus only sends us signals
+    for that application. */
+class PauseAppWatch : public Base::AppWatch
+{
+public:
+    PauseAppWatch(const std::shared_ptr<Registry::Impl>& reg,
+                  const std::string& signal,
+                  const std::string& filter,
+                  const Base::AppWatchCallback& callback)
+    {
+        auto id = reg->thread.executeOnThread<guint>([reg, signal, filter, callback]() {
+            auto data = new PauseWatchData{filter, callback};
+            /* Only a full AppID can be matched by the bus */
+            const gchar* arg0 = AppID::valid(filter) ? filter.c_str() : nullptr;
+
+            return g_dbus_connection_signal_subscribe(
+                reg->dbus().get(),               /* bus */
+                nullptr,                         /* sender */
+                "com.canonical.UbuntuAppLaunch", /* interface */
+                signal.c_str(),                  /* signal */
+                "/",                             /* path */
+                arg0,                            /* arg0 */
+                G_DBUS_SIGNAL_FLAGS_NONE,
+                [](GDBusConnection*, const gchar*, const gchar*, const gchar*, const gchar*, GVariant* params,
+                   gpointer user_data) -> void {
+                    auto data = reinterpret_cast<PauseWatchData*>(user_data);
+
+                    if (!g_variant_is_of_type(params, G_VARIANT_TYPE("(ssat)")))
+                    {
+                        g_warning("Pause signal with invalid parameters: %s", g_variant_get_type_string(params));
+                        return;
+                    }
+
+                    const gchar* cappid = nullptr;
+                    GVariantIter* vpids = nullptr;
+                    g_variant_get(params, "(&s&sat)", &cappid, nullptr, &vpids);
+
+                    std::vector<pid_t> pids;
+                    guint64 pid;
+                    while (g_variant_iter_loop(vpids, "t", &pid))
+                    {
+                        pids.emplace_back(pid);
+                    }
+                    g_variant_iter_free(vpids);
+
+                    if (!Base::appIdMatches(cappid, data->filter))
+                    {
+                        return;
+                    }
+
+                    data->callback(cappid, pids);
+                },    /* callback */
+                data, /* user data */
+                [](gpointer user_data) {
+                    auto data = reinterpret_cast<PauseWatchData*>(user_data);
+                    delete data;
+                }); /* user data destroy */
+        });
+
+        handle_ = managedDBusSignalConnection(id, reg->dbus());
+    }
+
+private:
+    ManagedDBusSignalConnection handle_{DBusSignalUnsubscriber{}};
+};
+
+/** Watch application events for a single AppID or package. Unlike the
+    application signals no objects are built for events that don't match. */
+std::unique_ptr<Base::AppWatch> Base::watchApps(AppEvent event,
+                                                const std::string& filter,
+                                                const AppWatchCallback& callback)
+{
+    switch (event)
+    {
+        case AppEvent::STARTED:
+            return std::unique_ptr<AppWatch>(new JobAppWatch(jobStarted(), allApplicationJobs_, filter, callback));
+        case AppEvent::STOPPED:
+            return std::unique_ptr<AppWatch>(new JobAppWatch(jobStopped(), allApplicationJobs_, filter, callback));
+        case AppEvent::PAUSED:
+            return std::unique_ptr<AppWatch>(new PauseAppWatch(getReg(), "ApplicationPaused", filter, callback));
+        case AppEvent::RESUMED:
+            return std::unique_ptr<AppWatch>(new PauseAppWatch(getReg(), "ApplicationResumed", filter, callback));
+    }
+
+    throw std::runtime_error{"Unknown application event to watch"};
+}
+
+/** Find the application instance for a PID, by default we don't know
+    how to do that without asking each instance. */
+std::pair<std::shared_ptr<Application>, std::shared_ptr<Application::Instance>> Base::findInstanceByPid(pid_t pid)
+{
+    return {};
+}
+
+/** A snapshot of the running instances, by default we don't have a way
+    to get them all at once so it is empty. */
+std::shared_ptr<const Registry::Snapshot> Base::snapshot()
+{
+    auto snapshot = std::make_shared<Registry::Snapshot>();
+    snapshot->sequence = getReg()->changeFeed().sequence();
+    return snapshot;
+}
+
 }  // namespace manager
 
 namespace instance
@@ -714,7 +894,7 @@ bool Base::hasPid(pid_t pid)
 {
     auto vpids = pids();
     bool hasit = std::find(vpids.begin(), vpids.end(), pid) != vpids.end();
-    g_debug("Checking for PID %d on AppID '%s' result: %s", pid, std::string(appId_).c_str(), hasit ? "YES" : "NO");
+    g_debug("Checking for PID %d on AppID '%s' result: %s", pid, appId_.str().c_str(), hasit ? "YES" : "NO");
     return hasit;
 }
 
@@ -722,7 +902,7 @@ bool Base::hasPid(pid_t pid)
     cgroup and tells Zeitgeist that we've left the application. */
 void Base::pause()
 {
-    g_debug("Pausing application: %s", std::string(appId_).c_str());
+    g_debug("Pausing application: %s", appId_.str().c_str());
     registry_->zgSendEvent(appId_, ZEITGEIST_ZG_LEAVE_EVENT);
 
     auto pids = forAllPids([this](pid_t pid) {
@@ -739,7 +919,7 @@ void Base::pause()
     cgroup and tells Zeitgeist that we're accessing the application. */
 void Base::resume()
 {
-    g_debug("Resuming application: %s", std::string(appId_).c_str());
+    g_debug("Resuming application: %s", appId_.str().c_str());
     registry_->zgSendEvent(appId_, ZEITGEIST_ZG_ACCESS_EVENT);
 
     auto pids = forAllPids([this](pid_t pid) {
@@ -756,14 +936,14 @@ void Base::resume()
     cgroup and tells the Shell to focus the application. */
 void Base::focus()
 {
-    g_debug("Focusing application: %s", std::string(appId_).c_str());
+    g_debug("Focusing application: %s", appId_.str().c_str());
 
     GError* error = nullptr;
     GVariantBuilder params;
     g_variant_builder_init(&params, G_VARIANT_TYPE_TUPLE);
-    g_variant_builder_add_value(&params, g_variant_new_string(std::string(appId_).c_str()));
+    g_variant_builder_add_value(&params, g_variant_new_string(appId_.str().c_str()));
     g_variant_builder_add_value(&params, g_variant_new_string(instance_.c_str()));
-    g_dbus_connection_emit_signal(registry_->_dbus.get(),          /* bus */
+    g_dbus_connection_emit_signal(registry_->dbus().get(),         /* bus */
                                   nullptr,                         /* destination */
                                   "/",                             /* path */
                                   "com.canonical.UbuntuAppLaunch", /* interface */
@@ -773,7 +953,7 @@ void Base::focus()
 
     if (error != nullptr)
     {
-        g_warning("Unable to emit signal 'UnityFocusRequest' for appid '%s': '%s'", std::string(appId_).c_str(),
+        g_warning("Unable to emit signal 'UnityFocusRequest' for appid '%s': '%s'", appId_.str().c_str(),
                   error->message);
         g_error_free(error);
     }
@@ -843,12 +1023,12 @@ void Base::pidListToDbus(const std::shared_ptr<Registry::Impl>& reg,
 
     GVariantBuilder params;
     g_variant_builder_init(&params, G_VARIANT_TYPE_TUPLE);
-    g_variant_builder_add_value(&params, g_variant_new_string(std::string(appid).c_str()));
+    g_variant_builder_add_value(&params, g_variant_new_string(appid.str().c_str()));
     g_variant_builder_add_value(&params, g_variant_new_string(instanceid.c_str()));
     g_variant_builder_add_value(&params, vpids.get());
 
     GError* error = nullptr;
-    g_dbus_connection_emit_signal(reg->_dbus.get(),                /* bus */
+    g_dbus_connection_emit_signal(reg->dbus().get(),               /* bus */
                                   nullptr,                         /* destination */
                                   "/",                             /* path */
                                   "com.canonical.UbuntuAppLaunch", /* interface */
@@ -858,7 +1038,7 @@ void Base::pidListToDbus(const std::shared_ptr<Registry::Impl>& reg,
 
     if (error != nullptr)
     {
-        g_warning("Unable to emit signal '%s' for appid '%s': %s", signal.c_str(), std::string(appid).c_str(),
+        g_warning("Unable to emit signal '%s' for appid '%s': %s", signal.c_str(), appid.str().c_str(),
                   error->message);
         g_error_free(error);
     }
@@ -888,6 +1068,22 @@ const oom::Score Base::getOomAdjustment()
         throw std::runtime_error("No PID for application: " + std::string(appId_));
     }
 
+    try
+    {
+        return oomValueFromPid(pid);
+    }
+    catch (std::runtime_error& e)
+    {
+        throw std::runtime_error("Unable to access OOM value for '" + appId_.str() + "': " + e.what());
+    }
+}
+
+/** Reads the OOM value of a PID from proc
+
+    \param pid PID to read the OOM value of
+*/
+oom::Score Base::oomValueFromPid(pid_t pid)
+{
     auto path = pidToOomPath(pid);
     GError* error = nullptr;
     gchar* content = nullptr;
@@ -901,8 +1097,8 @@ const oom::Score Base::getOomAdjustment()
     {
         auto serror = unique_glib(error);
         error = nullptr;
-        throw std::runtime_error("Unable to access OOM value for '" + std::string(appId_) + "' primary PID '" +
-                                 std::to_string(pid) + "' because: " + serror->message);
+        throw std::runtime_error("Unable to read OOM value for PID '" + std::to_string(pid) + "' because: " +
+                                 serror->message);
     }
 
     auto score = static_cast<oom::Score>(std::atoi(content));
@@ -59,6 +59,11 @@ public:
         return instance_;
     }
 
+    const std::string& getJob() const
+    {
+        return job_;
+    }
+
     const AppID& getAppId() const
     {
         return appId_;
@@ -68,6 +73,8 @@ public:
     void setOomAdjustment(const oom::Score score) override;
     const oom::Score getOomAdjustment() override;
 
+    static oom::Score oomValueFromPid(pid_t pid);
+
 protected:
     /** Application ID */
     const AppID appId_;
@@ -132,6 +139,10 @@ public:
 
     virtual std::vector<std::shared_ptr<instance::Base>> instances(const AppID& appID, const std::string& job) = 0;
 
+    virtual std::pair<std::shared_ptr<Application>, std::shared_ptr<Application::Instance>> findInstanceByPid(
+        pid_t pid);
+    virtual std::shared_ptr<const Registry::Snapshot> snapshot();
+
     const std::list<std::string>& getAllApplicationJobs() const;
 
     static std::shared_ptr<Base> determineFactory(const std::shared_ptr<Registry::Impl>& registry);
@@ -167,10 +178,35 @@ public:
     virtual core::Signal<const std::string&, const std::string&, const std::string&, Registry::FailureType>&
         jobFailed() = 0;
 
+    /* Filtered application watches */
+    /** Application events that can be watched for a single AppID or package */
+    enum class AppEvent
+    {
+        STARTED, /**< Application started */
+        STOPPED, /**< Application stopped */
+        PAUSED,  /**< Application paused */
+        RESUMED  /**< Application resumed */
+    };
+    /** Handle for a filtered watch, the callback isn't called once it is destroyed */
+    class AppWatch
+    {
+    public:
+        virtual ~AppWatch() = default;
+    };
+    /** Gets the AppID and PIDs of the matching event, the PIDs are only set for pause and resume */
+    typedef std::function<void(const std::string& appid, const std::vector<pid_t>& pids)> AppWatchCallback;
+
+    virtual std::unique_ptr<AppWatch> watchApps(AppEvent event,
+                                                const std::string& filter,
+                                                const AppWatchCallback& callback);
+    static bool appIdMatches(const std::string& appid, const std::string& filter);
+
     /* App manager */
     virtual void setManager(std::shared_ptr<Registry::Manager> manager);
     virtual void clearManager();
 
+    virtual void parkedClaimed(const AppID& appid, const std::string& job, const std::string& instance);
+
 protected:
     /** Accessor function to the registry that ensures we can still
         get it, which we always should be able to, but in case. */
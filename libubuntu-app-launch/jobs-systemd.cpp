@@ -19,6 +19,7 @@
 
 #include "jobs-systemd.h"
 #include "application-impl-base.h"
+#include "exec-template.h"
 #include "registry-impl.h"
 #include "second-exec-core.h"
 #include "string-util.h"
@@ -33,6 +34,7 @@ extern "C" {
 #include <unistd.h>
 
 #include <algorithm>
+#include <iterator>
 #include <numeric>
 #include <regex>
 #include <unity/util/GlibMemory.h>
@@ -60,7 +62,7 @@ public:
                      const std::shared_ptr<Registry::Impl>& registry);
     virtual ~SystemD()
     {
-        g_debug("Destroying a SystemD for '%s' instance '%s'", std::string(appId_).c_str(), instance_.c_str());
+        g_debug("Destroying a SystemD for '%s' instance '%s'", appId_.str().c_str(), instance_.c_str());
     }
 
     /* Query lifecycle */
@@ -79,7 +81,7 @@ SystemD::SystemD(const AppID& appId,
                  const std::shared_ptr<Registry::Impl>& registry)
     : Base(appId, job, instance, urls, registry)
 {
-    g_debug("Creating a new SystemD for '%s' instance '%s'", std::string(appId).c_str(), instance.c_str());
+    g_debug("Creating a new SystemD for '%s' instance '%s'", appId.str().c_str(), instance.c_str());
 }
 
 pid_t SystemD::primaryPid()
@@ -129,12 +131,42 @@ SystemD::SystemD(const std::shared_ptr<Registry::Impl>& registry)
         cgroup_root_ = gcgroup_root;
     }
 
+    auto gproc_root = getenv("UBUNTU_APP_LAUNCH_SYSTEMD_PROC_ROOT");
+    proc_root_ = gproc_root == nullptr ? "/proc" : gproc_root;
+
     if (getenv("UBUNTU_APP_LAUNCH_SYSTEMD_NO_RESET") != nullptr)
     {
         noResetUnits_ = true;
     }
+}
+
+/** Connects to the user bus and starts tracking the units on it the first
+    time they're needed, so registries that never look at running jobs
+    don't pay for the connection or the initial list of units. The setup
+    is done on the thread so that the first users are serialized. */
+void SystemD::trackUnits()
+{
+    if (G_LIKELY(trackingUnits_))
+    {
+        return;
+    }
+
+    auto reg = getReg();
+    reg->thread.executeOnThread<bool>([this, reg]() {
+        if (!trackingUnits_)
+        {
+            setupUserbus(reg);
+            trackingUnits_ = true;
+        }
+        return true;
+    });
+}
 
-    setupUserbus(registry);
+/** Get the user bus, connecting if we haven't yet */
+std::shared_ptr<GDBusConnection> SystemD::userbus()
+{
+    trackUnits();
+    return userbus_;
 }
 
 void SystemD::setupUserbus(const std::shared_ptr<Registry::Impl>& reg)
@@ -247,8 +279,9 @@ void SystemD::setupUserbus(const std::shared_ptr<Registry::Impl>& reg)
 
                                                    try
                                                    {
-                                                       auto info = pthis->unitNew(unitname, unitpath, pthis->userbus_);
-                                                       pthis->sig_jobStarted(info.job, info.appid, info.inst);
+                                                       auto reg = pthis->getReg();
+                                                       GLib::ContextThread::CallbackTimer timer(reg->thread);
+                                                       pthis->unitNew(unitname, unitpath, pthis->userbus_, true);
                                                    }
                                                    catch (std::runtime_error& e)
                                                    {
@@ -301,7 +334,15 @@ void SystemD::setupUserbus(const std::shared_ptr<Registry::Impl>& reg)
                         return;
                     }
 
-                    pthis->unitRemoved(unitname, unitpath);
+                    try
+                    {
+                        GLib::ContextThread::CallbackTimer timer(pthis->getReg()->thread);
+                        pthis->unitRemoved(unitname, unitpath);
+                    }
+                    catch (std::runtime_error& e)
+                    {
+                        g_warning("%s", e.what());
+                    }
                 },        /* callback */
                 this,     /* user data */
                 nullptr), /* user data destroy */
@@ -361,7 +402,7 @@ void SystemD::getInitialUnits(const std::shared_ptr<GDBusConnection>& bus, const
     {
         try
         {
-            unitNew(id, jobPath, bus);
+            unitNew(id, jobPath, bus, false);
         }
         catch (std::runtime_error& e)
         {
@@ -369,97 +410,85 @@ void SystemD::getInitialUnits(const std::shared_ptr<GDBusConnection>& bus, const
     }
 }
 
-std::string SystemD::findEnv(const std::string& value, std::list<std::pair<std::string, std::string>>& env)
-{
-    std::string retval;
-    auto entry = std::find_if(env.begin(), env.end(),
-                              [&value](std::pair<std::string, std::string>& entry) { return entry.first == value; });
-
-    if (entry != env.end())
-    {
-        retval = entry->second;
-    }
-
-    return retval;
-}
-
-void SystemD::removeEnv(const std::string& value, std::list<std::pair<std::string, std::string>>& env)
-{
-    auto entry = std::find_if(env.begin(), env.end(),
-                              [&value](std::pair<std::string, std::string>& entry) { return entry.first == value; });
-
-    if (entry != env.end())
-    {
-        env.erase(entry);
-    }
-}
-
-int SystemD::envSize(std::list<std::pair<std::string, std::string>>& env)
-{
-    int len = std::string{"Environment="}.length();
-
-    for (const auto& entry : env)
-    {
-        len += 3; /* two quotes, one space */
-        len += entry.first.length();
-        len += entry.second.length();
-    }
-
-    len -= 1; /* We account for a space each time but the first doesn't have */
-
-    return len;
-}
-
-std::vector<std::string> SystemD::parseExec(std::list<std::pair<std::string, std::string>>& env)
+std::vector<std::string> SystemD::parseExec(const LaunchEnv& env)
 {
-    auto exec = findEnv("APP_EXEC", env);
+    auto exec = env.get("APP_EXEC");
     if (exec.empty())
     {
         g_warning("Application exec line is empty?!?!?");
         return {};
     }
-    auto uris = findEnv("APP_URIS", env);
+    auto uris = env.get("APP_URIS");
 
     g_debug("Exec line: %s", exec.c_str());
     g_debug("App URLS:  %s", uris.c_str());
 
-    auto execarray = desktop_exec_parse(exec.c_str(), uris.c_str());
-
-    std::vector<std::string> retval;
-    for (unsigned int i = 0; i < execarray->len; i++)
+    std::vector<std::string> urilist;
+    if (!uris.empty())
     {
-        auto cstr = g_array_index(execarray, gchar*, i);
-        if (cstr != nullptr)
+        GError* error{nullptr};
+        gchar** splituris{nullptr};
+        g_shell_parse_argv(uris.c_str(), nullptr, &splituris, &error);
+
+        if (error != nullptr)
+        {
+            g_warning("Unable to parse URIs '%s': %s", uris.c_str(), error->message);
+            g_error_free(error);
+            /* Continuing without URIs */
+        }
+        else
         {
-            retval.emplace_back(cstr);
+            for (int i = 0; splituris[i] != nullptr; i++)
+            {
+                urilist.emplace_back(splituris[i]);
+            }
+            g_strfreev(splituris);
         }
     }
 
-    /* This seems to work better than array_free(), I can't figure out why */
-    auto strv = (gchar**)g_array_free(execarray, FALSE);
-    g_strfreev(strv);
+    /* The Exec line only gets tokenized the first time we see it */
+    std::vector<std::string> tokens;
+    try
+    {
+        tokens = ExecTemplate::compile(exec)->expand(urilist);
+    }
+    catch (std::runtime_error& e)
+    {
+        g_warning("%s", e.what());
+    }
 
-    if (retval.empty())
+    if (tokens.empty())
     {
         g_warning("After parsing 'APP_EXEC=%s' we ended up with no tokens", exec.c_str());
     }
 
-    /* See if we need the xmir helper */
-    if (findEnv("APP_XMIR_ENABLE", env) == "1" && getenv("DISPLAY") == nullptr)
+    /* Everything that goes in front of the Exec line */
+    std::vector<std::string> retval;
+    retval.reserve(tokens.size() + 5);
+
+    /* See if we're doing apparmor by hand */
+    auto appexecpolicy = env.get("APP_EXEC_POLICY");
+    if (!appexecpolicy.empty() && appexecpolicy != "unconfined")
     {
-        retval.emplace(retval.begin(), findEnv("APP_ID", env));
+        retval.emplace_back("aa-exec");
+        retval.emplace_back("-p");
+        retval.emplace_back(appexecpolicy);
+    }
 
+    /* See if we need the xmir helper */
+    if (env.get("APP_XMIR_ENABLE") == "1" && getenv("DISPLAY") == nullptr)
+    {
         auto snapenv = getenv("SNAP");
         if (snapenv == nullptr)
         {
             auto xmirenv = getenv("UBUNTU_APP_LAUNCH_XMIR_HELPER");
             if (xmirenv == nullptr)
             {
-                retval.emplace(retval.begin(), XMIR_HELPER);
+                retval.emplace_back(XMIR_HELPER);
             }
             else
             {
-                retval.emplace(retval.begin(), xmirenv);
+                retval.emplace_back(xmirenv);
             }
         }
         else
@@ -468,19 +497,14 @@ std::vector<std::string> SystemD::parseExec(std::list<std::pair<std::string, std
                gets us back into the snap */
             std::string snappath{snapenv};
 
-            retval.emplace(retval.begin(), snappath + SNAPPY_XMIR);
+            retval.emplace_back(snappath + SNAPPY_XMIR);
         }
-    }
 
-    /* See if we're doing apparmor by hand */
-    auto appexecpolicy = findEnv("APP_EXEC_POLICY", env);
-    if (!appexecpolicy.empty() && appexecpolicy != "unconfined")
-    {
-        retval.emplace(retval.begin(), appexecpolicy);
-        retval.emplace(retval.begin(), "-p");
-        retval.emplace(retval.begin(), "aa-exec");
+        retval.emplace_back(env.get("APP_ID"));
     }
 
+    std::move(tokens.begin(), tokens.end(), std::back_inserter(retval));
+
     return retval;
 }
 
@@ -495,9 +519,9 @@ void SystemD::application_start_cb(GObject* obj, GAsyncResult* res, gpointer use
 {
     auto data = static_cast<StartCHelper*>(user_data);
 
-    tracepoint(ubuntu_app_launch, libual_start_message_callback, std::string(data->ptr->appId_).c_str());
+    tracepoint(ubuntu_app_launch, libual_start_message_callback, data->ptr->appId_.str().c_str());
 
-    g_debug("Started Message Callback: %s", std::string(data->ptr->appId_).c_str());
+    g_debug("Started Message Callback: %s", data->ptr->appId_.str().c_str());
 
     GError* error{nullptr};
 
@@ -514,12 +538,30 @@ void SystemD::application_start_cb(GObject* obj, GAsyncResult* res, gpointer use
             if (g_strcmp0(remote_error, "org.freedesktop.systemd1.UnitExists") == 0)
             {
                 auto urls = instance::SystemD::urlsToStrv(data->ptr->urls_);
-                second_exec(data->bus.get(),                                     /* DBus */
-                            data->ptr->registry_->thread.getCancellable().get(), /* cancellable */
-                            data->ptr->primaryPid(),                             /* primary pid */
-                            std::string(data->ptr->appId_).c_str(),              /* appid */
-                            data->ptr->instance_.c_str(),                        /* instance */
-                            urls.get());                                         /* urls */
+                auto pid = data->ptr->primaryPid();
+
+                /* If the index has heard back about every connection we can
+                   use it, otherwise second_exec() has to ask the bus */
+                auto& index = data->ptr->registry_->busPidIndex();
+                std::vector<std::string> connections;
+                std::vector<const gchar*> cconnections;
+                if (index.ready())
+                {
+                    connections = index.connections(pid);
+                    for (const auto& connection : connections)
+                    {
+                        cconnections.push_back(connection.c_str());
+                    }
+                    cconnections.push_back(nullptr);
+                }
+
+                second_exec(data->bus.get(),                                       /* DBus */
+                            data->ptr->registry_->thread.getCancellable().get(),   /* cancellable */
+                            pid,                                                   /* primary pid */
+                            data->ptr->appId_.str().c_str(),                       /* appid */
+                            data->ptr->instance_.c_str(),                          /* instance */
+                            urls.get(),                                            /* urls */
+                            cconnections.empty() ? nullptr : cconnections.data()); /* connections */
             }
 
             g_free(remote_error);
@@ -537,40 +579,6 @@ void SystemD::application_start_cb(GObject* obj, GAsyncResult* res, gpointer use
     delete data;
 }
 
-void SystemD::copyEnv(const std::string& envname, std::list<std::pair<std::string, std::string>>& env)
-{
-    if (!findEnv(envname, env).empty())
-    {
-        g_debug("Already a value set for '%s' ignoring", envname.c_str());
-        return;
-    }
-
-    auto cvalue = getenv(envname.c_str());
-    g_debug("Copying Environment: %s", envname.c_str());
-    if (cvalue != nullptr)
-    {
-        std::string value{cvalue};
-        env.emplace_back(std::make_pair(envname, value));
-    }
-    else
-    {
-        g_debug("Unable to copy environment '%s'", envname.c_str());
-    }
-}
-
-void SystemD::copyEnvByPrefix(const std::string& prefix, std::list<std::pair<std::string, std::string>>& env)
-{
-    for (unsigned int i = 0; environ[i] != nullptr; i++)
-    {
-        if (g_str_has_prefix(environ[i], prefix.c_str()))
-        {
-            std::string envname = environ[i];
-            envname.erase(envname.find('='));
-            copyEnv(envname, env);
-        }
-    }
-}
-
 std::shared_ptr<Application::Instance> SystemD::launch(
     const AppID& appId,
     const std::string& job,
@@ -599,55 +607,40 @@ std::shared_ptr<Application::Instance> SystemD::launch(
             timeout = 0;
         }
 
-        handshake_t* handshake{nullptr};
-
-        if (isApplication)
-        {
-            handshake = starting_handshake_start(appIdStr.c_str(), instance.c_str(), timeout);
-            if (handshake == nullptr)
-            {
-                g_warning("Unable to setup starting handshake");
-            }
-        }
-
         /* Figure out the unit name for the job */
-        auto unitname = unitName(SystemD::UnitInfo{appIdStr, job, instance});
+        auto unitname = unitName(appId.str(), job, instance);
 
         /* Build up our environment */
-        auto env = getenv();
+        LaunchEnv env{getenv()};
 
-        env.emplace_back(std::make_pair("APP_ID", appIdStr));                           /* Application ID */
-        env.emplace_back(std::make_pair("APP_LAUNCHER_PID", std::to_string(getpid()))); /* Who we are, for bugs */
+        env.set("APP_ID", appIdStr);                           /* Application ID */
+        env.set("APP_LAUNCHER_PID", std::to_string(getpid())); /* Who we are, for bugs */
 
-        copyEnv("DISPLAY", env);
+        env.copyHost("DISPLAY");
 
         for (const auto& prefix : {"DBUS_", "MIR_", "UBUNTU_APP_LAUNCH_"})
         {
-            copyEnvByPrefix(prefix, env);
+            env.copyHostByPrefix(prefix);
         }
 
         /* If we're in deb mode and launching legacy apps, they're gonna need
          * more context, they really have no other way to get it. */
         if (g_getenv("SNAP") == nullptr && appId.package.value().empty())
         {
-            copyEnvByPrefix("QT_", env);
-            copyEnvByPrefix("XDG_", env);
-            copyEnv("UBUNTU_APP_LAUNCH_XMIR_PATH", env);
+            env.copyHostByPrefix("QT_");
+            env.copyHostByPrefix("XDG_");
+            env.copyHost("UBUNTU_APP_LAUNCH_XMIR_PATH");
 
             /* If we're in Unity8 we don't want to pass it's platform, we want
              * an application platform. */
-            if (findEnv("QT_QPA_PLATFORM", env) == "mirserver")
+            if (env.get("QT_QPA_PLATFORM") == "mirserver")
             {
-                removeEnv("QT_QPA_PLATFORM", env);
-                env.emplace_back(std::make_pair("QT_QPA_PLATFORM", "ubuntumirclient"));
+                env.set("QT_QPA_PLATFORM", "ubuntumirclient");
             }
         }
 
         /* Mir socket if we don't have one in our env */
-        if (findEnv("MIR_SOCKET", env).empty())
-        {
-            env.emplace_back(std::make_pair("MIR_SOCKET", g_get_user_runtime_dir() + std::string{"/mir_socket"}));
-        }
+        env.setDefault("MIR_SOCKET", g_get_user_runtime_dir() + std::string{"/mir_socket"});
 
         if (!urls.empty())
         {
@@ -675,12 +668,12 @@ std::shared_ptr<Application::Instance> SystemD::launch(
                 }
             };
             auto urlstring = std::accumulate(urls.begin(), urls.end(), std::string{}, accumfunc);
-            env.emplace_back(std::make_pair("APP_URIS", urlstring));
+            env.set("APP_URIS", urlstring);
         }
 
         if (mode == launchMode::TEST)
         {
-            env.emplace_back(std::make_pair("QT_LOAD_TESTABILITY", "1"));
+            env.set("QT_LOAD_TESTABILITY", "1");
         }
 
         /* Convert to GVariant */
@@ -747,12 +740,13 @@ std::shared_ptr<Application::Instance> SystemD::launch(
         g_variant_builder_close(&builder);
 
         /* Working Directory */
-        if (!findEnv("APP_DIR", env).empty())
+        auto appdir = env.get("APP_DIR");
+        if (!appdir.empty())
         {
             g_variant_builder_open(&builder, G_VARIANT_TYPE_TUPLE);
             g_variant_builder_add_value(&builder, g_variant_new_string("WorkingDirectory"));
             g_variant_builder_open(&builder, G_VARIANT_TYPE_VARIANT);
-            g_variant_builder_add_value(&builder, g_variant_new_string(findEnv("APP_DIR", env).c_str()));
+            g_variant_builder_add_value(&builder, g_variant_new_string(appdir.c_str()));
             g_variant_builder_close(&builder);
             g_variant_builder_close(&builder);
         }
@@ -763,25 +757,17 @@ std::shared_ptr<Application::Instance> SystemD::launch(
               "INSTANCE_ID", "MIR_SERVER_PLATFORM_PATH", "MIR_SERVER_PROMPT_FILE", "MIR_SERVER_HOST_SOCKET",
               "UBUNTU_APP_LAUNCH_OOM_HELPER", "UBUNTU_APP_LAUNCH_LEGACY_ROOT", "UBUNTU_APP_LAUNCH_XMIR_HELPER"})
         {
-            removeEnv(rmenv, env);
+            env.remove(rmenv);
         }
 
-        g_debug("Environment length: %d", envSize(env));
+        g_debug("Environment length: %zu", env.envSize());
 
         /* Environment */
         g_variant_builder_open(&builder, G_VARIANT_TYPE_TUPLE);
         g_variant_builder_add_value(&builder, g_variant_new_string("Environment"));
         g_variant_builder_open(&builder, G_VARIANT_TYPE_VARIANT);
-        g_variant_builder_open(&builder, G_VARIANT_TYPE_ARRAY);
-        for (const auto& envvar : env)
-        {
-            if (!envvar.first.empty() && !envvar.second.empty())
-            {
-                g_variant_builder_add_value(&builder, g_variant_new_take_string(g_strdup_printf(
-                                                          "%s=%s", envvar.first.c_str(), envvar.second.c_str())));
-                // g_debug("Setting environment: %s=%s", envvar.first.c_str(), envvar.second.c_str());
-            }
-        }
+        g_variant_builder_open(&builder, G_VARIANT_TYPE_STRING_ARRAY);
+        env.serialize(&builder);
 
         g_variant_builder_close(&builder);
         g_variant_builder_close(&builder);
@@ -794,31 +780,61 @@ std::shared_ptr<Application::Instance> SystemD::launch(
         g_variant_builder_add_value(&builder, g_variant_new_array(G_VARIANT_TYPE("(sa(sv))"), nullptr, 0));
 
         auto retval = std::make_shared<instance::SystemD>(appId, job, instance, urls, reg);
-        auto chelper = new StartCHelper{};
-        chelper->ptr = retval;
-        chelper->bus = reg->_dbus;
-
-        tracepoint(ubuntu_app_launch, handshake_wait, appIdStr.c_str());
-        starting_handshake_wait(handshake);
-        tracepoint(ubuntu_app_launch, handshake_complete, appIdStr.c_str());
+        auto params = share_glib(g_variant_ref_sink(g_variant_builder_end(&builder)));
+        auto bus = manager->userbus();
 
         /* Call the job start function */
-        g_debug("Asking systemd to start task for: %s", appIdStr.c_str());
-        g_dbus_connection_call(manager->userbus_.get(),            /* bus */
-                               SYSTEMD_DBUS_ADDRESS,               /* service name */
-                               SYSTEMD_DBUS_PATH_MANAGER,          /* Path */
-                               SYSTEMD_DBUS_IFACE_MANAGER,         /* interface */
-                               "StartTransientUnit",               /* method */
-                               g_variant_builder_end(&builder),    /* params */
-                               G_VARIANT_TYPE("(o)"),              /* return */
-                               G_DBUS_CALL_FLAGS_NONE,             /* flags */
-                               -1,                                 /* default timeout */
-                               reg->thread.getCancellable().get(), /* cancellable */
-                               application_start_cb,               /* callback */
-                               chelper                             /* object */
-                               );
-
-        tracepoint(ubuntu_app_launch, libual_start_message_sent, appIdStr.c_str());
+        std::weak_ptr<Registry::Impl> weakReg = reg;
+        auto startUnit = [retval, params, bus, weakReg, appIdStr]() {
+            auto reg = weakReg.lock();
+            if (!reg)
+            {
+                g_warning("Registry went away before starting: %s", appIdStr.c_str());
+                return;
+            }
+
+            auto chelper = new StartCHelper{};
+            chelper->ptr = retval;
+            chelper->bus = reg->dbus();
+
+            g_debug("Asking systemd to start task for: %s", appIdStr.c_str());
+            g_dbus_connection_call(bus.get(),                          /* bus */
+                                   SYSTEMD_DBUS_ADDRESS,               /* service name */
+                                   SYSTEMD_DBUS_PATH_MANAGER,          /* Path */
+                                   SYSTEMD_DBUS_IFACE_MANAGER,         /* interface */
+                                   "StartTransientUnit",               /* method */
+                                   params.get(),                       /* params */
+                                   G_VARIANT_TYPE("(o)"),              /* return */
+                                   G_DBUS_CALL_FLAGS_NONE,             /* flags */
+                                   -1,                                 /* default timeout */
+                                   reg->thread.getCancellable().get(), /* cancellable */
+                                   application_start_cb,               /* callback */
+                                   chelper                             /* object */
+                                   );
+
+            tracepoint(ubuntu_app_launch, libual_start_message_sent, appIdStr.c_str());
+        };
+
+        if (isApplication)
+        {
+            /* Start following the bus now so that if the application is
+               already running we know its connections when we get the
+               UnitExists error */
+            reg->busPidIndex();
+
+            /* Let the manager know, the unit gets started when it replies
+               without holding up the thread while we wait */
+            tracepoint(ubuntu_app_launch, handshake_wait, appIdStr.c_str());
+            reg->startingHandshake().start(appIdStr, instance, std::chrono::seconds{timeout},
+                                           [startUnit, appIdStr]() {
+                                               tracepoint(ubuntu_app_launch, handshake_complete, appIdStr.c_str());
+                                               startUnit();
+                                           });
+        }
+        else
+        {
+            startUnit();
+        }
 
         return retval;
     });
@@ -834,12 +850,13 @@ std::shared_ptr<Application::Instance> SystemD::existing(const AppID& appId,
 
 std::vector<std::shared_ptr<instance::Base>> SystemD::instances(const AppID& appID, const std::string& job)
 {
+    trackUnits();
     auto reg = getReg();
 
     std::vector<std::shared_ptr<instance::Base>> instances;
     std::vector<Application::URL> urls;
 
-    std::string sappid{appID};
+    auto appIdStr = appID.str();
     for (const auto& unit : unitPaths)
     {
         const SystemD::UnitInfo& unitinfo = unit.first;
@@ -849,7 +866,12 @@ std::vector<std::shared_ptr<instance::Base>> SystemD::instances(const AppID& app
             continue;
         }
 
-        if (sappid != unitinfo.appid)
+        if (appIdStr != unitinfo.appid.str())
+        {
+            continue;
+        }
+
+        if (reg->helperPool.unclaimed(unitinfo.job, unitinfo.appid.str(), unitinfo.inst))
         {
             continue;
         }
@@ -862,8 +884,211 @@ std::vector<std::shared_ptr<instance::Base>> SystemD::instances(const AppID& app
     return instances;
 }
 
+/** Find the instance for a PID from the unit in its control group. Every
+    process an application starts stays in the unit's group, so this finds
+    children too, and only needs the file read and a lookup in our list of
+    units. */
+std::pair<std::shared_ptr<Application>, std::shared_ptr<Application::Instance>> SystemD::findInstanceByPid(pid_t pid)
+{
+    auto path = unique_gchar(g_build_filename(proc_root_.c_str(), std::to_string(pid).c_str(), "cgroup", nullptr));
+    GError* error = nullptr;
+
+    GCharUPtr contents{nullptr, &g_free};
+    {
+        gchar* tmp = nullptr;
+        g_file_get_contents(path.get(), &tmp, nullptr, &error);
+        contents = unique_gchar(tmp);
+    }
+
+    if (error != nullptr)
+    {
+        g_debug("Unable to read cgroups for PID %d: %s", pid, error->message);
+        g_error_free(error);
+        return {};
+    }
+
+    auto unitname = unitForCgroup(contents.get());
+    if (unitname.empty())
+    {
+        return {};
+    }
+
+    UnitInfo info;
+    try
+    {
+        info = parseUnit(unitname);
+    }
+    catch (std::runtime_error& e)
+    {
+        g_debug("PID %d in unit we can't use: %s", pid, e.what());
+        return {};
+    }
+
+    const auto& appJobs = getAllApplicationJobs();
+    if (std::find(appJobs.begin(), appJobs.end(), info.job) == appJobs.end() || info.appid.appid().empty())
+    {
+        /* Helpers aren't applications */
+        return {};
+    }
+
+    trackUnits();
+    auto reg = getReg();
+
+    /* Make sure it is a unit we know about and not one that has been removed */
+    auto tracked = reg->thread.executeOnThread<bool>(
+        [this, &info]() { return unitPaths.find(info) != unitPaths.end(); });
+    if (!tracked)
+    {
+        return {};
+    }
+
+    const auto& appId = info.appid.appid();
+    return {reg->createApp(appId), existing(appId, info.job, info.inst, {})};
+}
+
+/** Build a snapshot from the units we're tracking. The list of units is
+    copied on the GLib thread, then a worker gets the main PID and control
+    group of each with a single GetAll call and reads the rest from the
+    filesystem. */
+std::shared_ptr<const Registry::Snapshot> SystemD::snapshot()
+{
+    trackUnits();
+    auto reg = getReg();
+    auto snapshot = std::make_shared<Registry::Snapshot>();
+
+    /* The feed gets its changes on the thread, so the sequence number
+       read with the units matches them */
+    auto& feed = reg->changeFeed();
+    auto units = reg->thread.executeOnThread<std::vector<std::pair<UnitInfo, std::shared_future<std::string>>>>(
+        [this, reg, &feed, snapshot]() {
+            std::vector<std::pair<UnitInfo, std::shared_future<std::string>>> units;
+            for (const auto& unit : unitPaths)
+            {
+                if (reg->helperPool.unclaimed(unit.first.job, unit.first.appid.str(), unit.first.inst))
+                {
+                    continue;
+                }
+
+                units.emplace_back(unit.first, unit.second->pendingPath);
+            }
+            snapshot->sequence = feed.sequence();
+            return units;
+        });
+
+    /* Paths are filled in by workers, so we can't wait on them from one */
+    std::vector<std::string> unitpaths;
+    for (const auto& unit : units)
+    {
+        unitpaths.emplace_back(unit.second.valid() ? unit.second.get() : std::string{});
+    }
+
+    const auto& appJobs = getAllApplicationJobs();
+
+    reg->workers.execute<bool>([this, reg, &units, &unitpaths, &appJobs, &snapshot]() {
+        for (std::size_t i = 0; i < units.size(); i++)
+        {
+            const auto& info = units[i].first;
+
+            Registry::Snapshot::Instance inst;
+            inst.appid = info.appid.appid();
+            inst.job = info.job;
+            inst.instanceid = info.inst;
+            inst.helper = std::find(appJobs.begin(), appJobs.end(), info.job) == appJobs.end();
+            inst.state = Registry::Snapshot::State::STARTING;
+            inst.primaryPid = 0;
+            inst.oomScore = static_cast<oom::Score>(0);
+
+            if (unitpaths[i].empty())
+            {
+                snapshot->instances.emplace_back(std::move(inst));
+                continue;
+            }
+
+            GError* error{nullptr};
+            auto call = unique_glib(
+                g_dbus_connection_call_sync(userbus().get(),                                  /* user bus */
+                                            SYSTEMD_DBUS_ADDRESS,                             /* bus name */
+                                            unitpaths[i].c_str(),                             /* path */
+                                            "org.freedesktop.DBus.Properties",                /* interface */
+                                            "GetAll",                                         /* method */
+                                            g_variant_new("(s)", SYSTEMD_DBUS_IFACE_SERVICE), /* params */
+                                            G_VARIANT_TYPE("(a{sv})"),                        /* ret type */
+                                            G_DBUS_CALL_FLAGS_NONE,                           /* flags */
+                                            -1,                                               /* timeout */
+                                            reg->thread.getCancellable().get(),               /* cancellable */
+                                            &error));
+
+            if (error != nullptr)
+            {
+                /* Probably stopped since we copied the list */
+                g_debug("Unable to get properties for '%s': %s", unitName(info).c_str(), error->message);
+                g_error_free(error);
+                continue;
+            }
+
+            auto props = unique_glib(g_variant_get_child_value(call.get(), 0));
+            guint32 mainpid{0};
+            const gchar* cgroup{nullptr};
+            g_variant_lookup(props.get(), "MainPID", "u", &mainpid);
+            g_variant_lookup(props.get(), "ControlGroup", "&s", &cgroup);
+
+            if (cgroup != nullptr)
+            {
+                inst.pids = cgroupPids(cgroup);
+            }
+
+            if (mainpid != 0)
+            {
+                inst.primaryPid = mainpid;
+                inst.state = pidState(mainpid);
+
+                try
+                {
+                    inst.oomScore = instance::Base::oomValueFromPid(mainpid);
+                }
+                catch (std::runtime_error& e)
+                {
+                    g_debug("Snapshot of '%s': %s", unitName(info).c_str(), e.what());
+                }
+            }
+
+            snapshot->instances.emplace_back(std::move(inst));
+        }
+
+        return true;
+    });
+
+    return snapshot;
+}
+
+/** Whether the process is running or stopped, from its stat file */
+Registry::Snapshot::State SystemD::pidState(pid_t pid)
+{
+    auto path = unique_gchar(g_build_filename(proc_root_.c_str(), std::to_string(pid).c_str(), "stat", nullptr));
+    gchar* contents{nullptr};
+
+    if (!g_file_get_contents(path.get(), &contents, nullptr, nullptr))
+    {
+        return Registry::Snapshot::State::RUNNING;
+    }
+
+    std::string stat{contents};
+    g_free(contents);
+
+    /* The state is after the command, which can have spaces and parens */
+    auto end = stat.rfind(')');
+    if (end != std::string::npos && end + 2 < stat.size() && (stat[end + 2] == 'T' || stat[end + 2] == 't'))
+    {
+        return Registry::Snapshot::State::PAUSED;
+    }
+
+    return Registry::Snapshot::State::RUNNING;
+}
+
 std::list<std::string> SystemD::runningAppIds(const std::list<std::string>& allJobs)
 {
+    trackUnits();
+    auto reg = getReg();
     std::set<std::string> appids;
 
     for (const auto& unit : unitPaths)
@@ -875,7 +1100,12 @@ std::list<std::string> SystemD::runningAppIds(const std::list<std::string>& allJ
             continue;
         }
 
-        appids.insert(unitinfo.appid);
+        if (reg->helperPool.unclaimed(unitinfo.job, unitinfo.appid.str(), unitinfo.inst))
+        {
+            continue;
+        }
+
+        appids.insert(unitinfo.appid.str());
     }
 
     return {appids.begin(), appids.end()};
@@ -891,6 +1121,48 @@ std::string SystemD::userBusPath()
     return std::string{"/run/user/"} + std::to_string(getuid()) + std::string{"/bus"};
 }
 
+/** Finds the name of our unit in the contents of a /proc/PID/cgroup file.
+    The systemd hierarchy is "name=systemd" with cgroups v1 and the unified
+    hierarchy, with an ID of zero, with v2. Groups below the unit are in
+    the path after it so we look at every part of the path. */
+std::string SystemD::unitForCgroup(const std::string& cgroups)
+{
+    std::string::size_type start = 0;
+    while (start < cgroups.size())
+    {
+        auto end = cgroups.find('\n', start);
+        if (end == std::string::npos)
+        {
+            end = cgroups.size();
+        }
+
+        auto first = cgroups.find(':', start);
+        auto second = first < end ? cgroups.find(':', first + 1) : std::string::npos;
+
+        if (second < end && (cgroups.compare(first + 1, second - first - 1, "name=systemd") == 0 ||
+                             cgroups.compare(start, second - start, "0:") == 0))
+        {
+            auto part = second + 1;
+            while (part < end)
+            {
+                auto partend = std::min(cgroups.find('/', part), end);
+                auto name = cgroups.substr(part, partend - part);
+
+                if (g_str_has_prefix(name.c_str(), "ubuntu-app-launch--") && g_str_has_suffix(name.c_str(), ".service"))
+                {
+                    return name;
+                }
+
+                part = partend + 1;
+            }
+        }
+
+        start = end + 1;
+    }
+
+    return {};
+}
+
 /* TODO: Application job names */
 const std::regex unitNaming{"^ubuntu\\-app\\-launch\\-\\-(.*)\\-\\-(.*)\\-\\-([0-9]*)\\.service$"};
 
@@ -902,32 +1174,64 @@ SystemD::UnitInfo SystemD::parseUnit(const std::string& unit) const
         throw std::runtime_error{"Unable to parse unit name: " + unit};
     }
 
-    return {match[2].str(), match[1].str(), match[3].str()};
+    return {InternedAppID::fromString(match[2].str()), match[1].str(), match[3].str()};
 }
 
 std::string SystemD::unitName(const SystemD::UnitInfo& info) const
 {
-    return std::string{"ubuntu-app-launch--"} + info.job + "--" + info.appid + "--" + info.inst + ".service";
+    return unitName(info.appid.str(), info.job, info.inst);
+}
+
+std::string SystemD::unitName(const std::string& appid, const std::string& job, const std::string& instance) const
+{
+    return std::string{"ubuntu-app-launch--"} + job + "--" + appid + "--" + instance + ".service";
 }
 
-std::string SystemD::unitPath(const SystemD::UnitInfo& info)
+std::string SystemD::unitPath(const AppID& appId, const std::string& job, const std::string& instance)
 {
+    trackUnits();
     auto reg = getReg();
-    auto data = unitPaths[info];
 
-    if (!data)
+    /* Look it up on the thread so that we're not racing with the
+       signal handlers changing the map. */
+    std::function<std::shared_future<std::string>()> lookup = [this, &appId, &job,
+                                                               &instance]() -> std::shared_future<std::string> {
+        /* Units we track have their AppID interned, if it isn't we
+           don't have the unit */
+        UnitInfo info{{}, job, instance};
+        if (!InternedAppID::find(appId.str(), info.appid))
+        {
+            return std::shared_future<std::string>{};
+        }
+
+        auto it = unitPaths.find(info);
+        if (it == unitPaths.end())
+        {
+            return std::shared_future<std::string>{};
+        }
+        return std::shared_future<std::string>{it->second->pendingPath};
+    };
+    auto pendingPath = reg->thread.executeOnThread(lookup);
+
+    if (!pendingPath.valid())
     {
         return {};
     }
 
-    /* Execute on the thread so that we're sure that we're not in
-       a dbus call to get the value. No racey for you! */
-    return reg->thread.executeOnThread<std::string>([&data]() { return data->unitpath; });
+    /* A worker fills this in, so waiting here doesn't need the thread */
+    return pendingPath.get();
 }
 
+/** Track a new unit. Getting its path requires a blocking DBus call so that
+    is done on a worker thread, the path is filled in back on the GLib thread
+    and then the job started signal is sent if requested. Anyone asking for
+    the path in the mean time waits for the worker. This is called on the
+    GLib thread so it queues the work without waiting for space, the workers
+    could be waiting on us. */
 SystemD::UnitInfo SystemD::unitNew(const std::string& name,
                                    const std::string& path,
-                                   const std::shared_ptr<GDBusConnection>& bus)
+                                   const std::shared_ptr<GDBusConnection>& bus,
+                                   bool signalStarted)
 {
     if (path == "/")
     {
@@ -940,8 +1244,11 @@ SystemD::UnitInfo SystemD::unitNew(const std::string& name,
 
     auto reg = getReg();
 
+    auto promise = std::make_shared<std::promise<std::string>>();
     auto data = std::make_shared<UnitData>();
     data->jobpath = path;
+    data->pendingPath = promise->get_future().share();
+    data->startPending = signalStarted;
 
     /* We already have this one, continue on */
     if (!unitPaths.insert(std::make_pair(info, data)).second)
@@ -949,38 +1256,85 @@ SystemD::UnitInfo SystemD::unitNew(const std::string& name,
         throw std::runtime_error{"Duplicate unit, not really new"};
     }
 
-    /* We need to get the path, we're blocking everyone else on
-       this call if they try to get the path. But we're just locking
-       up the UAL thread so it should be a big deal. But if someone
-       comes an asking at this point we'll think that we have the
-       app, but not yet its path */
-    GError* error{nullptr};
-    auto call = unique_glib(g_dbus_connection_call_sync(bus.get(),                          /* user bus */
-                                                        SYSTEMD_DBUS_ADDRESS,               /* bus name */
-                                                        SYSTEMD_DBUS_PATH_MANAGER,          /* path */
-                                                        SYSTEMD_DBUS_IFACE_MANAGER,         /* interface */
-                                                        "GetUnit",                          /* method */
-                                                        g_variant_new("(s)", name.c_str()), /* params */
-                                                        G_VARIANT_TYPE("(o)"),              /* ret type */
-                                                        G_DBUS_CALL_FLAGS_NONE,             /* flags */
-                                                        -1,                                 /* timeout */
-                                                        reg->thread.getCancellable().get(), /* cancellable */
-                                                        &error));
+    std::weak_ptr<Registry::Impl> weakReg = reg;
+    auto cancel = reg->thread.getCancellable();
 
-    if (error != nullptr)
-    {
-        std::string message = "Unable to get SystemD unit path for '" + name + "': " + error->message;
-        g_error_free(error);
-        throw std::runtime_error{message};
-    }
+    reg->workers.postNoWait([weakReg, name, info, data, promise, bus, cancel, signalStarted]() {
+        std::string unitpath;
 
-    /* Parse variant */
-    gchar* gpath{nullptr};
-    g_variant_get(call.get(), "(&o)", &gpath);
-    if (gpath)
-    {
-        data->unitpath = gpath;
-    }
+        GError* error{nullptr};
+        auto call = unique_glib(g_dbus_connection_call_sync(bus.get(),                          /* user bus */
+                                                            SYSTEMD_DBUS_ADDRESS,               /* bus name */
+                                                            SYSTEMD_DBUS_PATH_MANAGER,          /* path */
+                                                            SYSTEMD_DBUS_IFACE_MANAGER,         /* interface */
+                                                            "GetUnit",                          /* method */
+                                                            g_variant_new("(s)", name.c_str()), /* params */
+                                                            G_VARIANT_TYPE("(o)"),              /* ret type */
+                                                            G_DBUS_CALL_FLAGS_NONE,             /* flags */
+                                                            -1,                                 /* timeout */
+                                                            cancel.get(),                       /* cancellable */
+                                                            &error));
+
+        if (error != nullptr)
+        {
+            if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            {
+                g_warning("Unable to get SystemD unit path for '%s': %s", name.c_str(), error->message);
+            }
+            g_error_free(error);
+        }
+        else
+        {
+            /* Parse variant */
+            gchar* gpath{nullptr};
+            g_variant_get(call.get(), "(&o)", &gpath);
+            if (gpath)
+            {
+                unitpath = gpath;
+            }
+        }
+
+        promise->set_value(unitpath);
+
+        auto reg = weakReg.lock();
+        if (!reg || unitpath.empty())
+        {
+            return;
+        }
+
+        try
+        {
+            reg->thread.executeOnThread([weakReg, info, data, unitpath, signalStarted]() {
+                auto reg = weakReg.lock();
+                if (!reg)
+                {
+                    return;
+                }
+
+                auto manager = std::dynamic_pointer_cast<SystemD>(reg->jobs());
+
+                /* Make sure it wasn't removed while we were looking */
+                auto it = manager->unitPaths.find(info);
+                if (it == manager->unitPaths.end() || it->second != data)
+                {
+                    return;
+                }
+
+                data->unitpath = unitpath;
+
+                /* Parked helpers get theirs when they're claimed */
+                if (signalStarted && !reg->helperPool.unclaimed(info.job, info.appid.str(), info.inst))
+                {
+                    data->startPending = false;
+                    manager->sig_jobStarted(info.job, info.appid.str(), info.inst);
+                }
+            });
+        }
+        catch (std::runtime_error& e)
+        {
+            g_debug("Unable to finish new unit '%s': %s", name.c_str(), e.what());
+        }
+    });
 
     return info;
 }
@@ -992,16 +1346,61 @@ void SystemD::unitRemoved(const std::string& name, const std::string& path)
     auto it = unitPaths.find(info);
     if (it != unitPaths.end())
     {
+        auto data = it->second;
         unitPaths.erase(it);
-        sig_jobStopped(info.job, info.appid, info.inst);
+
+        auto reg = getReg();
+        if (reg->helperPool.unclaimed(info.job, info.appid.str(), info.inst))
+        {
+            /* Nobody saw a parked helper start, so it doesn't stop either */
+            reg->helperPool.forget(info.job, info.appid.str(), info.inst);
+            return;
+        }
+
+        if (data->startPending)
+        {
+            /* Went away before we found its path, so we never said it
+               started and we shouldn't say it stopped */
+            g_debug("Unit '%s' removed before it was started", name.c_str());
+            return;
+        }
+
+        sig_jobStopped(info.job, info.appid.str(), info.inst);
     }
 }
 
+/** Send the started signal for a claimed parked helper. Both this and the
+    new unit handling run on the thread, so if we haven't finished looking
+    at the unit yet it sends the signal when it is done instead. */
+void SystemD::parkedClaimed(const AppID& appid, const std::string& job, const std::string& instance)
+{
+    auto reg = getReg();
+    auto appIdStr = appid.str();
+
+    reg->thread.executeOnThread<bool>([this, reg, appIdStr, job, instance]() {
+        reg->helperPool.forget(job, appIdStr, instance);
+
+        UnitInfo info{{}, job, instance};
+        if (!InternedAppID::find(appIdStr, info.appid))
+        {
+            return true;
+        }
+
+        auto it = unitPaths.find(info);
+        if (it != unitPaths.end() && !it->second->unitpath.empty())
+        {
+            it->second->startPending = false;
+            sig_jobStarted(job, appIdStr, instance);
+        }
+
+        return true;
+    });
+}
+
 pid_t SystemD::unitPrimaryPid(const AppID& appId, const std::string& job, const std::string& instance)
 {
-    auto unitinfo = SystemD::UnitInfo{appId, job, instance};
-    auto unitname = unitName(unitinfo);
-    auto unitpath = unitPath(unitinfo);
+    auto unitname = unitName(appId.str(), job, instance);
+    auto unitpath = unitPath(appId, job, instance);
 
     if (unitpath.empty())
     {
@@ -1010,10 +1409,10 @@ pid_t SystemD::unitPrimaryPid(const AppID& appId, const std::string& job, const
 
     auto reg = getReg();
 
-    return reg->thread.executeOnThread<pid_t>([this, unitname, unitpath, reg]() {
+    return reg->workers.execute<pid_t>([this, unitname, unitpath, reg]() {
         GError* error{nullptr};
         auto call = unique_glib(
-            g_dbus_connection_call_sync(userbus_.get(),                                               /* user bus */
+            g_dbus_connection_call_sync(userbus().get(),                                              /* user bus */
                                         SYSTEMD_DBUS_ADDRESS,                                         /* bus name */
                                         unitpath.c_str(),                                             /* path */
                                         "org.freedesktop.DBus.Properties",                            /* interface */
@@ -1050,9 +1449,8 @@ pid_t SystemD::unitPrimaryPid(const AppID& appId, const std::string& job, const
 
 std::vector<pid_t> SystemD::unitPids(const AppID& appId, const std::string& job, const std::string& instance)
 {
-    auto unitinfo = SystemD::UnitInfo{appId, job, instance};
-    auto unitname = unitName(unitinfo);
-    auto unitpath = unitPath(unitinfo);
+    auto unitname = unitName(appId.str(), job, instance);
+    auto unitpath = unitPath(appId, job, instance);
 
     if (unitpath.empty())
     {
@@ -1061,10 +1459,10 @@ std::vector<pid_t> SystemD::unitPids(const AppID& appId, const std::string& job,
 
     auto reg = getReg();
 
-    auto cgrouppath = reg->thread.executeOnThread<std::string>([this, unitname, unitpath, reg]() {
+    auto cgrouppath = reg->workers.execute<std::string>([this, unitname, unitpath, reg]() {
         GError* error{nullptr};
         auto call = unique_glib(
-            g_dbus_connection_call_sync(userbus_.get(),                    /* user bus */
+            g_dbus_connection_call_sync(userbus().get(),                   /* user bus */
                                         SYSTEMD_DBUS_ADDRESS,              /* bus name */
                                         unitpath.c_str(),                  /* path */
                                         "org.freedesktop.DBus.Properties", /* interface */
@@ -1107,6 +1505,15 @@ std::vector<pid_t> SystemD::unitPids(const AppID& appId, const std::string& job,
         return group;
     });
 
+    return cgroupPids(cgrouppath);
+}
+
+/** Reads the PIDs out of the tasks file of a control group
+
+    \param cgrouppath Path of the group below the cgroup root
+*/
+std::vector<pid_t> SystemD::cgroupPids(const std::string& cgrouppath)
+{
     auto fullpath = unique_gchar(g_build_filename(cgroup_root_.c_str(), cgrouppath.c_str(), "tasks", nullptr));
     GError* error = nullptr;
 
@@ -1146,13 +1553,13 @@ std::vector<pid_t> SystemD::unitPids(const AppID& appId, const std::string& job,
 
 void SystemD::stopUnit(const AppID& appId, const std::string& job, const std::string& instance)
 {
-    auto unitname = unitName(SystemD::UnitInfo{appId, job, instance});
+    auto unitname = unitName(appId.str(), job, instance);
     auto reg = getReg();
 
-    reg->thread.executeOnThread<bool>([this, unitname, reg] {
+    reg->workers.execute<bool>([this, unitname, reg] {
         GError* error{nullptr};
         unique_glib(g_dbus_connection_call_sync(
-            userbus_.get(),             /* user bus */
+            userbus().get(),            /* user bus */
             SYSTEMD_DBUS_ADDRESS,       /* bus name */
             SYSTEMD_DBUS_PATH_MANAGER,  /* path */
             SYSTEMD_DBUS_IFACE_MANAGER, /* interface */
@@ -1182,12 +1589,14 @@ void SystemD::stopUnit(const AppID& appId, const std::string& job, const std::st
 core::Signal<const std::string&, const std::string&, const std::string&>& SystemD::jobStarted()
 {
     /* Ensure we're connecting to the signals */
+    trackUnits();
     return sig_jobStarted;
 }
 
 core::Signal<const std::string&, const std::string&, const std::string&>& SystemD::jobStopped()
 {
     /* Ensure we're connecting to the signals */
+    trackUnits();
     return sig_jobStopped;
 }
 
@@ -1205,7 +1614,7 @@ core::Signal<const std::string&, const std::string&, const std::string&, Registr
 
             handle_appFailed = managedDBusSignalConnection(
                 g_dbus_connection_signal_subscribe(
-                    userbus_.get(),                    /* bus */
+                    userbus().get(),                   /* bus */
                     SYSTEMD_DBUS_ADDRESS,              /* sender */
                     "org.freedesktop.DBus.Properties", /* interface */
                     "PropertiesChanged",               /* signal */
@@ -1222,6 +1631,7 @@ core::Signal<const std::string&, const std::string&, const std::string&, Registr
                             throw std::runtime_error{"Lost our connection with the registry"};
                         }
 
+                        GLib::ContextThread::CallbackTimer timer(reg->thread);
                         auto manager = std::dynamic_pointer_cast<SystemD>(reg->jobs());
 
                         /* Check to see if this is a path we care about */
@@ -1267,6 +1677,12 @@ core::Signal<const std::string&, const std::string&, const std::string&, Registr
                         /* Reset the failure bit on the unit */
                         manager->resetUnit(unitinfo);
 
+                        /* A parked helper failing isn't one anyone asked for */
+                        if (reg->helperPool.unclaimed(unitinfo.job, unitinfo.appid.str(), unitinfo.inst))
+                        {
+                            return;
+                        }
+
                         /* Oh, we might want to do something now */
                         auto reason{Registry::FailureType::CRASH};
                         if (g_strcmp0(value, "exit-code") == 0)
@@ -1274,14 +1690,14 @@ core::Signal<const std::string&, const std::string&, const std::string&, Registr
                             reason = Registry::FailureType::START_FAILURE;
                         }
 
-                        manager->sig_jobFailed(unitinfo.job, unitinfo.appid, unitinfo.inst, reason);
+                        manager->sig_jobFailed(unitinfo.job, unitinfo.appid.str(), unitinfo.inst, reason);
                     },    /* callback */
                     data, /* user data */
                     [](gpointer user_data) {
                         auto data = static_cast<FailedData*>(user_data);
                         delete data;
                     }), /* user data destroy */
-                userbus_);
+                userbus());
 
             return true;
         });
@@ -1303,7 +1719,7 @@ void SystemD::resetUnit(const UnitInfo& info)
 
     auto reg = getReg();
     auto unitname = unitName(info);
-    auto bus = userbus_;
+    auto bus = userbus();
     auto cancel = reg->thread.getCancellable();
 
     reg->thread.executeOnThread([bus, unitname, cancel] {
@@ -19,7 +19,10 @@
 
 #pragma once
 
+#include "interned-appid.h"
 #include "jobs-base.h"
+#include "launch-env.h"
+#include <atomic>
 #include <chrono>
 #include <future>
 #include <gio/gio.h>
@@ -60,12 +63,19 @@ public:
 
     virtual std::vector<std::shared_ptr<instance::Base>> instances(const AppID& appID, const std::string& job) override;
 
+    virtual std::pair<std::shared_ptr<Application>, std::shared_ptr<Application::Instance>> findInstanceByPid(
+        pid_t pid) override;
+    virtual std::shared_ptr<const Registry::Snapshot> snapshot() override;
+
     virtual core::Signal<const std::string&, const std::string&, const std::string&>& jobStarted() override;
     virtual core::Signal<const std::string&, const std::string&, const std::string&>& jobStopped() override;
     virtual core::Signal<const std::string&, const std::string&, const std::string&, Registry::FailureType>& jobFailed()
         override;
 
+    virtual void parkedClaimed(const AppID& appid, const std::string& job, const std::string& instance) override;
+
     static std::string userBusPath();
+    static std::string unitForCgroup(const std::string& cgroups);
 
     pid_t unitPrimaryPid(const AppID& appId, const std::string& job, const std::string& instance);
     std::vector<pid_t> unitPids(const AppID& appId, const std::string& job, const std::string& instance);
@@ -73,11 +83,16 @@ public:
 
 private:
     std::string cgroup_root_;
+    std::string proc_root_;
 
     /** Connection to the User DBus bus */
     std::shared_ptr<GDBusConnection> userbus_;
+    /** Set once the user bus is connected and we're tracking units on it */
+    std::atomic<bool> trackingUnits_{false};
     /** Setup the bus and all the details in it */
     void setupUserbus(const std::shared_ptr<Registry::Impl>& reg);
+    void trackUnits();
+    std::shared_ptr<GDBusConnection> userbus();
 
     core::Signal<const std::string&, const std::string&, const std::string&> sig_jobStarted;
     core::Signal<const std::string&, const std::string&, const std::string&> sig_jobStopped;
@@ -94,7 +109,7 @@ private:
 
     struct UnitInfo
     {
-        std::string appid;
+        InternedAppID appid; /**< Interned so comparing units doesn't compare AppID strings */
         std::string job;
         std::string inst;
 
@@ -116,23 +131,30 @@ private:
     {
         std::string jobpath;
         std::string unitpath;
+        /** Resolves to the unit path once the worker looking it up
+            is done, for those who need to wait on it */
+        std::shared_future<std::string> pendingPath;
+        /** Set until the started signal has been sent for a unit that
+            wants one, if it goes away first there is no stopped signal */
+        bool startPending = false;
     };
 
     std::map<UnitInfo, std::shared_ptr<UnitData>> unitPaths;
     UnitInfo parseUnit(const std::string& unit) const;
     std::string unitName(const UnitInfo& info) const;
-    std::string unitPath(const UnitInfo& info);
+    std::string unitName(const std::string& appid, const std::string& job, const std::string& instance) const;
+    std::string unitPath(const AppID& appId, const std::string& job, const std::string& instance);
 
-    UnitInfo unitNew(const std::string& name, const std::string& path, const std::shared_ptr<GDBusConnection>& bus);
+    UnitInfo unitNew(const std::string& name,
+                     const std::string& path,
+                     const std::shared_ptr<GDBusConnection>& bus,
+                     bool signalStarted);
     void unitRemoved(const std::string& name, const std::string& path);
 
-    static std::string findEnv(const std::string& value, std::list<std::pair<std::string, std::string>>& env);
-    static void removeEnv(const std::string& value, std::list<std::pair<std::string, std::string>>& env);
-    static void copyEnv(const std::string& envname, std::list<std::pair<std::string, std::string>>& env);
-    static void copyEnvByPrefix(const std::string& prefix, std::list<std::pair<std::string, std::string>>& env);
-    static int envSize(std::list<std::pair<std::string, std::string>>& env);
+    std::vector<pid_t> cgroupPids(const std::string& cgrouppath);
+    Registry::Snapshot::State pidState(pid_t pid);
 
-    static std::vector<std::string> parseExec(std::list<std::pair<std::string, std::string>>& env);
+    static std::vector<std::string> parseExec(const LaunchEnv& env);
     static void application_start_cb(GObject* obj, GAsyncResult* res, gpointer user_data);
 
     void resetUnit(const UnitInfo& info);
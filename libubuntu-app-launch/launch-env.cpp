@@ -0,0 +1,323 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "launch-env.h"
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+namespace
+{
+
+/** The parts of the host environment we copy into jobs, grouped by
+    prefix. Rebuilt when the host environment changes. */
+struct HostEnv
+{
+    /** The entries of environ when we looked at it, if any of them change
+        we need to look again */
+    std::vector<const char*> entries;
+    std::map<std::string, std::vector<std::pair<std::string, std::string>>> byPrefix;
+};
+
+std::mutex hostEnvLock;
+std::shared_ptr<HostEnv> hostEnv;
+
+/** setenv() and friends replace the pointers in environ, so comparing
+    them is enough to see if anything has been set or unset. That is a
+    lot cheaper than comparing the strings for each prefix. */
+bool hostEnvCurrent(const HostEnv& host)
+{
+    std::size_t i = 0;
+    for (; environ[i] != nullptr; i++)
+    {
+        if (i >= host.entries.size() || host.entries[i] != environ[i])
+        {
+            return false;
+        }
+    }
+
+    return i == host.entries.size();
+}
+
+/** Get the host variables with a prefix, grabbing the environment again
+    if it has changed since the last time */
+std::vector<std::pair<std::string, std::string>> hostByPrefix(const std::string& prefix)
+{
+    std::lock_guard<std::mutex> lock(hostEnvLock);
+
+    if (!hostEnv || !hostEnvCurrent(*hostEnv))
+    {
+        hostEnv = std::make_shared<HostEnv>();
+        for (std::size_t i = 0; environ[i] != nullptr; i++)
+        {
+            hostEnv->entries.push_back(environ[i]);
+        }
+    }
+
+    auto it = hostEnv->byPrefix.find(prefix);
+    if (it != hostEnv->byPrefix.end())
+    {
+        return it->second;
+    }
+
+    std::vector<std::pair<std::string, std::string>> vars;
+    for (const auto& entry : hostEnv->entries)
+    {
+        if (std::strncmp(entry, prefix.c_str(), prefix.size()) != 0)
+        {
+            continue;
+        }
+
+        auto equal = std::strchr(entry, '=');
+        if (equal == nullptr)
+        {
+            continue;
+        }
+
+        vars.emplace_back(std::string(entry, equal - entry), std::string(equal + 1));
+    }
+
+    hostEnv->byPrefix.emplace(prefix, vars);
+    return vars;
+}
+
+}  // namespace
+
+LaunchEnv::LaunchEnv(const std::list<std::pair<std::string, std::string>>& initial)
+{
+    vars_.reserve(initial.size() + 32);
+    for (const auto& var : initial)
+    {
+        set(var.first, var.second);
+    }
+}
+
+/** Get the value of a variable, empty if it isn't set */
+std::string LaunchEnv::get(const std::string& name) const
+{
+    auto it = index_.find(name);
+    if (it == index_.end())
+    {
+        return {};
+    }
+
+    return vars_[it->second].second;
+}
+
+/** Set a variable, replacing the value if it is already set */
+void LaunchEnv::set(const std::string& name, const std::string& value)
+{
+    auto it = index_.find(name);
+    if (it != index_.end())
+    {
+        vars_[it->second].second = value;
+        return;
+    }
+
+    index_.emplace(name, vars_.size());
+    vars_.emplace_back(name, value);
+}
+
+/** Set a variable only if it doesn't already have a value */
+void LaunchEnv::setDefault(const std::string& name, const std::string& value)
+{
+    if (!get(name).empty())
+    {
+        g_debug("Already a value set for '%s' ignoring", name.c_str());
+        return;
+    }
+
+    set(name, value);
+}
+
+void LaunchEnv::remove(const std::string& name)
+{
+    auto it = index_.find(name);
+    if (it == index_.end())
+    {
+        return;
+    }
+
+    vars_[it->second].first.clear();
+    vars_[it->second].second.clear();
+    index_.erase(it);
+}
+
+/** Copy a variable from our environment if it isn't already set */
+void LaunchEnv::copyHost(const std::string& name)
+{
+    auto cvalue = getenv(name.c_str());
+    g_debug("Copying Environment: %s", name.c_str());
+    if (cvalue != nullptr)
+    {
+        setDefault(name, cvalue);
+    }
+    else
+    {
+        g_debug("Unable to copy environment '%s'", name.c_str());
+    }
+}
+
+/** Copy all of the variables from our environment that start with
+    the prefix, unless they're already set */
+void LaunchEnv::copyHostByPrefix(const std::string& prefix)
+{
+    for (const auto& var : hostByPrefix(prefix))
+    {
+        setDefault(var.first, var.second);
+    }
+}
+
+/** Length of the environment as a systemd Environment= line, which is
+    limited in size */
+std::size_t LaunchEnv::envSize() const
+{
+    std::size_t len = std::string{"Environment="}.length();
+
+    for (const auto& var : vars_)
+    {
+        if (var.first.empty())
+        {
+            continue;
+        }
+
+        len += 3; /* two quotes, one space */
+        len += var.first.length();
+        len += var.second.length();
+    }
+
+    len -= 1; /* We account for a space each time but the first doesn't have */
+
+    return len;
+}
+
+/** Add each variable as a NAME=value string to an open string array */
+void LaunchEnv::serialize(GVariantBuilder* builder) const
+{
+    std::string line;
+
+    for (const auto& var : vars_)
+    {
+        if (var.first.empty() || var.second.empty())
+        {
+            continue;
+        }
+
+        line.clear();
+        line.reserve(var.first.size() + var.second.size() + 1);
+        line.append(var.first);
+        line.push_back('=');
+        line.append(var.second);
+
+        g_variant_builder_add_value(builder, g_variant_new_string(line.c_str()));
+    }
+}
+
+/** The host variables that pick which helpers go on the exec line */
+std::string launchEnvHost()
+{
+    std::string host;
+
+    for (const auto& name : {"SNAP", "UBUNTU_APP_LAUNCH_LIBERTINE_LAUNCH", "UBUNTU_APP_LAUNCH_SNAP_LEGACY_EXEC"})
+    {
+        auto value = getenv(name);
+        if (value != nullptr)
+        {
+            host.append(name);
+            host.push_back('=');
+            host.append(value);
+        }
+        host.push_back('\n');
+    }
+
+    return host;
+}
+
+/** Get the cached environment for an application, calling \p build to
+    make it if we don't have one or it was made with a different host
+    setup or key. The build is done without holding the lock so a slow
+    one doesn't hold up launches of other applications.
+
+    \param appid Application to get the environment for
+    \param build Function to create the environment
+    \param key State outside of the AppID that the environment depends on
+*/
+std::shared_ptr<const LaunchEnvCache::EnvList> LaunchEnvCache::lookup(const AppID& appid,
+                                                                      const std::function<EnvList()>& build,
+                                                                      const std::string& key)
+{
+    auto host = launchEnvHost();
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto entry = entries_.find(appid);
+        if (entry != entries_.end() && entry->second.host == host && entry->second.key == key)
+        {
+            return entry->second.env;
+        }
+    }
+
+    auto env = std::make_shared<const EnvList>(build());
+
+    std::lock_guard<std::mutex> lock(lock_);
+    entries_[appid] = Entry{host, key, env};
+    return env;
+}
+
+/** Drop every revision of an application from the cache */
+void LaunchEnvCache::invalidate(const AppID& appid)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+
+    for (auto it = entries_.begin(); it != entries_.end();)
+    {
+        if (it->first.package == appid.package && it->first.appname == appid.appname)
+        {
+            g_debug("Dropping cached launch environment for: %s", std::string(it->first).c_str());
+            it = entries_.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}
+
+void LaunchEnvCache::clear()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    entries_.clear();
+}
+
+std::size_t LaunchEnvCache::size()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return entries_.size();
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
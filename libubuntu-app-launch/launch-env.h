@@ -0,0 +1,102 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include "appid.h"
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <gio/gio.h>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** The environment for a job being launched. Variables are kept in the
+    order they were added in a single vector with a hash index on the
+    names, so looking up or replacing a variable doesn't need to walk
+    the whole environment. */
+class LaunchEnv
+{
+public:
+    LaunchEnv() = default;
+    explicit LaunchEnv(const std::list<std::pair<std::string, std::string>>& initial);
+
+    std::string get(const std::string& name) const;
+    void set(const std::string& name, const std::string& value);
+    void setDefault(const std::string& name, const std::string& value);
+    void remove(const std::string& name);
+
+    void copyHost(const std::string& name);
+    void copyHostByPrefix(const std::string& prefix);
+
+    std::size_t envSize() const;
+    void serialize(GVariantBuilder* builder) const;
+
+private:
+    /** Variables in the order they were added, removed ones have an
+        empty name */
+    std::vector<std::pair<std::string, std::string>> vars_;
+    /** Where each variable is in vars_ */
+    std::unordered_map<std::string, std::size_t> index_;
+};
+
+/** The parts of an application's launch environment that don't change
+    between launches: package directories, the exec line and its helpers.
+    They are keyed by AppID, which includes the package revision, and the
+    registry drops them when an info watcher says the application changed.
+    Each entry remembers the host variables that select the helpers, and
+    a key from the caller for anything else the environment depends on,
+    so that changing those rebuilds it too. */
+class LaunchEnvCache
+{
+public:
+    typedef std::list<std::pair<std::string, std::string>> EnvList;
+
+    std::shared_ptr<const EnvList> lookup(const AppID& appid,
+                                          const std::function<EnvList()>& build,
+                                          const std::string& key = {});
+    void invalidate(const AppID& appid);
+    void clear();
+    std::size_t size();
+
+private:
+    struct Entry
+    {
+        std::string host;
+        std::string key;
+        std::shared_ptr<const EnvList> env;
+    };
+
+    std::mutex lock_;
+    std::map<AppID, Entry> entries_;
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -21,6 +21,7 @@
 #include "application-icon-finder.h"
 #include "application-impl-base.h"
 #include "helper-impl.h"
+#include <algorithm>
 #include <regex>
 #include <unity/util/GObjectMemory.h>
 #include <unity/util/GlibMemory.h>
@@ -35,21 +36,19 @@ namespace app_launch
 Registry::Impl::Impl()
     : thread([]() {},
              [this]() {
+                 zgFinalFlush();
                  zgLog_.reset();
                  jobs_.reset();
 
-                 if (_dbus)
-                     g_dbus_connection_flush_sync(_dbus.get(), nullptr, nullptr);
-                 _dbus.reset();
+                 if (dbus_)
+                     g_dbus_connection_flush_sync(dbus_.get(), nullptr, nullptr);
+                 dbus_.reset();
              })
+    , helperPool{*this}
     , jobs_{}
     , _iconFinders{}
     , _appStores{}
 {
-    auto cancel = thread.getCancellable();
-    _dbus = thread.executeOnThread<std::shared_ptr<GDBusConnection>>(
-        [cancel]() { return share_gobject(g_bus_get_sync(G_BUS_TYPE_SESSION, cancel.get(), nullptr)); });
-
     /* Determine where we're getting the helper from */
     auto goomHelper = g_getenv("UBUNTU_APP_LAUNCH_OOM_HELPER");
     if (goomHelper != nullptr)
@@ -62,6 +61,27 @@ Registry::Impl::Impl()
     }
 }
 
+/** The session bus connection. We connect the first time it is needed so
+    that tools which never talk on the bus don't wait on it, and do it on
+    the thread so that the first users are serialized. */
+std::shared_ptr<GDBusConnection> Registry::Impl::dbus()
+{
+    if (G_LIKELY(dbusConnected_))
+    {
+        return dbus_;
+    }
+
+    auto cancel = thread.getCancellable();
+    return thread.executeOnThread<std::shared_ptr<GDBusConnection>>([this, cancel]() {
+        if (!dbusConnected_)
+        {
+            dbus_ = share_gobject(g_bus_get_sync(G_BUS_TYPE_SESSION, cancel.get(), nullptr));
+            dbusConnected_ = true;
+        }
+        return dbus_;
+    });
+}
+
 /** Helper function for printing JSON objects to debug output */
 std::string Registry::Impl::printJson(std::shared_ptr<JsonObject> jsonobj)
 {
@@ -86,33 +106,171 @@ std::string Registry::Impl::printJson(std::shared_ptr<JsonNode> jsonnode)
     return retval;
 }
 
-/** Send an event to Zietgeist using the registry thread so that
-    the callback comes back in the right place. */
+/** How long we hold on to events to batch them and the window in which
+    a leave and access for the same app cancel each other out */
+static const std::chrono::milliseconds zgCoalesceWindow{250};
+/** Maximum number of events we'll queue up while waiting on Zeitgeist */
+static const std::size_t zgQueueLimit{64};
+/** How long shutting down waits on Zeitgeist for the last events */
+static const std::chrono::milliseconds zgShutdownWait{1000};
+
+/** Queue an event to send to Zeitgeist. Events are sent in batches and
+    a leave followed quickly by an access (or the reverse) for the same
+    application are dropped as they don't change what the user did. All
+    of the queue handling is done on the registry thread. */
 void Registry::Impl::zgSendEvent(AppID appid, const std::string& eventtype)
 {
     thread.executeOnThread([this, appid, eventtype] {
-        std::string uri;
+        auto now = std::chrono::steady_clock::now();
 
-        if (appid.package.value().empty())
+        for (auto it = zgQueue_.rbegin(); it != zgQueue_.rend(); ++it)
         {
-            uri = "application://" + appid.appname.value() + ".desktop";
+            if (it->appid != appid)
+            {
+                continue;
+            }
+
+            if (now - it->queued > zgCoalesceWindow)
+            {
+                break;
+            }
+
+            if (it->eventtype == eventtype)
+            {
+                g_debug("Coalescing duplicate ZG event for '%s': %s", appid.str().c_str(), eventtype.c_str());
+                zgCoalesced_++;
+            }
+            else
+            {
+                g_debug("Coalescing ZG event pair for '%s'", appid.str().c_str());
+                zgQueue_.erase(std::next(it).base());
+                zgCoalesced_ += 2;
+            }
+            return;
         }
-        else
+
+        if (zgQueue_.size() >= zgQueueLimit)
+        {
+            g_warning("Zeitgeist event queue full, dropping event for '%s'",
+                      std::string(zgQueue_.front().appid).c_str());
+            zgQueue_.pop_front();
+            zgDropped_++;
+        }
+
+        zgQueue_.emplace_back(ZgQueuedEvent{appid, eventtype, now});
+
+        if (zgFlushSource_ == 0 && !zgInFlight_)
+        {
+            zgFlushSource_ = thread.timeout(zgCoalesceWindow, [this]() {
+                zgFlushSource_ = 0;
+                zgFlush();
+            });
+        }
+    });
+}
+
+/** Sends all the queued events to Zeitgeist in a single insert. Only one
+    batch is sent at a time, anything that gets queued while waiting
+    on Zeitgeist is sent when it returns. */
+void Registry::Impl::zgFlush()
+{
+    if (zgQueue_.empty() || zgInFlight_)
+    {
+        return;
+    }
+
+    zgInsert(thread.getCancellable().get(), {});
+}
+
+/** Sends whatever is still queued as the thread shuts down. The thread's
+    cancellable has already been triggered, so the last batch is sent
+    without it and we iterate the context here until Zeitgeist replies
+    or we give up waiting. A batch that the shutdown cancelled has already
+    been handed to the bus, so it is only waited on and not resent. */
+void Registry::Impl::zgFinalFlush()
+{
+    if (zgFlushSource_ != 0)
+    {
+        thread.removeSource(zgFlushSource_);
+        zgFlushSource_ = 0;
+    }
+
+    if (zgQueue_.empty() && !zgInFlight_)
+    {
+        return;
+    }
+
+    auto context = g_main_context_get_thread_default();
+    bool expired = false;
+    auto timer = unique_glib(g_timeout_source_new(zgShutdownWait.count()));
+    g_source_set_callback(timer.get(),
+                          [](gpointer user_data) -> gboolean {
+                              *static_cast<bool*>(user_data) = true;
+                              return G_SOURCE_REMOVE;
+                          },
+                          &expired, nullptr);
+    g_source_attach(timer.get(), context);
+
+    while (zgInFlight_ && !expired)
+    {
+        g_main_context_iteration(context, TRUE);
+    }
+
+    while (!zgQueue_.empty() && !zgInFlight_ && !expired)
+    {
+        auto done = std::make_shared<bool>(false);
+        zgInsert(nullptr, done);
+
+        while (!*done && !expired)
         {
-            uri = "application://" + appid.package.value() + "_" + appid.appname.value() + ".desktop";
+            g_main_context_iteration(context, TRUE);
         }
+    }
 
-        g_debug("Sending ZG event for '%s': %s", uri.c_str(), eventtype.c_str());
+    g_source_destroy(timer.get());
 
-        if (!zgLog_)
+    if (expired)
+    {
+        g_warning("Timed out sending the last %d events to Zeitgeist", int(zgQueue_.size()));
+    }
+}
+
+/** Turns the queue into a single insert. When @done is set it is flagged
+    once Zeitgeist has replied instead of sending what got queued in the
+    meantime, which is left to the caller. */
+void Registry::Impl::zgInsert(GCancellable* cancellable, const std::shared_ptr<bool>& done)
+{
+    if (!zgLog_)
+    {
+        zgLog_ = share_gobject(zeitgeist_log_new()); /* create a new log for us */
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto realnow = g_get_real_time() / 1000;
+
+    GList* events = nullptr;
+    for (const auto& queued : zgQueue_)
+    {
+        auto uri = info_watcher::Zeitgeist::appUri(queued.appid);
+
+        auto age = std::chrono::duration_cast<std::chrono::milliseconds>(now - queued.queued);
+        auto timestamp = realnow - age.count();
+
+        /* Keep our usage model in sync with what we've told Zeitgeist */
+        if (zgWatcher_)
         {
-            zgLog_ = share_gobject(zeitgeist_log_new()); /* create a new log for us */
+            zgWatcher_->eventSent(queued.appid, queued.eventtype, timestamp);
         }
 
-        auto event = unique_gobject(zeitgeist_event_new());
-        zeitgeist_event_set_actor(event.get(), "application://ubuntu-app-launch.desktop");
-        zeitgeist_event_set_interpretation(event.get(), eventtype.c_str());
-        zeitgeist_event_set_manifestation(event.get(), ZEITGEIST_ZG_USER_ACTIVITY);
+        g_debug("Sending ZG event for '%s': %s", uri.c_str(), queued.eventtype.c_str());
+
+        /* Same timestamp as the model, so the watcher can tell our events
+           apart in what Zeitgeist returns */
+        auto event = zeitgeist_event_new();
+        zeitgeist_event_set_timestamp(event, timestamp);
+        zeitgeist_event_set_actor(event, "application://ubuntu-app-launch.desktop");
+        zeitgeist_event_set_interpretation(event, queued.eventtype.c_str());
+        zeitgeist_event_set_manifestation(event, ZEITGEIST_ZG_USER_ACTIVITY);
 
         auto subject = unique_gobject(zeitgeist_subject_new());
         zeitgeist_subject_set_interpretation(subject.get(), ZEITGEIST_NFO_SOFTWARE);
@@ -120,25 +278,106 @@ void Registry::Impl::zgSendEvent(AppID appid, const std::string& eventtype)
         zeitgeist_subject_set_mimetype(subject.get(), "application/x-desktop");
         zeitgeist_subject_set_uri(subject.get(), uri.c_str());
 
-        zeitgeist_event_add_subject(event.get(), subject.get());
+        zeitgeist_event_add_subject(event, subject.get());
 
-        zeitgeist_log_insert_event(zgLog_.get(), /* log */
-                                   event.get(),  /* event */
-                                   nullptr,      /* cancellable */
-                                   [](GObject* obj, GAsyncResult* res, gpointer user_data) {
-                                       GError* error = nullptr;
+        events = g_list_prepend(events, event);
+    }
+    events = g_list_reverse(events);
+    zgQueue_.clear();
+    zgInFlight_ = true;
 
-                                       unique_glib(zeitgeist_log_insert_event_finish(ZEITGEIST_LOG(obj), res, &error));
+    /* The list needs to stay around until the insert is complete */
+    struct InsertData
+    {
+        Registry::Impl* impl;
+        GList* events;
+        std::shared_ptr<bool> done;
+    };
+    auto data = new InsertData{this, events, done};
+
+    zeitgeist_log_insert_events(zgLog_.get(), /* log */
+                                events,       /* events */
+                                cancellable,  /* cancellable */
+                                [](GObject* obj, GAsyncResult* res, gpointer user_data) {
+                                    auto data = static_cast<InsertData*>(user_data);
+                                    GError* error = nullptr;
+
+                                    unique_glib(zeitgeist_log_insert_events_finish(ZEITGEIST_LOG(obj), res, &error));
+                                    g_list_free_full(data->events, g_object_unref);
+                                    auto impl = data->impl;
+                                    auto done = data->done;
+                                    delete data;
+
+                                    bool cancelled = false;
+                                    if (error != nullptr)
+                                    {
+                                        cancelled = g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+                                        if (!cancelled)
+                                        {
+                                            g_warning("Unable to submit Zeitgeist Events: %s", error->message);
+                                        }
+                                        g_error_free(error);
+                                    }
+
+                                    impl->zgInFlight_ = false;
+
+                                    if (done)
+                                    {
+                                        *done = true;
+                                    }
+                                    else if (!cancelled)
+                                    {
+                                        impl->zgFlush();
+                                    }
+                                }, /* callback */
+                                data); /* userdata */
+}
 
-                                       if (error != nullptr)
-                                       {
-                                           g_warning("Unable to submit Zeitgeist Event: %s", error->message);
-                                           g_error_free(error);
-                                       }
-                                   },        /* callback */
-                                   nullptr); /* userdata */
+/** There is a single manager for the backend, which all the Registry
+    objects in the process share. Only the Registry that set it can
+    clear it, and it is cleared when that Registry goes away. */
+void Registry::Impl::setManager(const std::shared_ptr<Registry::Manager>& manager, const Registry* owner)
+{
+    std::lock_guard<std::mutex> lock(managerLock_);
 
-    });
+    if (managerOwner_ != nullptr && managerOwner_ != owner)
+    {
+        throw std::runtime_error("A manager has already been set through another Registry");
+    }
+
+    jobs()->setManager(manager);
+    managerOwner_ = owner;
+}
+
+void Registry::Impl::clearManager(const Registry* owner)
+{
+    std::lock_guard<std::mutex> lock(managerLock_);
+
+    if (managerOwner_ != owner)
+    {
+        g_debug("Not clearing the manager, it was set through another Registry");
+        return;
+    }
+
+    jobs()->clearManager();
+    managerOwner_ = nullptr;
+}
+
+/** A Registry object is going away, so drop the signals that it handed
+    out and the manager if it set one */
+void Registry::Impl::dropRegistry(const Registry* reg)
+{
+    {
+        std::lock_guard<std::mutex> lock(registrySignalsLock_);
+        registrySignals_.erase(reg);
+    }
+
+    std::lock_guard<std::mutex> lock(managerLock_);
+    if (managerOwner_ == reg)
+    {
+        jobs()->clearManager();
+        managerOwner_ = nullptr;
+    }
 }
 
 std::shared_ptr<IconFinder>& Registry::Impl::getIconFinder(std::string basePath)
@@ -186,14 +425,26 @@ void Registry::Impl::infoWatchersSetup()
         /* Connect each of their signals to us, and track that connection */
         for (const auto& watcher : watchers)
         {
+            if (!watcher)
+            {
+                continue;
+            }
+
             infoWatchers_.emplace_back(std::make_pair(
-                watcher,
-                infoWatcherConnections{
-                    watcher->infoChanged().connect(
-                        [this](const std::shared_ptr<Application>& app) { sig_appInfoUpdated(app); }),
-                    watcher->appAdded().connect([this](const std::shared_ptr<Application>& app) { sig_appAdded(app); }),
-                    watcher->appRemoved().connect([this](const AppID& appid) { sig_appRemoved(appid); }),
-                }));
+                watcher, infoWatcherConnections{
+                             watcher->infoChanged().connect([this](const std::shared_ptr<Application>& app) {
+                                 launchEnvs_.invalidate(app->appId());
+                                 sig_appInfoUpdated(app);
+                             }),
+                             watcher->appAdded().connect([this](const std::shared_ptr<Application>& app) {
+                                 launchEnvs_.invalidate(app->appId());
+                                 sig_appAdded(app);
+                             }),
+                             watcher->appRemoved().connect([this](const AppID& appid) {
+                                 launchEnvs_.invalidate(appid);
+                                 sig_appRemoved(appid);
+                             }),
+                         }));
         }
     });
 }
@@ -216,6 +467,143 @@ core::Signal<const AppID&>& Registry::Impl::appRemoved()
     return sig_appRemoved;
 }
 
+/** Get the starting handshake, creating it on first use. It subscribes
+    to the manager's replies so it has to be used on the thread. */
+StartingHandshake& Registry::Impl::startingHandshake()
+{
+    if (!startingHandshake_)
+    {
+        startingHandshake_.reset(new StartingHandshake(thread, dbus()));
+    }
+
+    return *startingHandshake_;
+}
+
+/** Get the index of bus connections by PID, creating it on first use.
+    It follows NameOwnerChanged so it has to be used on the thread. */
+BusPidIndex& Registry::Impl::busPidIndex()
+{
+    if (!busPidIndex_)
+    {
+        busPidIndex_.reset(new BusPidIndex(thread, dbus()));
+    }
+
+    return *busPidIndex_;
+}
+
+/** Number of changes the feed keeps before dropping the oldest */
+static const std::size_t changeFeedSize{256};
+
+/** Get the change feed, connecting it to the jobs manager's signals on
+    first use. Changes from before that aren't in the feed. */
+ChangeFeed& Registry::Impl::changeFeed()
+{
+    std::call_once(flag_changeFeed, [this]() {
+        changeFeed_.reset(new ChangeFeed(changeFeedSize));
+
+        auto jobChange = [this](Registry::Change::Type type, const std::string& job, const std::string& appid,
+                                const std::string& instanceid) {
+            Registry::Change change;
+            change.type = type;
+            /* Just parse it, interning would take the table lock for an
+               entry we'd drop right away. Legacy AppIDs are only a name. */
+            change.appid = AppID::parse(appid);
+            if (change.appid.empty() && !appid.empty())
+            {
+                change.appid = AppID{AppID::Package::from_raw({}), AppID::AppName::from_raw(appid),
+                                     AppID::Version::from_raw({})};
+            }
+            change.job = job;
+            change.instanceid = instanceid;
+            change.failure = Registry::FailureType::CRASH;
+
+            const auto& appJobs = jobs()->getAllApplicationJobs();
+            change.helper = std::find(appJobs.begin(), appJobs.end(), job) == appJobs.end();
+            return change;
+        };
+
+        auto pauseChange = [](Registry::Change::Type type, const std::shared_ptr<Application>& app,
+                              const std::shared_ptr<Application::Instance>& instance, const std::vector<pid_t>& pids) {
+            Registry::Change change;
+            change.type = type;
+            change.appid = app->appId();
+            change.helper = false;
+            change.failure = Registry::FailureType::CRASH;
+            change.pids = pids;
+
+            auto inst = std::dynamic_pointer_cast<jobs::instance::Base>(instance);
+            if (inst)
+            {
+                change.job = inst->getJob();
+                change.instanceid = inst->getInstanceId();
+            }
+            return change;
+        };
+
+        auto manager = jobs();
+
+        manager->jobStarted().connect(
+            [this, jobChange](const std::string& job, const std::string& appid, const std::string& instanceid) {
+                addChange(jobChange(Registry::Change::Type::STARTED, job, appid, instanceid));
+            });
+        manager->jobStopped().connect(
+            [this, jobChange](const std::string& job, const std::string& appid, const std::string& instanceid) {
+                addChange(jobChange(Registry::Change::Type::STOPPED, job, appid, instanceid));
+            });
+        manager->jobFailed().connect([this, jobChange](const std::string& job, const std::string& appid,
+                                                       const std::string& instanceid, Registry::FailureType reason) {
+            auto change = jobChange(Registry::Change::Type::FAILED, job, appid, instanceid);
+            change.failure = reason;
+            addChange(change);
+        });
+        manager->appPaused().connect([this, pauseChange](const std::shared_ptr<Application>& app,
+                                                         const std::shared_ptr<Application::Instance>& instance,
+                                                         const std::vector<pid_t>& pids) {
+            addChange(pauseChange(Registry::Change::Type::PAUSED, app, instance, pids));
+        });
+        manager->appResumed().connect([this, pauseChange](const std::shared_ptr<Application>& app,
+                                                          const std::shared_ptr<Application::Instance>& instance,
+                                                          const std::vector<pid_t>& pids) {
+            addChange(pauseChange(Registry::Change::Type::RESUMED, app, instance, pids));
+        });
+    });
+
+    return *changeFeed_;
+}
+
+core::Signal<const Registry::Change&>& Registry::Impl::changed()
+{
+    changeFeed();
+    return sig_changed;
+}
+
+/** Put a change in the feed and tell everyone about it, called on the
+    thread by the jobs signals */
+void Registry::Impl::addChange(Registry::Change change)
+{
+    change.sequence = changeFeed_->add(change);
+    g_debug("Change %llu for '%s'", static_cast<unsigned long long>(change.sequence), change.appid.str().c_str());
+
+    sig_changed(change);
+}
+
+/** Get the part of an application's launch environment that is the same
+    for every launch, building it with \p build when it isn't cached. The
+    info watchers are connected first so that a changed application gets
+    dropped from the cache.
+
+    \param appid Application being launched
+    \param build Function that creates the environment
+    \param key State the environment depends on that no info watcher
+               tells us about, a different key rebuilds it
+*/
+std::shared_ptr<const LaunchEnvCache::EnvList> Registry::Impl::launchEnvTemplate(
+    const AppID& appid, const std::function<LaunchEnvCache::EnvList()>& build, const std::string& key)
+{
+    infoWatchersSetup();
+    return launchEnvs_.lookup(appid, build, key);
+}
+
 std::shared_ptr<Application> Registry::Impl::createApp(const AppID& appid)
 {
     for (const auto& appStore : appStores())
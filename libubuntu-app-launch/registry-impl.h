@@ -20,14 +20,24 @@
 #pragma once
 
 #include "app-store-base.h"
+#include "bus-pid-index.h"
+#include "change-feed.h"
 #include "glib-thread.h"
+#include "helper-pool.h"
 #include "info-watcher-zg.h"
 #include "jobs-base.h"
+#include "launch-env.h"
 #include "registry.h"
 #include "snapd-info.h"
+#include "starting-handshake.h"
+#include "worker-pool.h"
 #include <gio/gio.h>
+#include <atomic>
+#include <chrono>
 #include <json-glib/json-glib.h>
+#include <list>
 #include <map>
+#include <mutex>
 #include <unordered_map>
 #include <zeitgeist.h>
 
@@ -54,25 +64,67 @@ public:
     virtual ~Impl()
     {
         thread.quit();
+        workers.shutdown();
     }
 
-    static void setManager(const std::shared_ptr<Registry::Manager>& manager,
-                           const std::shared_ptr<Registry>& registry);
-    void clearManager();
+    void setManager(const std::shared_ptr<Registry::Manager>& manager, const Registry* owner);
+    void clearManager(const Registry* owner);
+
+    /** Gets the copy of a backend signal that belongs to \p reg. The backend
+        is shared by all the Registry objects in the process, but connections
+        made through one of them should go away with it. The forwarding slot
+        holds the copy so that an emission racing with dropRegistry() doesn't
+        use it after it is freed. */
+    template <typename... Args>
+    core::Signal<Args...>& registrySignal(const Registry* reg, const std::string& name, core::Signal<Args...>& shared)
+    {
+        std::lock_guard<std::mutex> lock(registrySignalsLock_);
+
+        auto& signals = registrySignals_[reg];
+        auto it = signals.find(name);
+        if (it == signals.end())
+        {
+            auto signal = std::make_shared<core::Signal<Args...>>();
+            auto forward = shared.connect([signal](Args... args) { (*signal)(args...); });
+            it = signals.emplace(name, RegistrySignal{signal, forward}).first;
+        }
+
+        return *std::static_pointer_cast<core::Signal<Args...>>(it->second.signal);
+    }
+
+    void dropRegistry(const Registry* reg);
 
     /** Shared context thread for events and background tasks
         that UAL subtasks are doing */
     GLib::ContextThread thread;
-    /** DBus shared connection for the session bus */
-    std::shared_ptr<GDBusConnection> _dbus;
+    std::shared_ptr<GDBusConnection> dbus();
+    /** Threads for blocking work (sync DBus calls, snapd, files) so that
+        the GLib thread is free to dispatch signals */
+    WorkerPool workers;
 
     /** Snapd information object */
     snapd::Info snapdInfo;
 
+    /** Helpers started ahead of time waiting for their URLs */
+    HelperPool helperPool;
+
     std::shared_ptr<IconFinder>& getIconFinder(std::string basePath);
 
     virtual void zgSendEvent(AppID appid, const std::string& eventtype);
 
+    /** Number of Zeitgeist events thrown away because the queue was full */
+    unsigned long zgDroppedEvents() const
+    {
+        return zgDropped_;
+    }
+
+    /** Number of Zeitgeist events that were removed because they were
+        redundant with another event for the same application */
+    unsigned long zgCoalescedEvents() const
+    {
+        return zgCoalesced_;
+    }
+
     static std::string printJson(std::shared_ptr<JsonObject> jsonobj);
     static std::string printJson(std::shared_ptr<JsonNode> jsonnode);
 
@@ -125,6 +177,14 @@ public:
         jobs_ = jobs;
     }
 
+    StartingHandshake& startingHandshake();
+    BusPidIndex& busPidIndex();
+    ChangeFeed& changeFeed();
+    core::Signal<const Registry::Change&>& changed();
+
+    std::shared_ptr<const LaunchEnvCache::EnvList> launchEnvTemplate(
+        const AppID& appid, const std::function<LaunchEnvCache::EnvList()>& build, const std::string& key = {});
+
     /* Create functions */
     std::shared_ptr<Application> createApp(const AppID& appid);
     std::shared_ptr<Helper> createHelper(const Helper::Type& type,
@@ -140,12 +200,52 @@ public:
     AppID discover(const std::string& package, const std::string& appname, AppID::VersionWildcard versionwildcard);
 
 private:
+    /** DBus shared connection for the session bus, connected on first use */
+    std::shared_ptr<GDBusConnection> dbus_;
+    /** Set once we've tried to connect to the session bus */
+    std::atomic<bool> dbusConnected_{false};
+
     /** The job creation engine */
     std::shared_ptr<jobs::manager::Base> jobs_;
 
+    /** Registry that set the manager, the only one that can clear it */
+    const Registry* managerOwner_ = nullptr;
+    std::mutex managerLock_;
+
+    /** A Registry object's copy of a backend signal, the connection is
+        declared last so that it is dropped before the signal */
+    struct RegistrySignal
+    {
+        std::shared_ptr<void> signal;
+        core::ScopedConnection forward;
+    };
+    /** Signals handed out by each Registry object, by name */
+    std::map<const Registry*, std::map<std::string, RegistrySignal>> registrySignals_;
+    std::mutex registrySignalsLock_;
+
     /** Shared instance of the Zeitgeist Log */
     std::shared_ptr<ZeitgeistLog> zgLog_;
 
+    /** An event waiting to be sent to Zeitgeist */
+    struct ZgQueuedEvent
+    {
+        AppID appid;
+        std::string eventtype;
+        std::chrono::steady_clock::time_point queued;
+    };
+    /** Events waiting to be sent, only accessed on the thread */
+    std::list<ZgQueuedEvent> zgQueue_;
+    /** Timeout source to flush the queue, zero if not scheduled */
+    guint zgFlushSource_ = 0;
+    /** Whether we have a batch being inserted by Zeitgeist */
+    bool zgInFlight_ = false;
+    std::atomic<unsigned long> zgDropped_{0};
+    std::atomic<unsigned long> zgCoalesced_{0};
+
+    void zgFlush();
+    void zgFinalFlush();
+    void zgInsert(GCancellable* cancellable, const std::shared_ptr<bool>& done);
+
     /** All of our icon finders based on the path that they're looking
         into */
     std::unordered_map<std::string, std::shared_ptr<IconFinder>> _iconFinders;
@@ -178,6 +278,25 @@ private:
 
     /** ZG Info Watcher */
     std::shared_ptr<info_watcher::Zeitgeist> zgWatcher_;
+
+    /** The parts of application launch environments that we can reuse,
+        dropped when the info watchers tell us an application changed */
+    LaunchEnvCache launchEnvs_;
+
+    /** Starting handshake with the manager, created on first use */
+    std::unique_ptr<StartingHandshake> startingHandshake_;
+
+    /** Connections on the bus by PID, created on first use */
+    std::unique_ptr<BusPidIndex> busPidIndex_;
+
+    /** Changes to running instances, started on first use */
+    std::unique_ptr<ChangeFeed> changeFeed_;
+    /** Flag to see if we've connected the change feed to the jobs signals */
+    std::once_flag flag_changeFeed;
+    /** Signal for each change added to the feed */
+    core::Signal<const Registry::Change&> sig_changed;
+
+    void addChange(Registry::Change change);
 };
 
 }  // namespace app_launch
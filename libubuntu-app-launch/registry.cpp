@@ -18,6 +18,7 @@
  */
 
 #include <algorithm>
+#include <mutex>
 #include <numeric>
 #include <regex>
 
@@ -31,12 +32,36 @@ namespace ubuntu
 namespace app_launch
 {
 
+/** Guards the shared backend */
+static std::mutex sharedImplLock;
+/** Backend shared by all the Registry objects in the process, including the
+    default one used by the C API. It lives as long as one of them does. */
+static std::weak_ptr<Registry::Impl> sharedImpl;
+
+/** Get the shared backend, building it if there isn't one alive */
+static std::shared_ptr<Registry::Impl> getSharedImpl()
+{
+    std::lock_guard<std::mutex> lock(sharedImplLock);
+
+    auto impl = sharedImpl.lock();
+    if (!impl)
+    {
+        g_debug("Building the shared Registry implementation");
+
+        impl = std::make_shared<Registry::Impl>();
+        impl->setJobs(jobs::manager::Base::determineFactory(impl));
+        impl->setAppStores(app_store::Base::allAppStores(impl));
+        impl->setZgWatcher(std::make_shared<info_watcher::Zeitgeist>(impl));
+
+        sharedImpl = impl;
+    }
+
+    return impl;
+}
+
 Registry::Registry()
-    : impl{std::make_shared<Impl>()}
+    : impl{getSharedImpl()}
 {
-    impl->setJobs(jobs::manager::Base::determineFactory(impl));
-    impl->setAppStores(app_store::Base::allAppStores(impl));
-    impl->setZgWatcher(std::make_shared<info_watcher::Zeitgeist>(impl));
 }
 
 Registry::Registry(const std::shared_ptr<Impl>& inimpl)
@@ -47,6 +72,7 @@ Registry::Registry(const std::shared_ptr<Impl>& inimpl)
 
 Registry::~Registry()
 {
+    impl->dropRegistry(this);
 }
 
 std::list<std::shared_ptr<Application>> Registry::runningApps(std::shared_ptr<Registry> registry)
@@ -54,6 +80,26 @@ std::list<std::shared_ptr<Application>> Registry::runningApps(std::shared_ptr<Re
     return registry->impl->jobs()->runningApps();
 }
 
+std::pair<std::shared_ptr<Application>, std::shared_ptr<Application::Instance>> Registry::findInstanceByPid(pid_t pid)
+{
+    return impl->jobs()->findInstanceByPid(pid);
+}
+
+std::shared_ptr<const Registry::Snapshot> Registry::snapshot()
+{
+    return impl->jobs()->snapshot();
+}
+
+bool Registry::changesSince(std::uint64_t after, std::vector<Change>& changes)
+{
+    return impl->changeFeed().since(after, changes);
+}
+
+core::Signal<const Registry::Change&>& Registry::changed()
+{
+    return impl->registrySignal(this, "changed", impl->changed());
+}
+
 std::list<std::shared_ptr<Application>> Registry::installedApps(std::shared_ptr<Registry> connection)
 {
     std::list<std::shared_ptr<Application>> list;
@@ -73,12 +119,57 @@ std::list<std::shared_ptr<Helper>> Registry::runningHelpers(Helper::Type type, s
 
 void Registry::setManager(const std::shared_ptr<Manager>& manager, const std::shared_ptr<Registry>& registry)
 {
-    registry->impl->jobs()->setManager(manager);
+    registry->impl->setManager(manager, registry.get());
 }
 
 void Registry::clearManager()
 {
-    impl->jobs()->clearManager();
+    impl->clearManager(this);
+}
+
+void Registry::setHelperPoolSize(const Helper::Type& type, unsigned int size)
+{
+    impl->helperPool.setSize(type, size);
+}
+
+Registry::ThreadStats Registry::threadStats(bool reset)
+{
+    auto stats = impl->thread.stats();
+    if (reset)
+    {
+        impl->thread.resetStats();
+    }
+
+    ThreadStats retval;
+    retval.queueDepth = stats.queueDepth;
+    retval.maxQueueDepth = stats.maxQueueDepth;
+    retval.tasks = stats.tasks;
+    retval.timeouts = stats.timeouts;
+    retval.callbacks = stats.callbacks;
+    retval.queueTime.assign(stats.queueTime.begin(), stats.queueTime.end());
+    retval.execTime.assign(stats.execTime.begin(), stats.execTime.end());
+
+    for (const auto& slow : stats.slowTasks)
+    {
+        ThreadStats::Kind kind;
+        switch (slow.kind)
+        {
+            case GLib::ContextThread::Kind::TASK:
+                kind = ThreadStats::Kind::TASK;
+                break;
+            case GLib::ContextThread::Kind::TIMEOUT:
+                kind = ThreadStats::Kind::TIMEOUT;
+                break;
+            case GLib::ContextThread::Kind::CALLBACK:
+            default:
+                kind = ThreadStats::Kind::CALLBACK;
+                break;
+        }
+
+        retval.slowTasks.emplace_back(ThreadStats::SlowTask{kind, slow.site.str(), slow.queued, slow.executed});
+    }
+
+    return retval;
 }
 
 std::shared_ptr<Registry> defaultRegistry;
@@ -100,19 +191,19 @@ void Registry::clearDefault()
 core::Signal<const std::shared_ptr<Application>&, const std::shared_ptr<Application::Instance>&>& Registry::appStarted(
     const std::shared_ptr<Registry>& reg)
 {
-    return reg->impl->jobs()->appStarted();
+    return reg->impl->registrySignal(reg.get(), "appStarted", reg->impl->jobs()->appStarted());
 }
 
 core::Signal<const std::shared_ptr<Application>&, const std::shared_ptr<Application::Instance>&>& Registry::appStopped(
     const std::shared_ptr<Registry>& reg)
 {
-    return reg->impl->jobs()->appStopped();
+    return reg->impl->registrySignal(reg.get(), "appStopped", reg->impl->jobs()->appStopped());
 }
 
 core::Signal<const std::shared_ptr<Application>&, const std::shared_ptr<Application::Instance>&, Registry::FailureType>&
     Registry::appFailed(const std::shared_ptr<Registry>& reg)
 {
-    return reg->impl->jobs()->appFailed();
+    return reg->impl->registrySignal(reg.get(), "appFailed", reg->impl->jobs()->appFailed());
 }
 
 core::Signal<const std::shared_ptr<Application>&,
@@ -120,7 +211,7 @@ core::Signal<const std::shared_ptr<Application>&,
              const std::vector<pid_t>&>&
     Registry::appPaused(const std::shared_ptr<Registry>& reg)
 {
-    return reg->impl->jobs()->appPaused();
+    return reg->impl->registrySignal(reg.get(), "appPaused", reg->impl->jobs()->appPaused());
 }
 
 core::Signal<const std::shared_ptr<Application>&,
@@ -128,40 +219,43 @@ core::Signal<const std::shared_ptr<Application>&,
              const std::vector<pid_t>&>&
     Registry::appResumed(const std::shared_ptr<Registry>& reg)
 {
-    return reg->impl->jobs()->appResumed();
+    return reg->impl->registrySignal(reg.get(), "appResumed", reg->impl->jobs()->appResumed());
 }
 
 core::Signal<const std::shared_ptr<Helper>&, const std::shared_ptr<Helper::Instance>&>& Registry::helperStarted(
     Helper::Type type, const std::shared_ptr<Registry>& reg)
 {
-    return reg->impl->jobs()->helperStarted(type);
+    return reg->impl->registrySignal(reg.get(), "helperStarted-" + type.value(),
+                                     reg->impl->jobs()->helperStarted(type));
 }
 
 core::Signal<const std::shared_ptr<Helper>&, const std::shared_ptr<Helper::Instance>&>& Registry::helperStopped(
     Helper::Type type, const std::shared_ptr<Registry>& reg)
 {
-    return reg->impl->jobs()->helperStopped(type);
+    return reg->impl->registrySignal(reg.get(), "helperStopped-" + type.value(),
+                                     reg->impl->jobs()->helperStopped(type));
 }
 
 core::Signal<const std::shared_ptr<Helper>&, const std::shared_ptr<Helper::Instance>&, Registry::FailureType>&
     Registry::helperFailed(Helper::Type type, const std::shared_ptr<Registry>& reg)
 {
-    return reg->impl->jobs()->helperFailed(type);
+    return reg->impl->registrySignal(reg.get(), "helperFailed-" + type.value(),
+                                     reg->impl->jobs()->helperFailed(type));
 }
 
 core::Signal<const std::shared_ptr<Application>&>& Registry::appInfoUpdated(const std::shared_ptr<Registry>& reg)
 {
-    return reg->impl->appInfoUpdated();
+    return reg->impl->registrySignal(reg.get(), "appInfoUpdated", reg->impl->appInfoUpdated());
 }
 
 core::Signal<const std::shared_ptr<Application>&>& Registry::appAdded(const std::shared_ptr<Registry>& reg)
 {
-    return reg->impl->appAdded();
+    return reg->impl->registrySignal(reg.get(), "appAdded", reg->impl->appAdded());
 }
 
 core::Signal<const AppID&>& Registry::appRemoved(const std::shared_ptr<Registry>& reg)
 {
-    return reg->impl->appRemoved();
+    return reg->impl->registrySignal(reg.get(), "appRemoved", reg->impl->appRemoved());
 }
 
 }  // namespace app_launch
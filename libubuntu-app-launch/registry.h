@@ -17,10 +17,15 @@
  *     Ted Gould <ted.gould@canonical.com>
  */
 
+#include <chrono>
 #include <core/signal.h>
+#include <cstdint>
 #include <functional>
 #include <list>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "application.h"
 #include "helper.h"
@@ -38,10 +43,14 @@ namespace app_launch
     and running applications.
 
     This class also holds onto shared resources for Ubuntu App Launch objects and
-    functions. Generally speaking, there should only be one of them in the
-    process. There are singleton functions, getDefault() and clearDefault(), which
-    can be used to port applications from the old C API to the new C++ one
-    but their use is discouraged. */
+    functions. All the Registry objects in a process, including the one used by
+    the C API, share a single set of them: the background thread, the bus
+    connections and the tracking of running jobs. They are built with the first
+    Registry and released with the last one. Signal connections made through a
+    Registry go away with it, and there is a single Manager for the process
+    which only the Registry that set it can clear. There are singleton functions,
+    getDefault() and clearDefault(), which can be used to port applications from
+    the old C API to the new C++ one but their use is discouraged. */
 class Registry
 {
 public:
@@ -73,6 +82,107 @@ public:
     */
     static std::list<std::shared_ptr<Application>> installedApps(std::shared_ptr<Registry> registry = getDefault());
 
+    /** Find the application instance that a process is part of. This reads
+        the control group of the process, so it finds any process that the
+        application started and doesn't have to ask systemd.
+
+        \param pid Process to look for
+        \return The application and its instance, both null if the process
+                isn't part of a running application
+    */
+    std::pair<std::shared_ptr<Application>, std::shared_ptr<Application::Instance>> findInstanceByPid(pid_t pid);
+
+    /* Snapshot */
+    /** Everything that is running at one point in time. Getting the same
+        information through the Application and Helper objects asks for
+        each value separately, and the instances can come and go between
+        the calls. */
+    struct Snapshot
+    {
+        /** Where the instance is in its lifecycle */
+        enum class State
+        {
+            STARTING, /**< The unit exists but its main process isn't known yet */
+            RUNNING,  /**< The main process is running */
+            PAUSED    /**< The main process is stopped, usually by Application::Instance::pause() */
+        };
+
+        /** A running application or helper instance */
+        struct Instance
+        {
+            AppID appid;             /**< Application ID */
+            std::string job;         /**< Job name, for helpers this is the helper type */
+            std::string instanceid;  /**< Instance ID, empty for single instance applications */
+            bool helper;             /**< Whether this is a helper instead of an application */
+            State state;             /**< Lifecycle state */
+            pid_t primaryPid;        /**< Main PID, zero when starting */
+            std::vector<pid_t> pids; /**< All the PIDs in the instance */
+            oom::Score oomScore;     /**< OOM adjustment of the main PID, zero if it couldn't be read */
+        };
+
+        /** All the instances, grouped by job */
+        std::vector<Instance> instances;
+        /** Sequence number of the last change in the change feed that is
+            included, pass it to changesSince() to follow from here */
+        std::uint64_t sequence;
+    };
+
+    /** Get a snapshot of all the running applications and helpers. It is
+        built in one pass over the units that are running, so it takes a
+        single trip to the UAL thread and one DBus call per instance.
+
+        \note The snapshot doesn't change, get a new one to see changes
+    */
+    std::shared_ptr<const Snapshot> snapshot();
+
+    /* Change Feed */
+    /** A change to a running application or helper instance. Changes are
+        kept in order in a feed of limited size so that someone mirroring
+        the running instances can catch up on what they missed instead of
+        getting everything again. */
+    struct Change
+    {
+        /** What happened to the instance */
+        enum class Type
+        {
+            STARTED, /**< The instance started */
+            STOPPED, /**< The instance stopped */
+            FAILED,  /**< The instance failed, see failure */
+            PAUSED,  /**< The instance was paused, see pids */
+            RESUMED  /**< The instance was resumed, see pids */
+        };
+
+        std::uint64_t sequence;  /**< Position in the feed, each change is one more than the one before it */
+        Type type;               /**< What happened */
+        AppID appid;             /**< Application ID */
+        std::string job;         /**< Job name, for helpers this is the helper type */
+        std::string instanceid;  /**< Instance ID, empty for single instance applications */
+        bool helper;             /**< Whether this is a helper instead of an application */
+        FailureType failure;     /**< Why it failed, only set for FAILED */
+        std::vector<pid_t> pids; /**< PIDs that were paused or resumed, only set for PAUSED and RESUMED */
+    };
+
+    /** Get the changes that came after a sequence number. The feed starts
+        with the first call to this, snapshot() or changed(), so the usual
+        way to use it is to get a snapshot and then follow the changes from
+        the snapshot's sequence number. A change right after a snapshot can
+        repeat what it already shows, like an instance starting that the
+        snapshot has as starting.
+
+        \param after Sequence number of the last change already seen
+        \param changes Filled with the changes after \p after, oldest first
+        \return Whether all of the changes after \p after were still in the
+                feed, if not they need to start again with a snapshot()
+    */
+    bool changesSince(std::uint64_t after, std::vector<Change>& changes);
+
+    /** Get the signal object that is signaled with each change as it is
+        added to the change feed.
+
+        \note This signal handler is activated on the UAL thread
+    */
+    core::Signal<const Change&>& changed();
+
     /* Signals to discover what is happening to apps */
     /** Get the signal object that is signaled when an application has been
         started.
@@ -223,14 +333,17 @@ public:
         start and gain focus. In almost all cases this should be Unity8 as it
         will be controlling applications.
 
-        This function will failure if there is already a manager set.
+        This function will failure if there is already a manager set. There is
+        one manager for the process, as all the Registry objects share their
+        backend, so this includes one set through another Registry.
 
         \param manager A reference to the Manager object to call
         \param registry Registry to register the manager on
     */
     static void setManager(const std::shared_ptr<Manager>& manager, const std::shared_ptr<Registry>& registry);
 
-    /** Remove the current manager on the registry */
+    /** Remove the current manager if it was set through this registry. It is
+        also removed when this registry is destroyed. */
     void clearManager();
 
     /* Helper Lists */
@@ -273,6 +386,63 @@ public:
     static core::Signal<const std::shared_ptr<Helper>&, const std::shared_ptr<Helper::Instance>&, FailureType>&
         helperFailed(Helper::Type type, const std::shared_ptr<Registry>& reg = getDefault());
 
+    /** Keep helpers of a type started ahead of time. After a helper of the
+        type is launched we start this many more for its AppID, they run the
+        exec-tool and then wait, so the next launch only has to hand over
+        the URLs. Helpers that don't get used exit on their own after a while.
+
+        \note Only helpers with an exec-tool and without a Mir prompt
+              session can be started ahead of time
+
+        \param type Helper type string
+        \param size Number of helpers to keep waiting, zero turns it off
+    */
+    void setHelperPoolSize(const Helper::Type& type, unsigned int size);
+
+    /* Thread Stats */
+    /** Information on the work done on the UAL thread. All the signals,
+        timeouts and DBus handling for the registry run there, so when it
+        is backed up everything using the registry is slow. */
+    struct ThreadStats
+    {
+        /** How the work got on to the thread */
+        enum class Kind
+        {
+            TASK,    /**< Work queued from another thread */
+            TIMEOUT, /**< A timer that fired */
+            CALLBACK /**< A signal or DBus callback */
+        };
+
+        /** A single piece of work that took a long time to run */
+        struct SlowTask
+        {
+            Kind kind;                          /**< Type of work */
+            std::string site;                   /**< Source file, line and function that queued it */
+            std::chrono::microseconds queued;   /**< Time spent waiting to run */
+            std::chrono::microseconds executed; /**< Time spent running */
+        };
+
+        std::size_t queueDepth;    /**< Tasks waiting to run right now */
+        std::size_t maxQueueDepth; /**< Most tasks that have been waiting at once */
+        std::uint64_t tasks;       /**< Number of tasks run */
+        std::uint64_t timeouts;    /**< Number of timeouts run */
+        std::uint64_t callbacks;   /**< Number of callbacks run */
+        /** Histogram of the time tasks and timeouts waited to run. Buckets are
+            powers of two in microseconds, the first one is under a microsecond
+            and the last one has everything that doesn't fit in the others. */
+        std::vector<std::uint64_t> queueTime;
+        /** Histogram of the time work took to run, same buckets as queueTime */
+        std::vector<std::uint64_t> execTime;
+        /** The most recent slow work, oldest first */
+        std::list<SlowTask> slowTasks;
+    };
+
+    /** Get the current statistics for the UAL thread
+
+        \param reset Clear the statistics after reading them
+    */
+    ThreadStats threadStats(bool reset = false);
+
     /* Default Junk */
     /** Use the Registry as a global singleton, this function will create
         a Registry object if one doesn't exist. Use of this function is
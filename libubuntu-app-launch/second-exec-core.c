@@ -280,6 +280,23 @@ get_pid_cb (GObject * object, GAsyncResult * res, gpointer user_data)
 	return;
 }
 
+/* We already know which connections belong to the application, so we
+   can skip asking the bus about everyone else */
+static void
+contact_connections (GDBusConnection * session, const gchar * const * connections, second_exec_t * data)
+{
+	g_debug("Primary PID: %d", data->app_pid);
+	ual_tracepoint(second_exec_got_primary_pid, data->appid);
+
+	int i;
+	for (i = 0; connections[i] != NULL; i++) {
+		data->connections_open++;
+		contact_app(session, connections[i], data);
+	}
+
+	return;
+}
+
 /* Starts to look for the PID and the connections for that PID */
 static void
 find_appid_pid (GDBusConnection * session, second_exec_t * data)
@@ -353,8 +370,11 @@ find_appid_pid (GDBusConnection * session, second_exec_t * data)
 	return;
 }
 
+/* If the caller knows which connections belong to the application it can
+   pass them in @connections, otherwise pass NULL and we'll ask the bus for
+   the PID of every connection to find them. */
 gboolean
-second_exec (GDBusConnection * session, GCancellable * cancel, GPid pid, const gchar * app_id, const gchar * instance_id, gchar ** appuris)
+second_exec (GDBusConnection * session, GCancellable * cancel, GPid pid, const gchar * app_id, const gchar * instance_id, gchar ** appuris, const gchar * const * connections)
 {
 	ual_tracepoint(second_exec_start, app_id);
 	GError * error = NULL;
@@ -404,7 +424,9 @@ second_exec (GDBusConnection * session, GCancellable * cancel, GPid pid, const g
 	}
 
 	/* If we've got something to give out, start looking for how */
-	if (data->input_uris != NULL) {
+	if (data->input_uris != NULL && connections != NULL) {
+		contact_connections(session, connections, data);
+	} else if (data->input_uris != NULL) {
 		find_appid_pid(session, data);
 	} else {
 		g_debug("No URIs to send");
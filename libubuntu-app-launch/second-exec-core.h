@@ -22,7 +22,7 @@
 
 G_BEGIN_DECLS
 
-gboolean second_exec (GDBusConnection * con, GCancellable * cancel, GPid pid, const gchar * app_id, const gchar * instance_id, gchar ** appuris);
+gboolean second_exec (GDBusConnection * con, GCancellable * cancel, GPid pid, const gchar * app_id, const gchar * instance_id, gchar ** appuris, const gchar * const * connections);
 
 G_END_DECLS
 
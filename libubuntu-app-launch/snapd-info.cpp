@@ -32,14 +32,15 @@ namespace snapd
 {
 
 /** Initializes the info object which mostly means checking what is overridden
-    by environment variables (mostly for testing) and making sure there is a
-    snapd socket available to us. */
+    by environment variables (mostly for testing). */
 Info::Info()
 {
     auto snapdEnv = g_getenv("UBUNTU_APP_LAUNCH_SNAPD_SOCKET");
     if (G_UNLIKELY(snapdEnv != nullptr))
     {
         snapdSocket = snapdEnv;
+        /* Test sockets come and go between tests */
+        snapdRecheck = 0;
     }
     else
     {
@@ -55,11 +56,39 @@ Info::Info()
     {
         snapBasedir = "/snap";
     }
+}
+
+/** Checks whether the snapd socket is there. The registry backend is
+    shared by the whole process and can be built before snapd is running,
+    so we keep looking until it shows up. Looking is a stat() and we get
+    asked for every snap lookup, so we only look again once
+    @snapdRecheck has passed since the last time. */
+bool Info::snapdAvailable() const
+{
+    if (G_LIKELY(snapdExists))
+    {
+        return true;
+    }
+
+    auto now = g_get_monotonic_time();
+    auto checked = snapdChecked.load();
+    if (checked != 0 && now - checked < snapdRecheck)
+    {
+        return false;
+    }
+
+    /* Only one thread needs to look */
+    if (!snapdChecked.compare_exchange_strong(checked, now))
+    {
+        return snapdExists;
+    }
 
     if (g_file_test(snapdSocket.c_str(), G_FILE_TEST_EXISTS))
     {
         snapdExists = true;
     }
+
+    return snapdExists;
 }
 
 /** Gets package information out of snapd by using the REST
@@ -69,7 +98,7 @@ Info::Info()
 */
 std::shared_ptr<Info::PkgInfo> Info::pkgInfo(const AppID::Package &package) const
 {
-    if (!snapdExists)
+    if (!snapdAvailable())
     {
         return {};
     }
@@ -320,7 +349,7 @@ std::shared_ptr<JsonNode> Info::snapdJson(const std::string &endpoint) const
 */
 void Info::forAllPlugs(std::function<void(JsonObject *plugobj)> plugfunc) const
 {
-    if (!snapdExists)
+    if (!snapdAvailable())
     {
         return;
     }
@@ -371,10 +400,10 @@ void Info::forAllPlugs(std::function<void(JsonObject *plugobj)> plugfunc) const
 
     \param in_interface Which interface to get the set of apps for
 */
-std::set<AppID> Info::appsForInterface(const std::string &in_interface) const
+std::unordered_set<InternedAppID> Info::appsForInterface(const std::string &in_interface) const
 {
     bool interfacefound = false;
-    std::set<AppID> appids;
+    std::unordered_set<InternedAppID> appids;
 
     try
     {
@@ -19,13 +19,16 @@
 
 #pragma once
 
+#include <atomic>
 #include <list>
 #include <memory>
 #include <set>
+#include <unordered_set>
 
 #include <json-glib/json-glib.h>
 
 #include "appid.h"
+#include "interned-appid.h"
 
 namespace ubuntu
 {
@@ -53,7 +56,7 @@ public:
     };
     std::shared_ptr<PkgInfo> pkgInfo(const AppID::Package &package) const;
 
-    std::set<AppID> appsForInterface(const std::string &interface) const;
+    std::unordered_set<InternedAppID> appsForInterface(const std::string &interface) const;
 
     std::set<std::string> interfacesForAppId(const AppID &appid) const;
 
@@ -63,9 +66,15 @@ private:
     /** Directory to use as the base for all snap packages when making paths. This
         can be overridden with UBUNTU_APP_LAUNCH_SNAP_BASEDIR */
     std::string snapBasedir;
-    /** Result of a check at init to see if the socket is available. If
-        not all functions will return null results. */
-    bool snapdExists = false;
+    /** Set once we've seen the socket. Until then all functions will
+        return null results. */
+    mutable std::atomic<bool> snapdExists{false};
+    /** Monotonic time we last looked for the socket, zero if we haven't */
+    mutable std::atomic<gint64> snapdChecked{0};
+    /** How long to wait before looking for the socket again, in
+        microseconds */
+    gint64 snapdRecheck = G_USEC_PER_SEC;
+    bool snapdAvailable() const;
 
     std::shared_ptr<JsonNode> snapdJson(const std::string &endpoint) const;
     void forAllPlugs(std::function<void(JsonObject *plugobj)> plugfunc) const;
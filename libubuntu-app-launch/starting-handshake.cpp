@@ -0,0 +1,180 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "starting-handshake.h"
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+StartingHandshake::StartingHandshake(GLib::ContextThread& thread, const std::shared_ptr<GDBusConnection>& bus)
+    : thread_(thread)
+    , bus_(bus)
+{
+    /* No arg0 here, one match rule covers all the applications. The
+       callback gets dispatched on the thread that subscribes so this
+       needs to be created on the registry's thread. */
+    handle_startingSignal = managedDBusSignalConnection(
+        g_dbus_connection_signal_subscribe(
+            bus_.get(),                      /* bus */
+            nullptr,                         /* sender */
+            "com.canonical.UbuntuAppLaunch", /* interface */
+            "UnityStartingSignal",           /* signal */
+            "/",                             /* path */
+            nullptr,                         /* arg0 */
+            G_DBUS_SIGNAL_FLAGS_NONE,
+            [](GDBusConnection*, const gchar*, const gchar*, const gchar*, const gchar*, GVariant* params,
+               gpointer user_data) -> void {
+                auto pthis = static_cast<StartingHandshake*>(user_data);
+                GLib::ContextThread::CallbackTimer timer(pthis->thread_);
+
+                if (!g_variant_check_format_string(params, "(ss)", FALSE))
+                {
+                    g_warning("Got 'UnityStartingSignal' with unknown parameter type: %s",
+                              g_variant_get_type_string(params));
+                    return;
+                }
+
+                const gchar* cappid{nullptr};
+                const gchar* cinstance{nullptr};
+                g_variant_get(params, "(&s&s)", &cappid, &cinstance);
+
+                pthis->replyReceived(cappid, cinstance);
+            },        /* callback */
+            this,     /* user data */
+            nullptr), /* user data destroy */
+        bus_);
+}
+
+StartingHandshake::~StartingHandshake()
+{
+    for (const auto& pending : pending_)
+    {
+        thread_.removeSource(pending.second.timeout);
+    }
+}
+
+/** Tell the manager that an application is starting. The complete function
+    is called once the manager replies, or when the timeout runs out if it
+    doesn't, and is always called on the thread.
+
+    \param appid Application ID being started
+    \param instance Instance of the application being started
+    \param timeout How long to wait on the manager
+    \param complete Function to call when it is time to start the application
+*/
+void StartingHandshake::start(const std::string& appid,
+                              const std::string& instance,
+                              std::chrono::seconds timeout,
+                              std::function<void()> complete)
+{
+    auto id = nextId_++;
+    auto timeoutSource = thread_.timeoutSeconds(timeout, [this, id]() { timedOut(id); });
+
+    pending_.emplace(std::make_pair(appid, instance), Pending{id, timeoutSource, std::move(complete)});
+
+    GError* error{nullptr};
+    g_dbus_connection_emit_signal(bus_.get(),                                              /* bus */
+                                  nullptr,                                                 /* destination */
+                                  "/",                                                     /* path */
+                                  "com.canonical.UbuntuAppLaunch",                         /* interface */
+                                  "UnityStartingBroadcast",                                /* signal */
+                                  g_variant_new("(ss)", appid.c_str(), instance.c_str()), /* params */
+                                  &error);                                                 /* error */
+
+    if (error != nullptr)
+    {
+        /* The timeout will get us started anyway */
+        g_warning("Unable to emit starting broadcast for '%s': %s", appid.c_str(), error->message);
+        g_error_free(error);
+    }
+}
+
+/** The manager is done with an application, start the launch waiting for
+    it. If we don't have one for that instance we use the oldest one for the
+    application as older managers only cared about the AppID. The IDs go up
+    with each launch so the oldest is the one with the lowest ID. */
+void StartingHandshake::replyReceived(const std::string& appid, const std::string& instance)
+{
+    auto oldest = [](const std::pair<PendingMap::iterator, PendingMap::iterator>& range) {
+        auto found = range.first;
+        for (auto it = range.first; it != range.second; it++)
+        {
+            if (it->second.id < found->second.id)
+            {
+                found = it;
+            }
+        }
+        return found;
+    };
+
+    auto range = pending_.equal_range(std::make_pair(appid, instance));
+
+    if (range.first == range.second)
+    {
+        /* All the instances of the application are next to each other */
+        range.first = pending_.lower_bound(std::make_pair(appid, std::string{}));
+        range.second = range.first;
+        while (range.second != pending_.end() && range.second->first.first == appid)
+        {
+            range.second++;
+        }
+
+        if (range.first == range.second)
+        {
+            /* Not ours, or we already gave up on it */
+            return;
+        }
+    }
+
+    auto it = oldest(range);
+    thread_.removeSource(it->second.timeout);
+    finish(it);
+}
+
+/** The manager took too long, go ahead and start anyway */
+void StartingHandshake::timedOut(std::uint64_t id)
+{
+    for (auto it = pending_.begin(); it != pending_.end(); it++)
+    {
+        if (it->second.id == id)
+        {
+            g_debug("Timeout waiting on starting handshake for: %s", it->first.first.c_str());
+            finish(it);
+            return;
+        }
+    }
+}
+
+void StartingHandshake::finish(PendingMap::iterator it)
+{
+    /* Take it out of the map first, the complete function may want to
+       start another handshake */
+    auto complete = std::move(it->second.complete);
+    pending_.erase(it);
+
+    if (complete)
+    {
+        complete();
+    }
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
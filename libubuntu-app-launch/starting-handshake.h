@@ -0,0 +1,88 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <gio/gio.h>
+
+#include "glib-thread.h"
+#include "signal-unsubscriber.h"
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** The starting handshake with the manager. Before an application is
+    started we broadcast that it is starting and wait for the manager to
+    reply, or for a timeout, so that it has a chance to get ready.
+
+    This keeps a single subscription to the manager's replies for the
+    life of the registry and matches them with the pending launches by
+    AppID and instance. Everything here must be used on the registry's
+    thread. */
+class StartingHandshake
+{
+public:
+    StartingHandshake(GLib::ContextThread& thread, const std::shared_ptr<GDBusConnection>& bus);
+    ~StartingHandshake();
+
+    void start(const std::string& appid,
+               const std::string& instance,
+               std::chrono::seconds timeout,
+               std::function<void()> complete);
+
+    /** Number of launches waiting on the manager */
+    std::size_t pending() const
+    {
+        return pending_.size();
+    }
+
+private:
+    /** A launch waiting for the manager to reply */
+    struct Pending
+    {
+        std::uint64_t id;
+        guint timeout;
+        std::function<void()> complete;
+    };
+    typedef std::multimap<std::pair<std::string, std::string>, Pending> PendingMap;
+
+    GLib::ContextThread& thread_;
+    std::shared_ptr<GDBusConnection> bus_;
+    ManagedDBusSignalConnection handle_startingSignal{DBusSignalUnsubscriber{}};
+
+    PendingMap pending_;
+    std::uint64_t nextId_ = 0;
+
+    void replyReceived(const std::string& appid, const std::string& instance);
+    void timedOut(std::uint64_t id);
+    void finish(PendingMap::iterator it);
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
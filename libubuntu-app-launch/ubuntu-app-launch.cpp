@@ -515,6 +515,150 @@ ubuntu_app_launch_observer_delete_app_resumed (UbuntuAppLaunchAppPausedResumedOb
 	return observer_delete<UbuntuAppLaunchAppPausedResumedObserver>(observer, user_data, appResumedObservers);
 }
 
+/** Watches for a single AppID or package, they don't use the application
+    signals so that events for other applications don't build objects. */
+typedef ubuntu::app_launch::jobs::manager::Base::AppEvent FilteredEvent;
+typedef std::unique_ptr<ubuntu::app_launch::jobs::manager::Base::AppWatch> FilteredWatch;
+
+template<typename observertype>
+using FilteredObserverMap = std::map<std::tuple<observertype, std::string, gpointer>, FilteredWatch>;
+
+/** Adds a filtered watch for an event, the callback is called on the GLib thread
+    and gets the AppID and the PIDs for the event */
+template<typename observertype>
+static gboolean
+observer_add_filtered (FilteredEvent event, observertype observer, const gchar * filter, gpointer user_data, const ubuntu::app_launch::jobs::manager::Base::AppWatchCallback &callback, FilteredObserverMap<observertype> &observers)
+{
+	try {
+		auto watch = ubuntu::app_launch::Registry::getDefault()->impl->jobs()->watchApps(event, filter, callback);
+		observers[std::make_tuple(observer, std::string(filter), user_data)] = std::move(watch);
+		return TRUE;
+	} catch (const std::exception& e) {
+		g_warning("Unable to watch applications matching '%s': %s", filter, e.what());
+		return FALSE;
+	}
+}
+
+/** Removes a filtered watch, after it returns the observer won't be queued again */
+template<typename observertype>
+static gboolean
+observer_delete_filtered (observertype observer, const gchar * filter, gpointer user_data, FilteredObserverMap<observertype> &observers)
+{
+	auto iter = observers.find(std::make_tuple(observer, std::string(filter), user_data));
+
+	if (iter == observers.end()) {
+		return FALSE;
+	}
+
+	observers.erase(iter);
+	return TRUE;
+}
+
+/** Handy helper for the started and stopped filtered observers */
+static gboolean
+observer_add_app_filtered (FilteredEvent event, UbuntuAppLaunchAppObserver observer, const gchar * filter, gpointer user_data, FilteredObserverMap<UbuntuAppLaunchAppObserver> &observers)
+{
+	auto context = share_glib(g_main_context_ref_thread_default());
+
+	return observer_add_filtered<UbuntuAppLaunchAppObserver>(event, observer, filter, user_data, [context, observer, user_data](const std::string &appid, const std::vector<pid_t> &pids) {
+		executeOnContext(context, [appid, observer, user_data]() {
+			observer(appid.c_str(), user_data);
+		});
+	}, observers);
+}
+
+/** Handy helper for the paused and resumed filtered observers */
+static gboolean
+observer_add_pause_filtered (FilteredEvent event, UbuntuAppLaunchAppPausedResumedObserver observer, const gchar * filter, gpointer user_data, FilteredObserverMap<UbuntuAppLaunchAppPausedResumedObserver> &observers)
+{
+	auto context = share_glib(g_main_context_ref_thread_default());
+
+	return observer_add_filtered<UbuntuAppLaunchAppPausedResumedObserver>(event, observer, filter, user_data, [context, observer, user_data](const std::string &appid, const std::vector<pid_t> &pids) {
+		std::vector<pid_t> lpids = pids;
+		lpids.emplace_back(0);
+
+		executeOnContext(context, [appid, observer, user_data, lpids]() {
+			observer(appid.c_str(), (int *)(lpids.data()), user_data);
+		});
+	}, observers);
+}
+
+static FilteredObserverMap<UbuntuAppLaunchAppObserver> appStartedFilteredObservers;
+
+gboolean
+ubuntu_app_launch_observer_add_app_started_filtered (UbuntuAppLaunchAppObserver observer, const gchar * filter, gpointer user_data)
+{
+	g_return_val_if_fail(observer != NULL, FALSE);
+	g_return_val_if_fail(filter != NULL, FALSE);
+
+	return observer_add_app_filtered(FilteredEvent::STARTED, observer, filter, user_data, appStartedFilteredObservers);
+}
+
+gboolean
+ubuntu_app_launch_observer_delete_app_started_filtered (UbuntuAppLaunchAppObserver observer, const gchar * filter, gpointer user_data)
+{
+	g_return_val_if_fail(filter != NULL, FALSE);
+
+	return observer_delete_filtered<UbuntuAppLaunchAppObserver>(observer, filter, user_data, appStartedFilteredObservers);
+}
+
+static FilteredObserverMap<UbuntuAppLaunchAppObserver> appStoppedFilteredObservers;
+
+gboolean
+ubuntu_app_launch_observer_add_app_stop_filtered (UbuntuAppLaunchAppObserver observer, const gchar * filter, gpointer user_data)
+{
+	g_return_val_if_fail(observer != NULL, FALSE);
+	g_return_val_if_fail(filter != NULL, FALSE);
+
+	return observer_add_app_filtered(FilteredEvent::STOPPED, observer, filter, user_data, appStoppedFilteredObservers);
+}
+
+gboolean
+ubuntu_app_launch_observer_delete_app_stop_filtered (UbuntuAppLaunchAppObserver observer, const gchar * filter, gpointer user_data)
+{
+	g_return_val_if_fail(filter != NULL, FALSE);
+
+	return observer_delete_filtered<UbuntuAppLaunchAppObserver>(observer, filter, user_data, appStoppedFilteredObservers);
+}
+
+static FilteredObserverMap<UbuntuAppLaunchAppPausedResumedObserver> appPausedFilteredObservers;
+
+gboolean
+ubuntu_app_launch_observer_add_app_paused_filtered (UbuntuAppLaunchAppPausedResumedObserver observer, const gchar * filter, gpointer user_data)
+{
+	g_return_val_if_fail(observer != NULL, FALSE);
+	g_return_val_if_fail(filter != NULL, FALSE);
+
+	return observer_add_pause_filtered(FilteredEvent::PAUSED, observer, filter, user_data, appPausedFilteredObservers);
+}
+
+gboolean
+ubuntu_app_launch_observer_delete_app_paused_filtered (UbuntuAppLaunchAppPausedResumedObserver observer, const gchar * filter, gpointer user_data)
+{
+	g_return_val_if_fail(filter != NULL, FALSE);
+
+	return observer_delete_filtered<UbuntuAppLaunchAppPausedResumedObserver>(observer, filter, user_data, appPausedFilteredObservers);
+}
+
+static FilteredObserverMap<UbuntuAppLaunchAppPausedResumedObserver> appResumedFilteredObservers;
+
+gboolean
+ubuntu_app_launch_observer_add_app_resumed_filtered (UbuntuAppLaunchAppPausedResumedObserver observer, const gchar * filter, gpointer user_data)
+{
+	g_return_val_if_fail(observer != NULL, FALSE);
+	g_return_val_if_fail(filter != NULL, FALSE);
+
+	return observer_add_pause_filtered(FilteredEvent::RESUMED, observer, filter, user_data, appResumedFilteredObservers);
+}
+
+gboolean
+ubuntu_app_launch_observer_delete_app_resumed_filtered (UbuntuAppLaunchAppPausedResumedObserver observer, const gchar * filter, gpointer user_data)
+{
+	g_return_val_if_fail(filter != NULL, FALSE);
+
+	return observer_delete_filtered<UbuntuAppLaunchAppPausedResumedObserver>(observer, filter, user_data, appResumedFilteredObservers);
+}
+
 gchar **
 ubuntu_app_launch_list_running_apps (void)
 {
@@ -580,6 +724,13 @@ ubuntu_app_launch_pid_in_app_id (GPid pid, const gchar * appid)
 	try {
 		auto registry = ubuntu::app_launch::Registry::getDefault();
 		auto appId = ubuntu::app_launch::AppID::find(appid);
+
+		/* Check the PID's unit first, asking the instance needs the bus */
+		auto found = registry->findInstanceByPid(pid);
+		if (found.first) {
+			return found.first->appId() == appId ? TRUE : FALSE;
+		}
+
 		auto app = ubuntu::app_launch::Application::create(appId, registry);
 
 		if (app->instances().at(0)->hasPid(pid)) {
@@ -592,6 +743,79 @@ ubuntu_app_launch_pid_in_app_id (GPid pid, const gchar * appid)
 	}
 }
 
+UbuntuAppLaunchInstanceSnapshot *
+ubuntu_app_launch_get_snapshot (guint * n_instances)
+{
+	g_return_val_if_fail(n_instances != NULL, NULL);
+	*n_instances = 0;
+
+	try {
+		auto snapshot = ubuntu::app_launch::Registry::getDefault()->snapshot();
+		const auto& instances = snapshot->instances;
+
+		if (instances.empty()) {
+			return nullptr;
+		}
+
+		/* One block with the entries, then all the PIDs, then all the strings */
+		gsize entrysize = sizeof(UbuntuAppLaunchInstanceSnapshot) * instances.size();
+		gsize pidsize = 0;
+		gsize stringsize = 0;
+		for (const auto& inst : instances) {
+			pidsize += sizeof(GPid) * inst.pids.size();
+			stringsize += inst.appid.str().size() + inst.job.size() + inst.instanceid.size() + 3;
+		}
+
+		auto block = static_cast<gchar *>(g_malloc0(entrysize + pidsize + stringsize));
+		auto entries = reinterpret_cast<UbuntuAppLaunchInstanceSnapshot *>(block);
+		auto pids = reinterpret_cast<GPid *>(block + entrysize);
+		auto strings = block + entrysize + pidsize;
+
+		auto packString = [&strings](const std::string& str) {
+			auto retval = strings;
+			memcpy(strings, str.c_str(), str.size() + 1);
+			strings += str.size() + 1;
+			return retval;
+		};
+
+		for (std::size_t i = 0; i < instances.size(); i++) {
+			const auto& inst = instances[i];
+			auto& entry = entries[i];
+
+			entry.appid = packString(inst.appid.str());
+			entry.job = packString(inst.job);
+			entry.instance_id = packString(inst.instanceid);
+			entry.helper = inst.helper ? TRUE : FALSE;
+			entry.primary_pid = inst.primaryPid;
+			entry.oom_score = static_cast<gint>(inst.oomScore);
+
+			switch (inst.state) {
+			case ubuntu::app_launch::Registry::Snapshot::State::STARTING:
+				entry.state = UBUNTU_APP_LAUNCH_INSTANCE_STATE_STARTING;
+				break;
+			case ubuntu::app_launch::Registry::Snapshot::State::RUNNING:
+				entry.state = UBUNTU_APP_LAUNCH_INSTANCE_STATE_RUNNING;
+				break;
+			case ubuntu::app_launch::Registry::Snapshot::State::PAUSED:
+				entry.state = UBUNTU_APP_LAUNCH_INSTANCE_STATE_PAUSED;
+				break;
+			}
+
+			entry.n_pids = inst.pids.size();
+			entry.pids = pids;
+			for (auto pid : inst.pids) {
+				*pids++ = pid;
+			}
+		}
+
+		*n_instances = instances.size();
+		return entries;
+	} catch (const std::exception& e) {
+		g_debug("Unable to get snapshot: %s", e.what());
+		return nullptr;
+	}
+}
+
 gboolean
 ubuntu_app_launch_app_id_parse (const gchar * appid, gchar ** package, gchar ** application, gchar ** version)
 {
@@ -647,7 +871,7 @@ ubuntu_app_launch_triplet_to_app_id (const gchar * pkg, const gchar * app, const
 		return nullptr;
 	}
 
-	return g_strdup(std::string(appid).c_str());
+	return g_strdup(appid.str().c_str());
 }
 
 gboolean
@@ -39,6 +39,44 @@ typedef enum { /*< prefix=UBUNTU_APP_LAUNCH_APP_FAILED */
 	UBUNTU_APP_LAUNCH_APP_FAILED_START_FAILURE  /*< nick=start-failure */
 } UbuntuAppLaunchAppFailed;
 
+/**
+ * UbuntuAppLaunchInstanceState:
+ *
+ * Lifecycle state of an instance in a snapshot.
+ */
+typedef enum { /*< prefix=UBUNTU_APP_LAUNCH_INSTANCE_STATE */
+	UBUNTU_APP_LAUNCH_INSTANCE_STATE_STARTING,  /*< nick=starting */
+	UBUNTU_APP_LAUNCH_INSTANCE_STATE_RUNNING,   /*< nick=running */
+	UBUNTU_APP_LAUNCH_INSTANCE_STATE_PAUSED     /*< nick=paused */
+} UbuntuAppLaunchInstanceState;
+
+/**
+ * UbuntuAppLaunchInstanceSnapshot:
+ * @appid: ID of the application or helper
+ * @job: Job name, for helpers this is the helper type
+ * @instance_id: Instance ID, empty for single instance applications
+ * @helper: Whether this is a helper instead of an application
+ * @state: Lifecycle state of the instance
+ * @primary_pid: Main PID, zero when starting
+ * @oom_score: OOM adjustment of the main PID, zero if unknown
+ * @n_pids: Number of entries in @pids
+ * @pids: All the PIDs in the instance
+ *
+ * A running application or helper instance returned by
+ * ubuntu_app_launch_get_snapshot().
+ */
+typedef struct {
+	const gchar * appid;
+	const gchar * job;
+	const gchar * instance_id;
+	gboolean helper;
+	UbuntuAppLaunchInstanceState state;
+	GPid primary_pid;
+	gint oom_score;
+	guint n_pids;
+	const GPid * pids;
+} UbuntuAppLaunchInstanceSnapshot;
+
 /**
  * UbuntuAppLaunchAppObserver:
  *
@@ -351,6 +389,128 @@ gboolean   ubuntu_app_launch_observer_delete_app_paused (UbuntuAppLaunchAppPause
 gboolean   ubuntu_app_launch_observer_delete_app_resumed (UbuntuAppLaunchAppPausedResumedObserver  observer,
                                                           gpointer                                 user_data);
 
+/**
+ * ubuntu_app_launch_observer_add_app_started_filtered:
+ * @observer: (scope notified): Callback when a matching application starts
+ * @filter: Full AppID or package name of the applications to watch
+ * @user_data: (closure) (allow-none): Data to pass to the observer
+ *
+ * Like ubuntu_app_launch_observer_add_app_started() but only for the
+ * applications matching @filter. Events for other applications are
+ * dropped before any application objects are built for them.
+ *
+ * Return value: Whether adding the observer was successful.
+ */
+gboolean   ubuntu_app_launch_observer_add_app_started_filtered (UbuntuAppLaunchAppObserver observer,
+                                                                const gchar *              filter,
+                                                                gpointer                   user_data);
+
+/**
+ * ubuntu_app_launch_observer_delete_app_started_filtered:
+ * @observer: (scope notified): Callback to remove
+ * @filter: Filter that was used to add the observer
+ * @user_data: (closure) (allow-none): Data that was passed to the observer
+ *
+ * Removes a callback added with ubuntu_app_launch_observer_add_app_started_filtered().
+ *
+ * Return value: Whether deleting the observer was successful.
+ */
+gboolean   ubuntu_app_launch_observer_delete_app_started_filtered (UbuntuAppLaunchAppObserver observer,
+                                                                   const gchar *              filter,
+                                                                   gpointer                   user_data);
+
+/**
+ * ubuntu_app_launch_observer_add_app_stop_filtered:
+ * @observer: (scope notified): Callback when a matching application stops
+ * @filter: Full AppID or package name of the applications to watch
+ * @user_data: (closure) (allow-none): Data to pass to the observer
+ *
+ * Like ubuntu_app_launch_observer_add_app_stop() but only for the
+ * applications matching @filter. Events for other applications are
+ * dropped before any application objects are built for them.
+ *
+ * Return value: Whether adding the observer was successful.
+ */
+gboolean   ubuntu_app_launch_observer_add_app_stop_filtered (UbuntuAppLaunchAppObserver observer,
+                                                             const gchar *              filter,
+                                                             gpointer                   user_data);
+
+/**
+ * ubuntu_app_launch_observer_delete_app_stop_filtered:
+ * @observer: (scope notified): Callback to remove
+ * @filter: Filter that was used to add the observer
+ * @user_data: (closure) (allow-none): Data that was passed to the observer
+ *
+ * Removes a callback added with ubuntu_app_launch_observer_add_app_stop_filtered().
+ *
+ * Return value: Whether deleting the observer was successful.
+ */
+gboolean   ubuntu_app_launch_observer_delete_app_stop_filtered (UbuntuAppLaunchAppObserver observer,
+                                                                const gchar *              filter,
+                                                                gpointer                   user_data);
+
+/**
+ * ubuntu_app_launch_observer_add_app_paused_filtered:
+ * @observer: (scope notified): Callback when a matching application is paused
+ * @filter: Full AppID or package name of the applications to watch
+ * @user_data: (closure) (allow-none): Data to pass to the observer
+ *
+ * Like ubuntu_app_launch_observer_add_app_paused() but only for the
+ * applications matching @filter. Events for other applications are
+ * dropped before any work is done for them, and when @filter is a
+ * full AppID the bus only delivers its signals.
+ *
+ * Return value: Whether adding the observer was successful.
+ */
+gboolean   ubuntu_app_launch_observer_add_app_paused_filtered (UbuntuAppLaunchAppPausedResumedObserver observer,
+                                                               const gchar *                           filter,
+                                                               gpointer                                user_data);
+
+/**
+ * ubuntu_app_launch_observer_delete_app_paused_filtered:
+ * @observer: (scope notified): Callback to remove
+ * @filter: Filter that was used to add the observer
+ * @user_data: (closure) (allow-none): Data that was passed to the observer
+ *
+ * Removes a callback added with ubuntu_app_launch_observer_add_app_paused_filtered().
+ *
+ * Return value: Whether deleting the observer was successful.
+ */
+gboolean   ubuntu_app_launch_observer_delete_app_paused_filtered (UbuntuAppLaunchAppPausedResumedObserver observer,
+                                                                  const gchar *                           filter,
+                                                                  gpointer                                user_data);
+
+/**
+ * ubuntu_app_launch_observer_add_app_resumed_filtered:
+ * @observer: (scope notified): Callback when a matching application is resumed
+ * @filter: Full AppID or package name of the applications to watch
+ * @user_data: (closure) (allow-none): Data to pass to the observer
+ *
+ * Like ubuntu_app_launch_observer_add_app_resumed() but only for the
+ * applications matching @filter. Events for other applications are
+ * dropped before any work is done for them, and when @filter is a
+ * full AppID the bus only delivers its signals.
+ *
+ * Return value: Whether adding the observer was successful.
+ */
+gboolean   ubuntu_app_launch_observer_add_app_resumed_filtered (UbuntuAppLaunchAppPausedResumedObserver observer,
+                                                                const gchar *                           filter,
+                                                                gpointer                                user_data);
+
+/**
+ * ubuntu_app_launch_observer_delete_app_resumed_filtered:
+ * @observer: (scope notified): Callback to remove
+ * @filter: Filter that was used to add the observer
+ * @user_data: (closure) (allow-none): Data that was passed to the observer
+ *
+ * Removes a callback added with ubuntu_app_launch_observer_add_app_resumed_filtered().
+ *
+ * Return value: Whether deleting the observer was successful.
+ */
+gboolean   ubuntu_app_launch_observer_delete_app_resumed_filtered (UbuntuAppLaunchAppPausedResumedObserver observer,
+                                                                   const gchar *                           filter,
+                                                                   gpointer                                user_data);
+
 /**
  * ubuntu_app_launch_list_running_apps:
  *
@@ -402,6 +562,22 @@ GList *     ubuntu_app_launch_get_pids                 (const gchar *
 gboolean   ubuntu_app_launch_pid_in_app_id             (GPid                              pid,
                                                          const gchar *                     appid);
 
+/**
+ * ubuntu_app_launch_get_snapshot: (skip)
+ * @n_instances: (out): Number of instances in the snapshot
+ *
+ * Gets all of the running applications and helpers at one point in
+ * time, along with their PIDs, OOM scores and states. This is much
+ * cheaper than asking for each value separately.
+ *
+ * The instances, their PIDs and their strings are all packed into a
+ * single block of memory.
+ *
+ * Return Value: An array of @n_instances instances that should be
+ *     free'd with g_free(), NULL if nothing is running or on error.
+ */
+UbuntuAppLaunchInstanceSnapshot * ubuntu_app_launch_get_snapshot (guint *                  n_instances);
+
 /**
  * ubuntu_app_launch_triplet_to_app_id:
  * @pkg: Click package name
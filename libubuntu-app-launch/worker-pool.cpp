@@ -0,0 +1,182 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "worker-pool.h"
+
+#include <glib.h>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** Pool that the current thread is a worker of, if any */
+static thread_local WorkerPool* currentPool{nullptr};
+
+WorkerPool::WorkerPool(unsigned int maxThreads, std::size_t maxQueue)
+    : maxThreads_(maxThreads)
+    , maxQueue_(maxQueue)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    shutdown();
+}
+
+/** Stops taking new work, finishes what is queued and waits for
+    all the threads to exit. */
+void WorkerPool::shutdown()
+{
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        shutdown_ = true;
+        threads.swap(threads_);
+    }
+
+    workAvailable_.notify_all();
+    spaceAvailable_.notify_all();
+
+    for (auto& thread : threads)
+    {
+        if (thread.get_id() == std::this_thread::get_id())
+        {
+            /* We're being destroyed from one of our own tasks, let the
+               loop know not to come back to us */
+            currentPool = nullptr;
+            thread.detach();
+        }
+        else
+        {
+            thread.join();
+        }
+    }
+}
+
+bool WorkerPool::onWorker()
+{
+    return currentPool == this;
+}
+
+/** Queue work to be run on one of the worker threads. If the queue is
+    full this waits for space, unless it's called from a worker in which
+    case the work is run directly so we can't deadlock. */
+void WorkerPool::post(std::function<void()> work)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+
+    if (shutdown_)
+    {
+        throw std::runtime_error("Trying to execute work on a worker pool that is shutting down.");
+    }
+
+    if (queue_.size() >= maxQueue_)
+    {
+        if (onWorker())
+        {
+            lock.unlock();
+            work();
+            return;
+        }
+
+        spaceAvailable_.wait(lock, [this] { return shutdown_ || queue_.size() < maxQueue_; });
+
+        if (shutdown_)
+        {
+            throw std::runtime_error("Trying to execute work on a worker pool that is shutting down.");
+        }
+    }
+
+    enqueue(std::move(work));
+}
+
+/** Queue work without ever waiting for space, the queue grows past its
+    limit instead. For the GLib thread, which must not block and which
+    the workers can be waiting on. */
+void WorkerPool::postNoWait(std::function<void()> work)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+
+    if (shutdown_)
+    {
+        throw std::runtime_error("Trying to execute work on a worker pool that is shutting down.");
+    }
+
+    enqueue(std::move(work));
+}
+
+/** Add work to the queue and wake or start a thread for it. Called
+    with the lock held. */
+void WorkerPool::enqueue(std::function<void()> work)
+{
+    queue_.emplace_back(std::move(work));
+
+    if (idle_ == 0 && threads_.size() < maxThreads_)
+    {
+        threads_.emplace_back([this]() { workerLoop(); });
+    }
+    else
+    {
+        workAvailable_.notify_one();
+    }
+}
+
+void WorkerPool::workerLoop()
+{
+    currentPool = this;
+
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true)
+    {
+        idle_++;
+        workAvailable_.wait(lock, [this] { return shutdown_ || !queue_.empty(); });
+        idle_--;
+
+        if (queue_.empty())
+        {
+            /* Only get here on shutdown */
+            break;
+        }
+
+        auto work = std::move(queue_.front());
+        queue_.pop_front();
+        spaceAvailable_.notify_one();
+
+        lock.unlock();
+        try
+        {
+            work();
+        }
+        catch (std::exception& e)
+        {
+            g_warning("Unhandled exception in worker thread: %s", e.what());
+        }
+
+        if (currentPool != this)
+        {
+            /* The pool was destroyed by the work */
+            return;
+        }
+        lock.lock();
+    }
+}
+
+}  // namespace app_launch
+}  // namespace ubuntu
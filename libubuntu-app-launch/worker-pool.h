@@ -0,0 +1,92 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ubuntu
+{
+namespace app_launch
+{
+
+/** A bounded set of threads for work that blocks, like synchronous
+    DBus calls, talking to snapd or reading files. This keeps that work
+    off of the GLib thread so that it can stay responsive dispatching
+    signals. Threads are only started when there is work for them. */
+class WorkerPool
+{
+public:
+    WorkerPool(unsigned int maxThreads = 4, std::size_t maxQueue = 256);
+    ~WorkerPool();
+
+    void shutdown();
+
+    void post(std::function<void()> work);
+    void postNoWait(std::function<void()> work);
+
+    template <typename T>
+    auto execute(std::function<T()> work) -> T
+    {
+        if (onWorker())
+        {
+            /* Don't wait on ourselves */
+            return work();
+        }
+
+        std::promise<T> promise;
+        post([&promise, &work]() {
+            try
+            {
+                promise.set_value(work());
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+            }
+        });
+
+        return promise.get_future().get();
+    }
+
+private:
+    unsigned int maxThreads_;
+    std::size_t maxQueue_;
+
+    std::mutex lock_;
+    std::condition_variable workAvailable_;
+    std::condition_variable spaceAvailable_;
+    std::deque<std::function<void()>> queue_;
+    std::vector<std::thread> threads_;
+    unsigned int idle_ = 0;
+    bool shutdown_ = false;
+
+    bool onWorker();
+    void enqueue(std::function<void()> work);
+    void workerLoop();
+};
+
+}  // namespace app_launch
+}  // namespace ubuntu
@@ -0,0 +1,231 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "appid.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <locale>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/* Compares the AppID parsing and string conversions with the regular
+   expression and stream based versions they replaced, which are copied
+   here. Each operation is run over a mix of valid, short, legacy and
+   invalid AppIDs. */
+
+using Clock = std::chrono::steady_clock;
+using ubuntu::app_launch::AppID;
+
+static const int iterations{20000};
+
+static const std::vector<std::string> appids{
+    "com.ubuntu.test_test_123",
+    "chatter.robert-ancell_chatter_2",
+    "container-name_test_0.0",
+    "com.test.multiple_first_1.2.3",
+    "unity8-package_foo_x123",
+    "com.test.good_application_1.2.3",
+    "com.test.good_application",
+    "gedit",
+    "not valid_at_all!",
+    "com.test_app_1_2",
+};
+
+#define REGEX_PKGNAME "([a-z0-9][a-z0-9+.-]+)"
+#define REGEX_APPNAME "([A-Za-z0-9+-.:~-][\\sA-Za-z0-9+-.:~-]+)"
+#define REGEX_VERSION "([\\d+:]?[A-Za-z0-9.+:~-]+?(?:-[A-Za-z0-9+.~]+)?)"
+
+static const std::regex full_appid_regex("^" REGEX_PKGNAME "_" REGEX_APPNAME "_" REGEX_VERSION "$");
+
+static AppID regexParse(const std::string& sappid)
+{
+    std::smatch match;
+
+    if (std::regex_match(sappid, match, full_appid_regex))
+    {
+        return {AppID::Package::from_raw(match[1].str()), AppID::AppName::from_raw(match[2].str()),
+                AppID::Version::from_raw(match[3].str())};
+    }
+    return {};
+}
+
+static bool regexValid(const std::string& sappid)
+{
+    return std::regex_match(sappid, full_appid_regex);
+}
+
+static std::string concatString(const AppID& appid)
+{
+    if (appid.package.value().empty() && appid.version.value().empty())
+    {
+        return appid.appname.value();
+    }
+
+    return appid.package.value() + "_" + appid.appname.value() + "_" + appid.version.value();
+}
+
+static std::string streamDBusID(const AppID& appid)
+{
+    std::string bytes = concatString(appid);
+    std::string encoded;
+
+    for (size_t i = 0; i < bytes.size(); ++i)
+    {
+        char chr = bytes[i];
+
+        if (std::isalpha(chr, std::locale::classic()) || (std::isdigit(chr, std::locale::classic()) && i != 0))
+        {
+            encoded += chr;
+        }
+        else
+        {
+            std::ostringstream hex;
+            hex << std::setw(2) << std::setfill('0') << std::hex;
+            hex << int(chr);
+            encoded += '_' + hex.str();
+        }
+    }
+
+    return encoded;
+}
+
+static AppID streamParseDBusID(const std::string& dbusid)
+{
+    std::string decoded;
+
+    for (size_t i = 0; i < dbusid.size(); ++i)
+    {
+        char chr = dbusid[i];
+
+        if (chr == '_' && i + 2 < dbusid.size())
+        {
+            int result;
+            std::istringstream hex(dbusid.substr(i + 1, 2));
+            hex >> std::hex >> result;
+            decoded += (char)result;
+            i += 2;
+        }
+        else
+        {
+            decoded += chr;
+        }
+    }
+
+    return regexParse(decoded);
+}
+
+struct ConcatLess
+{
+    bool operator()(const AppID& a, const AppID& b) const
+    {
+        return concatString(a) < concatString(b);
+    }
+};
+
+/** Runs the function over all the inputs for all the iterations and
+    returns the nanoseconds per call */
+template <typename Input, typename Func>
+static double timePer(const std::vector<Input>& inputs, std::size_t& sink, Func func)
+{
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        for (const auto& input : inputs)
+        {
+            sink += func(input);
+        }
+    }
+    auto total = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    return double(total) / (double(iterations) * inputs.size());
+}
+
+static void report(const std::string& name, double before, double after)
+{
+    std::cout << std::left << std::setw(14) << name << std::right << std::setw(10) << before << "ns "
+              << std::setw(10) << after << "ns" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<AppID> parsed;
+    std::vector<std::string> dbusids;
+
+    /* Make sure we agree before timing anything */
+    for (const auto& appid : appids)
+    {
+        auto expected = regexParse(appid);
+        auto result = AppID::parse(appid);
+
+        if (!(expected == result) || regexValid(appid) != AppID::valid(appid) ||
+            concatString(result) != std::string(result) || streamDBusID(result) != result.dbusID() ||
+            !(streamParseDBusID(result.dbusID()) == AppID::parseDBusID(result.dbusID())))
+        {
+            std::cerr << "New AppID functions don't match the old ones for: " << appid << std::endl;
+            return 1;
+        }
+
+        if (!result.empty())
+        {
+            parsed.emplace_back(result);
+            dbusids.emplace_back(result.dbusID());
+        }
+    }
+
+    std::size_t sink{0};
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::left << std::setw(14) << "" << std::right << std::setw(12) << "old" << std::setw(12) << "new"
+              << std::endl;
+
+    report("parse", timePer(appids, sink, [](const std::string& s) { return regexParse(s).appname.value().size(); }),
+           timePer(appids, sink, [](const std::string& s) { return AppID::parse(s).appname.value().size(); }));
+
+    report("valid", timePer(appids, sink, [](const std::string& s) { return std::size_t(regexValid(s)); }),
+           timePer(appids, sink, [](const std::string& s) { return std::size_t(AppID::valid(s)); }));
+
+    report("string", timePer(parsed, sink, [](const AppID& a) { return concatString(a).size(); }),
+           timePer(parsed, sink, [](const AppID& a) { return a.str().size(); }));
+
+    report("dbusID", timePer(parsed, sink, [](const AppID& a) { return streamDBusID(a).size(); }),
+           timePer(parsed, sink, [](const AppID& a) { return a.dbusID().size(); }));
+
+    report("parseDBusID",
+           timePer(dbusids, sink, [](const std::string& s) { return streamParseDBusID(s).appname.value().size(); }),
+           timePer(dbusids, sink, [](const std::string& s) { return AppID::parseDBusID(s).appname.value().size(); }));
+
+    /* Map lookups are where operator< gets called constantly */
+    std::map<AppID, int, ConcatLess> concatMap;
+    std::map<AppID, int> appidMap;
+    for (const auto& appid : parsed)
+    {
+        concatMap[appid] = 1;
+        appidMap[appid] = 1;
+    }
+
+    report("map lookup", timePer(parsed, sink, [&concatMap](const AppID& a) { return concatMap.count(a); }),
+           timePer(parsed, sink, [&appidMap](const AppID& a) { return appidMap.count(a); }));
+
+    /* Keep the compiler from throwing the work away */
+    return sink == 0 ? 1 : 0;
+}
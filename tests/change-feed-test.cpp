@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "change-feed.h"
+
+#include <gtest/gtest.h>
+
+using namespace ubuntu::app_launch;
+
+static Registry::Change change(const std::string& appname)
+{
+    Registry::Change change;
+    change.type = Registry::Change::Type::STARTED;
+    change.appid = AppID{AppID::Package::from_raw({}), AppID::AppName::from_raw(appname), AppID::Version::from_raw({})};
+    change.job = "application-legacy";
+    change.helper = false;
+    change.failure = Registry::FailureType::CRASH;
+    return change;
+}
+
+TEST(ChangeFeed, Sequence)
+{
+    ChangeFeed feed{4};
+    EXPECT_EQ(0u, feed.sequence());
+
+    EXPECT_EQ(1u, feed.add(change("first")));
+    EXPECT_EQ(2u, feed.add(change("second")));
+    EXPECT_EQ(3u, feed.add(change("third")));
+    EXPECT_EQ(3u, feed.sequence());
+
+    std::vector<Registry::Change> changes;
+    EXPECT_TRUE(feed.since(0, changes));
+    ASSERT_EQ(3u, changes.size());
+    EXPECT_EQ(1u, changes[0].sequence);
+    EXPECT_EQ("first", changes[0].appid.appname.value());
+    EXPECT_EQ(3u, changes[2].sequence);
+    EXPECT_EQ("third", changes[2].appid.appname.value());
+
+    changes.clear();
+    EXPECT_TRUE(feed.since(2, changes));
+    ASSERT_EQ(1u, changes.size());
+    EXPECT_EQ("third", changes[0].appid.appname.value());
+
+    /* Caught up */
+    changes.clear();
+    EXPECT_TRUE(feed.since(3, changes));
+    EXPECT_TRUE(changes.empty());
+
+    /* Not from this feed */
+    EXPECT_FALSE(feed.since(4, changes));
+}
+
+TEST(ChangeFeed, Wrap)
+{
+    ChangeFeed feed{4};
+    for (int i = 0; i < 10; i++)
+    {
+        feed.add(change(std::to_string(i)));
+    }
+
+    /* Changes 1 through 6 are gone */
+    std::vector<Registry::Change> changes;
+    EXPECT_FALSE(feed.since(0, changes));
+    EXPECT_FALSE(feed.since(5, changes));
+    EXPECT_TRUE(changes.empty());
+
+    EXPECT_TRUE(feed.since(6, changes));
+    ASSERT_EQ(4u, changes.size());
+    for (std::size_t i = 0; i < changes.size(); i++)
+    {
+        EXPECT_EQ(7 + i, changes[i].sequence);
+        EXPECT_EQ(std::to_string(6 + i), changes[i].appid.appname.value());
+    }
+}
+
+TEST(ChangeFeed, Empty)
+{
+    EXPECT_THROW(ChangeFeed{0}, std::runtime_error);
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "exec-template.h"
+
+extern "C" {
+#include "utils.h"
+}
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gio/gio.h>
+
+/* Compares parsing the Exec lines of the test desktop files on every
+   launch with desktop_exec_parse() against expanding the compiled
+   templates. */
+
+using Clock = std::chrono::steady_clock;
+
+static const int iterations{20000};
+
+static double usec(const Clock::duration& duration)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / 1000.0;
+}
+
+static std::vector<std::string> execLines()
+{
+    std::vector<std::string> retval;
+
+    auto dir = g_dir_open(CMAKE_SOURCE_DIR "/applications", 0, nullptr);
+    if (dir == nullptr)
+    {
+        return retval;
+    }
+
+    const gchar* name;
+    while ((name = g_dir_read_name(dir)) != nullptr)
+    {
+        if (!g_str_has_suffix(name, ".desktop"))
+        {
+            continue;
+        }
+
+        auto path = g_build_filename(CMAKE_SOURCE_DIR "/applications", name, nullptr);
+        auto keyfile = g_key_file_new();
+
+        if (g_key_file_load_from_file(keyfile, path, G_KEY_FILE_NONE, nullptr))
+        {
+            auto exec = g_key_file_get_string(keyfile, "Desktop Entry", "Exec", nullptr);
+            if (exec != nullptr)
+            {
+                retval.emplace_back(exec);
+                g_free(exec);
+            }
+        }
+
+        g_key_file_free(keyfile);
+        g_free(path);
+    }
+
+    g_dir_close(dir);
+    return retval;
+}
+
+/* What parseExec() used to do for each launch */
+static std::vector<std::string> parseC(const std::string& exec, const std::string& uris)
+{
+    std::vector<std::string> retval;
+
+    auto execarray = desktop_exec_parse(exec.c_str(), uris.c_str());
+    if (execarray == nullptr)
+    {
+        return retval;
+    }
+
+    for (unsigned int i = 0; i < execarray->len; i++)
+    {
+        auto cstr = g_array_index(execarray, gchar*, i);
+        if (cstr != nullptr)
+        {
+            retval.emplace_back(cstr);
+        }
+    }
+
+    auto strv = (gchar**)g_array_free(execarray, FALSE);
+    g_strfreev(strv);
+
+    return retval;
+}
+
+int main(int argc, char* argv[])
+{
+    auto lines = execLines();
+    if (lines.empty())
+    {
+        std::cerr << "No Exec lines found in " << CMAKE_SOURCE_DIR "/applications" << std::endl;
+        return 1;
+    }
+
+    const std::string uris{"'http://www.ubuntu.com' 'file:///tmp/test.txt'"};
+    const std::vector<std::string> urilist{"http://www.ubuntu.com", "file:///tmp/test.txt"};
+
+    /* Make sure we agree before timing anything */
+    for (const auto& line : lines)
+    {
+        auto expected = parseC(line, uris);
+        auto result = ubuntu::app_launch::ExecTemplate::compile(line)->expand(urilist);
+
+        if (expected != result)
+        {
+            std::cerr << "Template doesn't match desktop_exec_parse() for: " << line << std::endl;
+            return 1;
+        }
+    }
+
+    std::size_t count{0};
+
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        for (const auto& line : lines)
+        {
+            count += parseC(line, uris).size();
+        }
+    }
+    auto parseTime = Clock::now() - start;
+
+    start = Clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        for (const auto& line : lines)
+        {
+            count += ubuntu::app_launch::ExecTemplate::compile(line)->expand(urilist).size();
+        }
+    }
+    auto templateTime = Clock::now() - start;
+
+    auto launches = double(iterations) * lines.size();
+    std::cout << lines.size() << " Exec lines, " << count << " arguments" << std::endl;
+    std::cout << "desktop_exec_parse: " << usec(parseTime) / launches << "us per launch" << std::endl;
+    std::cout << "ExecTemplate:       " << usec(templateTime) / launches << "us per launch" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+
+#include "glib-thread.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+/* Microbenchmark for the GLib thread work queue. Measures how fast
+   async work can be posted and drained along with the round trip
+   latency of synchronous calls. */
+
+using Clock = std::chrono::steady_clock;
+
+static const int asyncTasks{100000};
+static const int syncCalls{10000};
+
+static double usec(const Clock::duration& duration)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / 1000.0;
+}
+
+static void printPercentiles(const std::string& name, std::vector<Clock::duration>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&samples](double pct) {
+        auto index = std::min(samples.size() - 1, std::size_t(samples.size() * pct / 100.0));
+        return usec(samples[index]);
+    };
+
+    std::cout << name << ": p50 " << percentile(50) << "us  p90 " << percentile(90) << "us  p99 " << percentile(99)
+              << "us  max " << usec(samples.back()) << "us" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    GLib::ContextThread thread;
+
+    /* Async throughput, post a burst and wait for the last one */
+    {
+        std::vector<Clock::duration> queued(asyncTasks);
+        int count = 0;
+
+        auto start = Clock::now();
+        for (int i = 0; i < asyncTasks; i++)
+        {
+            auto posted = Clock::now();
+            thread.executeOnThread([&queued, &count, i, posted]() {
+                queued[i] = Clock::now() - posted;
+                count++;
+            });
+        }
+        auto postdone = Clock::now();
+
+        thread.executeOnThread<bool>([]() { return true; });
+        auto drained = Clock::now();
+
+        std::cout << "Posted " << asyncTasks << " tasks in " << usec(postdone - start) / 1000.0 << "ms, drained in "
+                  << usec(drained - start) / 1000.0 << "ms (" << int(asyncTasks / (usec(drained - start) / 1000000.0))
+                  << " tasks/s)" << std::endl;
+
+        if (count != asyncTasks)
+        {
+            std::cerr << "Lost tasks: " << count << " of " << asyncTasks << std::endl;
+            return 1;
+        }
+
+        printPercentiles("Async time in queue", queued);
+    }
+
+    /* Sync round trip latency */
+    {
+        std::vector<Clock::duration> roundtrips;
+        roundtrips.reserve(syncCalls);
+
+        for (int i = 0; i < syncCalls; i++)
+        {
+            auto start = Clock::now();
+            thread.executeOnThread<int>([i]() { return i; });
+            roundtrips.push_back(Clock::now() - start);
+        }
+
+        printPercentiles("Sync round trip", roundtrips);
+    }
+
+    /* What the thread's own instrumentation saw */
+    {
+        auto stats = thread.stats();
+
+        std::cout << "Thread stats: " << stats.tasks << " tasks, max queue depth " << stats.maxQueueDepth << std::endl;
+        for (std::size_t i = 0; i < GLib::ContextThread::histogramBuckets; i++)
+        {
+            if (stats.queueTime[i] == 0 && stats.execTime[i] == 0)
+            {
+                continue;
+            }
+
+            if (i == GLib::ContextThread::histogramBuckets - 1)
+            {
+                std::cout << "  >= " << (1ull << (i - 1));
+            }
+            else
+            {
+                std::cout << "  < " << (1ull << i);
+            }
+            std::cout << "us: queued " << stats.queueTime[i] << ", executed "
+                      << stats.execTime[i] << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -25,6 +25,12 @@ extern "C" {
 #include "utils.h"
 }
 
+#include "glib-thread.h"
+#include "starting-handshake.h"
+
+#include <atomic>
+#include <thread>
+
 class HelperHandshakeTest : public ::testing::Test
 {
 	private:
@@ -121,3 +127,100 @@ TEST_F(HelperHandshakeTest, HandshakeTimeout)
 
 	return;
 }
+
+static bool
+wait_for (std::atomic<bool> & flag)
+{
+	for (int i = 0; i < 100 && !flag; i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return flag;
+}
+
+TEST_F(HelperHandshakeTest, PersistentHandshake)
+{
+	auto con = std::shared_ptr<GDBusConnection>(g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL), [](GDBusConnection * con) { g_clear_object(&con); });
+	GLib::ContextThread thread;
+	std::unique_ptr<ubuntu::app_launch::StartingHandshake> handshake;
+
+	std::atomic<bool> foo_started{false};
+	std::atomic<bool> bar_started{false};
+
+	/* Two launches waiting with a single subscription */
+	thread.executeOnThread<bool>([&]() {
+		handshake.reset(new ubuntu::app_launch::StartingHandshake(thread, con));
+		handshake->start("fooapp", "instance", std::chrono::seconds{10}, [&foo_started]() { foo_started = true; });
+		handshake->start("barapp", "instance", std::chrono::seconds{10}, [&bar_started]() { bar_started = true; });
+		return true;
+	});
+
+	auto reply = [&con](const gchar * appid) {
+		g_dbus_connection_emit_signal(con.get(),
+			g_dbus_connection_get_unique_name(con.get()), /* destination */
+			"/", /* path */
+			"com.canonical.UbuntuAppLaunch", /* interface */
+			"UnityStartingSignal", /* signal */
+			g_variant_new("(ss)", appid, "instance"), /* params */
+			NULL);
+	};
+
+	/* Only the app that got a reply starts */
+	reply("barapp");
+	EXPECT_TRUE(wait_for(bar_started));
+	EXPECT_FALSE(foo_started);
+
+	reply("fooapp");
+	EXPECT_TRUE(wait_for(foo_started));
+
+	EXPECT_EQ(0u, thread.executeOnThread<std::size_t>([&]() { return handshake->pending(); }));
+
+	thread.executeOnThread<bool>([&]() {
+		handshake.reset();
+		return true;
+	});
+
+	return;
+}
+
+TEST_F(HelperHandshakeTest, OldestInstanceFirst)
+{
+	auto con = std::shared_ptr<GDBusConnection>(g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL), [](GDBusConnection * con) { g_clear_object(&con); });
+	GLib::ContextThread thread;
+	std::unique_ptr<ubuntu::app_launch::StartingHandshake> handshake;
+
+	std::atomic<bool> first_started{false};
+	std::atomic<bool> second_started{false};
+
+	/* The second instance ID sorts before the first one */
+	thread.executeOnThread<bool>([&]() {
+		handshake.reset(new ubuntu::app_launch::StartingHandshake(thread, con));
+		handshake->start("fooapp", "2", std::chrono::seconds{10}, [&first_started]() { first_started = true; });
+		handshake->start("fooapp", "10", std::chrono::seconds{10}, [&second_started]() { second_started = true; });
+		return true;
+	});
+
+	auto reply = [&con]() {
+		g_dbus_connection_emit_signal(con.get(),
+			g_dbus_connection_get_unique_name(con.get()), /* destination */
+			"/", /* path */
+			"com.canonical.UbuntuAppLaunch", /* interface */
+			"UnityStartingSignal", /* signal */
+			g_variant_new("(ss)", "fooapp", ""), /* params */
+			NULL);
+	};
+
+	/* A reply without an instance starts the oldest launch */
+	reply();
+	EXPECT_TRUE(wait_for(first_started));
+	EXPECT_FALSE(second_started);
+
+	reply();
+	EXPECT_TRUE(wait_for(second_started));
+
+	EXPECT_EQ(0u, thread.executeOnThread<std::size_t>([&]() { return handshake->pending(); }));
+
+	thread.executeOnThread<bool>([&]() {
+		handshake.reset();
+		return true;
+	});
+}
@@ -21,6 +21,7 @@
 
 #include "eventually-fixture.h"
 #include "registry-mock.h"
+#include "zg-mock.h"
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -30,21 +31,44 @@ class InfoWatcherZg : public EventuallyFixture
 {
 protected:
     std::shared_ptr<DbusTestService> service;
+    std::shared_ptr<ZeitgeistMock> zgmock;
     std::shared_ptr<RegistryMock> registry;
 
     virtual void SetUp()
     {
         service = std::shared_ptr<DbusTestService>(dbus_test_service_new(nullptr),
                                                    [](DbusTestService* service) { g_clear_object(&service); });
+        zgmock = std::make_shared<ZeitgeistMock>(findEventsResult());
+        dbus_test_service_add_task(service.get(), *zgmock);
         dbus_test_service_start_tasks(service.get());
         registry = std::make_shared<RegistryMock>();
+
+        EXPECT_EVENTUALLY_FUNC_EQ(DBUS_TEST_TASK_STATE_RUNNING, zgmock->stateFunc());
+    }
+
+    /** What Zeitgeist has stored, as Python for the mock */
+    virtual std::string findEventsResult()
+    {
+        return "ret = [ ]";
     }
 
     virtual void TearDown()
     {
         registry.reset();
+        zgmock.reset();
         service.reset();
     }
+
+    /* Skip the mock and send through the real implementation */
+    void sendEvent(const ubuntu::app_launch::AppID& appid, const std::string& eventtype)
+    {
+        registry->impl->ubuntu::app_launch::Registry::Impl::zgSendEvent(appid, eventtype);
+    }
+
+    std::function<unsigned int()> insertCount()
+    {
+        return [this]() { return (unsigned int)(zgmock->insertCalls().size()); };
+    }
 };
 
 TEST_F(InfoWatcherZg, InitTest)
@@ -52,3 +76,107 @@ TEST_F(InfoWatcherZg, InitTest)
     /* Gets init by part of the mock now, we may need to split
      * that out when we want to test this more. */
 }
+
+TEST_F(InfoWatcherZg, BatchedEvents)
+{
+    auto appa = ubuntu::app_launch::AppID::parse("com.test.good_application_1.2.3");
+    auto appb = ubuntu::app_launch::AppID::parse("com.test.multiple_first_1.2.3");
+
+    /* Pause and resume of the same app cancel, the other is sent */
+    sendEvent(appa, ZEITGEIST_ZG_LEAVE_EVENT);
+    sendEvent(appa, ZEITGEIST_ZG_ACCESS_EVENT);
+    sendEvent(appb, ZEITGEIST_ZG_LEAVE_EVENT);
+    sendEvent(appb, ZEITGEIST_ZG_LEAVE_EVENT);
+
+    EXPECT_EVENTUALLY_FUNC_EQ(1u, insertCount());
+    EXPECT_EQ(3u, registry->impl->zgCoalescedEvents());
+    EXPECT_EQ(0u, registry->impl->zgDroppedEvents());
+
+    zgmock->clear();
+
+    /* A burst bigger than the queue is sent in one batch and the
+       oldest events get dropped */
+    for (int i = 0; i < 100; i++)
+    {
+        sendEvent(ubuntu::app_launch::AppID{ubuntu::app_launch::AppID::Package::from_raw({}),
+                                            ubuntu::app_launch::AppID::AppName::from_raw("app" + std::to_string(i)),
+                                            ubuntu::app_launch::AppID::Version::from_raw({})},
+                  ZEITGEIST_ZG_LEAVE_EVENT);
+    }
+
+    EXPECT_EVENTUALLY_FUNC_EQ(1u, insertCount());
+    EXPECT_LT(0u, registry->impl->zgDroppedEvents());
+}
+
+TEST_F(InfoWatcherZg, FlushOnShutdown)
+{
+    auto appid = ubuntu::app_launch::AppID::parse("com.test.good_application_1.2.3");
+
+    /* Still waiting on the batching timeout when the registry goes away */
+    sendEvent(appid, ZEITGEIST_ZG_ACCESS_EVENT);
+    registry.reset();
+
+    EXPECT_EVENTUALLY_FUNC_EQ(1u, insertCount());
+}
+
+TEST_F(InfoWatcherZg, PopularityModel)
+{
+    auto watcher = std::make_shared<ubuntu::app_launch::info_watcher::Zeitgeist>(registry->impl);
+    auto appid = ubuntu::app_launch::AppID::parse("com.test.good_application_1.2.3");
+    auto now = g_get_real_time() / 1000;
+
+    /* Ten seconds of usage */
+    watcher->eventSent(appid, ZEITGEIST_ZG_ACCESS_EVENT, now - 30000);
+    watcher->eventSent(appid, ZEITGEIST_ZG_LEAVE_EVENT, now - 20000);
+
+    EXPECT_EVENTUALLY_FUNC_EQ(10u, std::function<unsigned int()>{[watcher, appid] {
+                                  return watcher->lookupAppPopularity(appid).value();
+                              }});
+
+    /* Usage carries across versions */
+    EXPECT_EQ(10u,
+              watcher->lookupAppPopularity(ubuntu::app_launch::AppID::parse("com.test.good_application_1.2.4")).value());
+
+    /* Nothing for apps we haven't seen */
+    EXPECT_EQ(0u,
+              watcher->lookupAppPopularity(ubuntu::app_launch::AppID::parse("com.test.multiple_first_1.2.3")).value());
+}
+
+/* Zeitgeist has ten seconds of usage from before and the two events
+   that the watcher gets told about in the test */
+class InfoWatcherZgHistory : public InfoWatcherZg
+{
+protected:
+    gint64 start = g_get_real_time() / 1000 - 60000;
+
+    std::string event(gint64 timestamp, const char* eventtype)
+    {
+        return std::string{"(['1', '"} + std::to_string(timestamp) + "', '" + eventtype + "', '" +
+               ZEITGEIST_ZG_USER_ACTIVITY + "', 'application://ubuntu-app-launch.desktop', ''], " +
+               "[['application://com.test.good_application.desktop', '" + ZEITGEIST_NFO_SOFTWARE + "', '" +
+               ZEITGEIST_NFO_SOFTWARE_ITEM + "', '', 'application/x-desktop', '', '', '', '']], [])";
+    }
+
+    virtual std::string findEventsResult() override
+    {
+        /* Newest first */
+        return "ret = [ " + event(start + 40000, ZEITGEIST_ZG_LEAVE_EVENT) + ", " +
+               event(start + 30000, ZEITGEIST_ZG_ACCESS_EVENT) + ", " +
+               event(start + 10000, ZEITGEIST_ZG_LEAVE_EVENT) + ", " + event(start, ZEITGEIST_ZG_ACCESS_EVENT) +
+               " ]";
+    }
+};
+
+TEST_F(InfoWatcherZgHistory, PendingEventsInQuery)
+{
+    auto watcher = std::make_shared<ubuntu::app_launch::info_watcher::Zeitgeist>(registry->impl);
+    auto appid = ubuntu::app_launch::AppID::parse("com.test.good_application_1.2.3");
+
+    /* Sent before the initial query returns, but Zeitgeist already has them */
+    watcher->eventSent(appid, ZEITGEIST_ZG_ACCESS_EVENT, start + 30000);
+    watcher->eventSent(appid, ZEITGEIST_ZG_LEAVE_EVENT, start + 40000);
+
+    EXPECT_EVENTUALLY_FUNC_EQ(20u, std::function<unsigned int()>{[watcher, appid] {
+                                  return watcher->lookupAppPopularity(appid).value();
+                              }});
+}
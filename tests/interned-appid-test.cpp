@@ -0,0 +1,117 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "interned-appid.h"
+
+#include <gtest/gtest.h>
+#include <unordered_set>
+
+using namespace ubuntu::app_launch;
+
+TEST(InternedAppID, SameEntry)
+{
+    InternedAppID first{AppID::parse("com.test.good_application_1.2.3")};
+    InternedAppID second{AppID::parse("com.test.good_application_1.2.3")};
+    InternedAppID other{AppID::parse("com.test.good_application_1.2.4")};
+
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(first.id(), second.id());
+    EXPECT_EQ(first.hash(), second.hash());
+    EXPECT_NE(first, other);
+    EXPECT_NE(first.id(), other.id());
+    EXPECT_TRUE(first < other || other < first);
+
+    auto size = InternedAppID::tableSize();
+    InternedAppID{AppID::parse("com.test.good_application_1.2.3")};
+    EXPECT_EQ(size, InternedAppID::tableSize());
+}
+
+TEST(InternedAppID, FromString)
+{
+    auto full = InternedAppID::fromString("com.test.good_application_1.2.3");
+    EXPECT_EQ(InternedAppID{AppID::parse("com.test.good_application_1.2.3")}, full);
+    EXPECT_EQ("com.test.good_application_1.2.3", full.str());
+    EXPECT_EQ("application", full.appid().appname.value());
+
+    auto legacy = InternedAppID::fromString("gedit");
+    EXPECT_EQ("gedit", legacy.str());
+    EXPECT_EQ("gedit", legacy.appid().appname.value());
+    EXPECT_TRUE(legacy.appid().package.value().empty());
+
+    EXPECT_EQ(InternedAppID{}, InternedAppID{AppID{}});
+    EXPECT_EQ("", InternedAppID{}.str());
+}
+
+TEST(InternedAppID, SetLookup)
+{
+    std::unordered_set<InternedAppID> set;
+    set.emplace(AppID::parse("com.test.good_application_1.2.3"));
+    set.insert(InternedAppID::fromString("com.test.good_application_1.2.3"));
+    set.emplace(AppID::parse("com.test.multiple_first_1.2.3"));
+
+    EXPECT_EQ(2u, set.size());
+
+    InternedAppID found;
+    ASSERT_TRUE(InternedAppID::find("com.test.multiple_first_1.2.3", found));
+    EXPECT_NE(set.end(), set.find(found));
+    EXPECT_FALSE(InternedAppID::find("com.test.multiple_second_1.2.3", found));
+}
+
+TEST(InternedAppID, FindDoesntAdd)
+{
+    auto size = InternedAppID::tableSize();
+
+    InternedAppID found;
+    EXPECT_FALSE(InternedAppID::find("com.test.not-interned_application_1.2.3", found));
+    EXPECT_EQ(InternedAppID{}, found);
+    EXPECT_EQ(size, InternedAppID::tableSize());
+}
+
+TEST(InternedAppID, Evicted)
+{
+    auto size = InternedAppID::tableSize();
+
+    {
+        InternedAppID first{AppID::parse("com.test.evicted_application_1.2.3")};
+        EXPECT_EQ(size + 1, InternedAppID::tableSize());
+
+        InternedAppID copy = first;
+        InternedAppID found;
+        ASSERT_TRUE(InternedAppID::find("com.test.evicted_application_1.2.3", found));
+        EXPECT_EQ(first, found);
+        EXPECT_EQ(size + 1, InternedAppID::tableSize());
+
+        first = InternedAppID{};
+        copy = InternedAppID{};
+        EXPECT_EQ(size + 1, InternedAppID::tableSize());
+    }
+
+    /* Nothing refers to it anymore */
+    EXPECT_EQ(size, InternedAppID::tableSize());
+
+    InternedAppID found;
+    EXPECT_FALSE(InternedAppID::find("com.test.evicted_application_1.2.3", found));
+
+    /* The empty one stays around */
+    {
+        InternedAppID empty{AppID{}};
+    }
+    EXPECT_EQ(size, InternedAppID::tableSize());
+    EXPECT_TRUE(InternedAppID::find("", found));
+}
@@ -18,6 +18,7 @@
  */
 
 #include "appid.h"
+#include "application-impl-lazy.h"
 #include "jobs-base.h"
 
 #include "eventually-fixture.h"
@@ -226,3 +227,68 @@ TEST_F(JobBaseTest, pauseResumeMany)
         EXPECT_EQ(std::to_string(int(ubuntu::app_launch::oom::focused())), spew.oomScore());
     }
 }
+
+TEST_F(JobBaseTest, lazyApplication)
+{
+    auto store = std::make_shared<MockStore>(registry->impl);
+    registry->impl->setAppStores({store});
+
+    /* Looking at the AppID shouldn't create anything */
+    EXPECT_CALL(*store, create(testing::_)).Times(0);
+
+    auto lazy = std::make_shared<ubuntu::app_launch::app_impls::Lazy>(std::string(simpleAppID()), registry->impl);
+    EXPECT_EQ(simpleAppID(), lazy->appId());
+    EXPECT_FALSE(lazy->materialized());
+
+    testing::Mock::VerifyAndClearExpectations(store.get());
+
+    /* Using the application creates it once */
+    auto app = std::make_shared<MockApp>(simpleAppID(), registry->impl);
+    EXPECT_CALL(*app, hasInstances()).WillRepeatedly(testing::Return(true));
+    EXPECT_CALL(*store, hasAppId(simpleAppID())).WillOnce(testing::Return(true));
+    EXPECT_CALL(*store, create(simpleAppID())).WillOnce(testing::Return(app));
+
+    EXPECT_TRUE(lazy->hasInstances());
+    EXPECT_TRUE(lazy->materialized());
+    EXPECT_TRUE(lazy->hasInstances());
+}
+
+TEST_F(JobBaseTest, lazyApplicationInvalid)
+{
+    auto store = std::make_shared<MockStore>(registry->impl);
+    registry->impl->setAppStores({store});
+
+    /* A failed search isn't repeated */
+    EXPECT_CALL(*store, verifyPackage(ubuntu::app_launch::AppID::Package::from_raw("com.test.missing")))
+        .WillOnce(testing::Return(false));
+    EXPECT_CALL(*store, hasAppId(testing::_)).Times(0);
+    EXPECT_CALL(*store, create(testing::_)).Times(0);
+
+    ubuntu::app_launch::app_impls::Lazy missing{"com.test.missing_application", registry->impl};
+    EXPECT_TRUE(missing.appId().empty());
+    EXPECT_TRUE(missing.appId().empty());
+    EXPECT_FALSE(missing.valid());
+
+    testing::Mock::VerifyAndClearExpectations(store.get());
+
+    /* An AppID that parses still needs a store that has it */
+    EXPECT_CALL(*store, hasAppId(simpleAppID())).WillOnce(testing::Return(false));
+    EXPECT_CALL(*store, create(testing::_)).Times(0);
+
+    ubuntu::app_launch::app_impls::Lazy unknown{std::string(simpleAppID()), registry->impl};
+    EXPECT_FALSE(unknown.valid());
+    EXPECT_FALSE(unknown.valid());
+    EXPECT_THROW(unknown.hasInstances(), std::runtime_error);
+    EXPECT_FALSE(unknown.materialized());
+
+    testing::Mock::VerifyAndClearExpectations(store.get());
+
+    /* Using it finds out it is invalid, and remembers */
+    EXPECT_CALL(*store, hasAppId(simpleAppID())).WillOnce(testing::Return(false));
+    EXPECT_CALL(*store, create(testing::_)).Times(0);
+
+    ubuntu::app_launch::app_impls::Lazy unused{std::string(simpleAppID()), registry->impl};
+    EXPECT_THROW(unused.hasInstances(), std::runtime_error);
+    EXPECT_THROW(unused.hasInstances(), std::runtime_error);
+    EXPECT_FALSE(unused.valid());
+}
@@ -25,6 +25,7 @@
 #include "systemd-mock.h"
 
 #define CGROUP_DIR (CMAKE_BINARY_DIR "/systemd-cgroups")
+#define PROC_DIR (CMAKE_BINARY_DIR "/systemd-proc")
 
 class JobsSystemd : public EventuallyFixture
 {
@@ -41,6 +42,7 @@ protected:
 
         /* Setting the cgroup temp directory */
         g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_CGROUP_ROOT", CGROUP_DIR, TRUE);
+        g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_PROC_ROOT", PROC_DIR, TRUE);
 
         /* Force over to session bus */
         g_setenv("UBUNTU_APP_LAUNCH_SYSTEMD_PATH", "/this/should/not/exist", TRUE);
@@ -101,11 +103,17 @@ TEST_F(JobsSystemd, Init)
     registry->impl->setJobs(std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl));
 }
 
-/* Make sure we make the initial call to get signals and an initial list */
+/* Make sure we make the initial call to get signals and an initial list,
+   but only once something needs the units */
 TEST_F(JobsSystemd, Startup)
 {
     auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
     registry->impl->setJobs(manager);
+
+    pause(100);
+    EXPECT_EQ(0u, systemd->subscribeCallsCnt());
+    EXPECT_EQ(0u, systemd->listCallsCnt());
+
     manager->runningApps();
 
     EXPECT_EVENTUALLY_FUNC_EQ(true, std::function<bool()>([this]() { return systemd->subscribeCallsCnt() > 0; }));
@@ -182,6 +190,95 @@ TEST_F(JobsSystemd, PidInstance)
     EXPECT_EQ(pidlist, inst->pids());
 }
 
+/* Put a file in our fake /proc */
+void writeProc(pid_t pid, const std::string &file, const std::string &contents)
+{
+    auto dir = std::string{PROC_DIR} + "/" + std::to_string(pid);
+    g_mkdir_with_parents(dir.c_str(), 0700);
+    g_file_set_contents((dir + "/" + file).c_str(), contents.c_str(), -1, nullptr);
+}
+
+/* Find instances from the units in the cgroups of PIDs */
+TEST_F(JobsSystemd, FindInstanceByPid)
+{
+    auto slice = std::string{"/user.slice/user-1000.slice/user@1000.service/"};
+    auto multipleUnit =
+        SystemdMock::instanceName({defaultJobName(), std::string{multipleAppID()}, "1234567890", 1, {}});
+    auto singleUnit = SystemdMock::instanceName({defaultJobName(), std::string{singleAppID()}, {}, 1, {}});
+    auto unknownUnit = SystemdMock::instanceName({defaultJobName(), std::string{singleAppID()}, "5555", 1, {}});
+
+    writeProc(20, "cgroup", "4:pids:" + slice + "\n1:name=systemd:" + slice + multipleUnit + "\n");
+    writeProc(21, "cgroup", "0::" + slice + singleUnit + "/child\n");
+    writeProc(22, "cgroup", "1:name=systemd:/user.slice/user-1000.slice/session-2.scope\n");
+    writeProc(23, "cgroup", "1:name=systemd:" + slice + unknownUnit + "\n");
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    auto multiple = manager->findInstanceByPid(20);
+    ASSERT_TRUE(bool(multiple.first));
+    ASSERT_TRUE(bool(multiple.second));
+    EXPECT_EQ(multipleAppID(), multiple.first->appId());
+    EXPECT_EQ("1234567890",
+              std::dynamic_pointer_cast<ubuntu::app_launch::jobs::instance::Base>(multiple.second)->getInstanceId());
+
+    auto single = manager->findInstanceByPid(21);
+    ASSERT_TRUE(bool(single.first));
+    ASSERT_TRUE(bool(single.second));
+    EXPECT_EQ(singleAppID(), single.first->appId());
+    EXPECT_EQ(5, single.second->primaryPid());
+
+    /* Not an application unit, a unit we don't know and no PID */
+    EXPECT_FALSE(bool(manager->findInstanceByPid(22).first));
+    EXPECT_FALSE(bool(manager->findInstanceByPid(23).first));
+    EXPECT_FALSE(bool(manager->findInstanceByPid(24).first));
+
+    EXPECT_EQ("ubuntu-app-launch--application-legacy--gedit--.service",
+              manager->unitForCgroup("0::/user.slice/ubuntu-app-launch--application-legacy--gedit--.service\n"));
+    EXPECT_EQ("", manager->unitForCgroup("3:cpu:/ubuntu-app-launch--application-legacy--gedit--.service\n"));
+}
+
+/* Get everything at once */
+TEST_F(JobsSystemd, Snapshot)
+{
+    writeProc(11, "stat", "11 (multiple) T 1 11 11 0 -1\n");
+
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    auto snapshot = manager->snapshot();
+    ASSERT_TRUE(bool(snapshot));
+    ASSERT_EQ(3u, snapshot->instances.size());
+
+    for (const auto &inst : snapshot->instances)
+    {
+        EXPECT_EQ(defaultJobName(), inst.job);
+        EXPECT_FALSE(inst.helper);
+
+        if (inst.appid == singleAppID())
+        {
+            EXPECT_EQ("", inst.instanceid);
+            EXPECT_EQ(5, inst.primaryPid);
+            EXPECT_EQ((std::vector<pid_t>{1, 2, 3, 4, 5}), inst.pids);
+            EXPECT_EQ(ubuntu::app_launch::Registry::Snapshot::State::RUNNING, inst.state);
+        }
+        else if (inst.instanceid == "1234567890")
+        {
+            EXPECT_EQ(multipleAppID(), inst.appid);
+            EXPECT_EQ(11, inst.primaryPid);
+            EXPECT_EQ((std::vector<pid_t>{12, 13, 11}), inst.pids);
+            EXPECT_EQ(ubuntu::app_launch::Registry::Snapshot::State::PAUSED, inst.state);
+        }
+        else
+        {
+            EXPECT_EQ(multipleAppID(), inst.appid);
+            EXPECT_EQ("0987654321", inst.instanceid);
+            EXPECT_EQ(10, inst.primaryPid);
+            EXPECT_EQ(std::vector<pid_t>{10}, inst.pids);
+        }
+    }
+}
+
 /* Stopping a Job */
 TEST_F(JobsSystemd, StopUnit)
 {
@@ -365,6 +462,44 @@ TEST_F(JobsSystemd, SignalRemove)
     EXPECT_EVENTUALLY_FUTURE_EQ(multipleAppID(), removeunit.get_future());
 }
 
+/* Units coming and going end up in the change feed in order */
+TEST_F(JobsSystemd, ChangeFeed)
+{
+    auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
+    registry->impl->setJobs(manager);
+
+    auto start = manager->snapshot()->sequence;
+    auto feedSize = [this, start]() -> unsigned int {
+        std::vector<ubuntu::app_launch::Registry::Change> changes;
+        registry->impl->changeFeed().since(start, changes);
+        return changes.size();
+    };
+
+    systemd->managerEmitNew(
+        SystemdMock::instanceName({defaultJobName(), std::string{multipleAppID()}, "1234", 1, {}}), "/foo");
+    EXPECT_EVENTUALLY_FUNC_EQ(1u, std::function<unsigned int()>(feedSize));
+
+    systemd->managerEmitRemoved(
+        SystemdMock::instanceName({defaultJobName(), std::string{multipleAppID()}, "1234567890", 1, {}}), "/foo");
+    EXPECT_EVENTUALLY_FUNC_EQ(2u, std::function<unsigned int()>(feedSize));
+
+    std::vector<ubuntu::app_launch::Registry::Change> changes;
+    EXPECT_TRUE(registry->impl->changeFeed().since(start, changes));
+    ASSERT_EQ(2u, changes.size());
+
+    EXPECT_EQ(start + 1, changes[0].sequence);
+    EXPECT_EQ(ubuntu::app_launch::Registry::Change::Type::STARTED, changes[0].type);
+    EXPECT_EQ(multipleAppID(), changes[0].appid);
+    EXPECT_EQ(defaultJobName(), changes[0].job);
+    EXPECT_EQ("1234", changes[0].instanceid);
+    EXPECT_FALSE(changes[0].helper);
+
+    EXPECT_EQ(start + 2, changes[1].sequence);
+    EXPECT_EQ(ubuntu::app_launch::Registry::Change::Type::STOPPED, changes[1].type);
+    EXPECT_EQ(multipleAppID(), changes[1].appid);
+    EXPECT_EQ("1234567890", changes[1].instanceid);
+}
+
 TEST_F(JobsSystemd, UnitFailure)
 {
     auto manager = std::make_shared<ubuntu::app_launch::jobs::manager::SystemD>(registry->impl);
@@ -388,3 +523,20 @@ TEST_F(JobsSystemd, UnitFailure)
     EXPECT_EQ(SystemdMock::instanceName({defaultJobName(), std::string{multipleAppID()}, "1234567890", 1, {}}),
               *resets.begin());
 }
+
+/* The bus index should find our own connection without us asking about it */
+TEST_F(JobsSystemd, BusPidIndex)
+{
+    auto impl = registry->impl;
+
+    EXPECT_EVENTUALLY_FUNC_EQ(true, std::function<bool()>([impl]() {
+                                  return impl->thread.executeOnThread<bool>(
+                                      [impl]() { return impl->busPidIndex().ready(); });
+                              }));
+
+    auto connections = impl->thread.executeOnThread<std::vector<std::string>>(
+        [impl]() { return impl->busPidIndex().connections(getpid()); });
+
+    std::string ourname{g_dbus_connection_get_unique_name(impl->dbus().get())};
+    EXPECT_NE(connections.end(), std::find(connections.begin(), connections.end(), ourname));
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "launch-env.h"
+
+#include <gtest/gtest.h>
+
+using namespace ubuntu::app_launch;
+
+class LaunchEnvTest : public ::testing::Test
+{
+protected:
+    void TearDown() override
+    {
+        unsetenv("UAL_LAUNCH_ENV_TEST_A");
+        unsetenv("UAL_LAUNCH_ENV_TEST_B");
+        unsetenv("UBUNTU_APP_LAUNCH_LIBERTINE_LAUNCH");
+    }
+
+    AppID revision(const std::string& version)
+    {
+        return AppID{AppID::Package::from_raw("foo"), AppID::AppName::from_raw("foo"),
+                     AppID::Version::from_raw(version)};
+    }
+};
+
+TEST_F(LaunchEnvTest, SetAndRemove)
+{
+    LaunchEnv env{LaunchEnvCache::EnvList{{"FIRST", "1"}, {"SECOND", "2"}}};
+
+    EXPECT_EQ("1", env.get("FIRST"));
+    EXPECT_EQ("", env.get("THIRD"));
+
+    env.set("FIRST", "one");
+    env.setDefault("SECOND", "two");
+    env.setDefault("THIRD", "3");
+    env.remove("SECOND");
+
+    EXPECT_EQ("one", env.get("FIRST"));
+    EXPECT_EQ("", env.get("SECOND"));
+    EXPECT_EQ("3", env.get("THIRD"));
+}
+
+TEST_F(LaunchEnvTest, HostChanges)
+{
+    setenv("UAL_LAUNCH_ENV_TEST_A", "a", 1);
+
+    LaunchEnv first;
+    first.copyHostByPrefix("UAL_LAUNCH_ENV_TEST_");
+    EXPECT_EQ("a", first.get("UAL_LAUNCH_ENV_TEST_A"));
+    EXPECT_EQ("", first.get("UAL_LAUNCH_ENV_TEST_B"));
+
+    setenv("UAL_LAUNCH_ENV_TEST_B", "b", 1);
+    unsetenv("UAL_LAUNCH_ENV_TEST_A");
+
+    LaunchEnv second;
+    second.copyHostByPrefix("UAL_LAUNCH_ENV_TEST_");
+    EXPECT_EQ("", second.get("UAL_LAUNCH_ENV_TEST_A"));
+    EXPECT_EQ("b", second.get("UAL_LAUNCH_ENV_TEST_B"));
+}
+
+TEST_F(LaunchEnvTest, CacheInvalidate)
+{
+    LaunchEnvCache cache;
+    int builds = 0;
+    auto build = [&builds]() {
+        builds++;
+        return LaunchEnvCache::EnvList{{"APP_EXEC", "foo"}};
+    };
+
+    auto env = cache.lookup(revision("1"), build);
+    ASSERT_NE(nullptr, env);
+    EXPECT_EQ("foo", env->front().second);
+    EXPECT_EQ(env, cache.lookup(revision("1"), build));
+    EXPECT_EQ(1, builds);
+
+    /* A new revision is a new entry */
+    cache.lookup(revision("2"), build);
+    EXPECT_EQ(2, builds);
+    EXPECT_EQ(2u, cache.size());
+
+    /* Invalidating drops every revision */
+    cache.invalidate(revision("1"));
+    EXPECT_EQ(0u, cache.size());
+    cache.lookup(revision("1"), build);
+    EXPECT_EQ(3, builds);
+
+    /* Changing the helpers rebuilds */
+    setenv("UBUNTU_APP_LAUNCH_LIBERTINE_LAUNCH", "/bin/true", 1);
+    cache.lookup(revision("1"), build);
+    EXPECT_EQ(4, builds);
+
+    /* So does a different key */
+    cache.lookup(revision("1"), build, "xmir");
+    EXPECT_EQ(5, builds);
+    cache.lookup(revision("1"), build, "xmir");
+    EXPECT_EQ(5, builds);
+    cache.lookup(revision("1"), build);
+    EXPECT_EQ(6, builds);
+    EXPECT_EQ(1u, cache.size());
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include <glib.h>
+#include <stdexcept>
+#include <string>
+
+#include "string-util.h"
+
+/** A private copy of the libertine containers in the source tree, so
+    tests can change them without touching the source tree or racing the
+    other tests that read it. GLib only reads XDG_DATA_HOME and
+    XDG_CACHE_HOME once, so one copy is shared by all the tests in a
+    process. */
+class LibertineFixtures
+{
+    std::string dirname_;
+    std::string dataHome_;
+    std::string cacheHome_;
+
+public:
+    LibertineFixtures()
+    {
+        GError *error{nullptr};
+
+        auto dirname = ubuntu::app_launch::unique_gchar(g_dir_make_tmp("libertine-fixtures-XXXXXX", &error));
+        if (error != nullptr)
+        {
+            auto message = std::string{"Unable to create temporary directory: "} + error->message;
+            g_error_free(error);
+            throw std::runtime_error{message};
+        }
+        dirname_ = dirname.get();
+
+        dataHome_ = ubuntu::app_launch::unique_gchar(g_build_filename(dirname.get(), "libertine-home", nullptr)).get();
+        cacheHome_ = ubuntu::app_launch::unique_gchar(g_build_filename(dirname.get(), "libertine-data", nullptr)).get();
+
+        auto command = ubuntu::app_launch::unique_gchar(g_strdup_printf(
+            "cp -a " CMAKE_SOURCE_DIR "/libertine-home " CMAKE_SOURCE_DIR "/libertine-data %s", dirname.get()));
+        gint status = 0;
+        if (!g_spawn_command_line_sync(command.get(), nullptr, nullptr, &status, nullptr) || status != 0)
+        {
+            throw std::runtime_error{"Unable to copy the libertine fixtures to: " + dirname_};
+        }
+        g_debug("Copied libertine fixtures to: %s", dirname.get());
+    }
+
+    ~LibertineFixtures()
+    {
+        auto command = ubuntu::app_launch::unique_gchar(g_strdup_printf("rm -rf %s", dirname_.c_str()));
+        g_spawn_command_line_sync(command.get(), nullptr, nullptr, nullptr, nullptr);
+        g_debug("Removing libertine fixtures: %s", dirname_.c_str());
+    }
+
+    /** Sets XDG_DATA_HOME and XDG_CACHE_HOME to the copy */
+    void setEnv()
+    {
+        g_setenv("XDG_CACHE_HOME", cacheHome_.c_str(), TRUE);
+        g_setenv("XDG_DATA_HOME", dataHome_.c_str(), TRUE);
+    }
+
+    /** Where the containers' root filesystems are */
+    const std::string &cacheHome() const
+    {
+        return cacheHome_;
+    }
+
+    /** Where the containers' home directories and configuration are */
+    const std::string &dataHome() const
+    {
+        return dataHome_;
+    }
+};
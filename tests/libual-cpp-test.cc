@@ -26,9 +26,14 @@
 #include <gtest/gtest.h>
 #include <libdbustest/dbus-test.h>
 #include <numeric>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <thread>
+#include <unistd.h>
 #include <zeitgeist.h>
 
+#include "application-impl-libertine.h"
 #include "application.h"
 #include "glib-thread.h"
 #include "helper-impl.h"
@@ -38,6 +43,7 @@
 #include "ubuntu-app-launch.h"
 
 #include "eventually-fixture.h"
+#include "libertine-fixtures.h"
 #include "libertine-service.h"
 #include "mir-mock.h"
 #include "registry-mock.h"
@@ -148,11 +154,17 @@ protected:
         g_object_unref(monitor);
     }
 
+    /** Some tests change the libertine apps so they use a copy */
+    static LibertineFixtures& libertineFixtures()
+    {
+        static LibertineFixtures fixtures;
+        return fixtures;
+    }
+
     virtual void SetUp()
     {
         g_setenv("XDG_DATA_DIRS", CMAKE_SOURCE_DIR, TRUE);
-        g_setenv("XDG_CACHE_HOME", CMAKE_SOURCE_DIR "/libertine-data", TRUE);
-        g_setenv("XDG_DATA_HOME", CMAKE_SOURCE_DIR "/libertine-home", TRUE);
+        libertineFixtures().setEnv();
 
         g_setenv("UBUNTU_APP_LAUNCH_SNAPD_SOCKET", LOCAL_SNAPD_TEST_SOCKET, TRUE);
         g_setenv("UBUNTU_APP_LAUNCH_SNAP_BASEDIR", SNAP_BASEDIR, TRUE);
@@ -564,6 +576,76 @@ TEST_F(LibUAL, ApplicationIdLibertine)
               (std::string)ubuntu::app_launch::AppID::discover(registry, "container-name", "user-app"));
 }
 
+TEST_F(LibUAL, LibertineKeyfileReload)
+{
+    std::string desktop{libertineFixtures().dataHome() +
+                        "/libertine-container/user-data/container-name/.local/share/applications/user-app.desktop"};
+    auto appid = ubuntu::app_launch::AppID::parse("container-name_user-app_0.0");
+    auto name = [this, &appid]() {
+        return ubuntu::app_launch::Application::create(appid, registry)->info()->name().value();
+    };
+
+    gchar* coriginal = nullptr;
+    ASSERT_TRUE(g_file_get_contents(desktop.c_str(), &coriginal, nullptr, nullptr));
+    std::string original{coriginal};
+    g_free(coriginal);
+
+    struct stat origstat;
+    ASSERT_EQ(0, stat(desktop.c_str(), &origstat));
+
+    auto rewrite = [&desktop](const std::string& contents, time_t sec) {
+        g_file_set_contents(desktop.c_str(), contents.c_str(), contents.size(), nullptr);
+        struct timespec times[2] = {{sec, 0}, {sec, 0}};
+        utimensat(AT_FDCWD, desktop.c_str(), times, 0);
+    };
+
+    auto replaceName = [&original](const std::string& newname) {
+        auto contents = original;
+        contents.replace(contents.find("User App"), std::string{"User App"}.size(), newname);
+        return contents;
+    };
+
+    rewrite(original, origstat.st_mtim.tv_sec);
+    EXPECT_EQ("User App", name());
+
+    /* Same size and time, the cached one is used */
+    rewrite(replaceName("User Apq"), origstat.st_mtim.tv_sec);
+    EXPECT_EQ("User App", name());
+
+    /* New time, reloaded */
+    rewrite(replaceName("User Apq"), origstat.st_mtim.tv_sec + 10);
+    EXPECT_EQ("User Apq", name());
+
+    /* New size, reloaded */
+    rewrite(replaceName("User Application"), origstat.st_mtim.tv_sec + 10);
+    EXPECT_EQ("User Application", name());
+
+    rewrite(original, origstat.st_mtim.tv_sec);
+}
+
+TEST_F(LibUAL, LibertineNestedAdded)
+{
+    std::string desktop{libertineFixtures().cacheHome() +
+                        "/libertine-container/container-name/rootfs/usr/share/applications/nested/test-later.desktop"};
+    auto create = [this]() {
+        return std::make_shared<ubuntu::app_launch::app_impls::Libertine>(
+            ubuntu::app_launch::AppID::Package::from_raw("container-name"),
+            ubuntu::app_launch::AppID::AppName::from_raw("test-later"), registry->impl);
+    };
+
+    g_unlink(desktop.c_str());
+    EXPECT_THROW(create(), std::runtime_error);
+
+    /* Only the subdirectory changes, it still needs to be found */
+    ASSERT_TRUE(g_file_set_contents(desktop.c_str(),
+                                    "[Desktop Entry]\nName=Later\nType=Application\nExec=later\nIcon=later\n", -1,
+                                    nullptr));
+    EXPECT_NO_THROW(create());
+
+    g_unlink(desktop.c_str());
+    EXPECT_THROW(create(), std::runtime_error);
+}
+
 TEST_F(LibUAL, AppIdParse)
 {
     EXPECT_FALSE(ubuntu::app_launch::AppID::parse("com.ubuntu.test_test_123").empty());
@@ -591,6 +673,47 @@ TEST_F(LibUAL, DBusID)
     EXPECT_EQ(id, parsed);
 }
 
+TEST_F(LibUAL, AppIdValid)
+{
+    /* Edges of the package, appname and version rules */
+    EXPECT_TRUE(ubuntu::app_launch::AppID::valid("co_ap_1"));
+    EXPECT_TRUE(ubuntu::app_launch::AppID::valid("com.test+foo-bar_my app,2:~_1:2.3~rc-1+b4"));
+    EXPECT_FALSE(ubuntu::app_launch::AppID::valid("c_app_1"));
+    EXPECT_FALSE(ubuntu::app_launch::AppID::valid("Com.test_app_1"));
+    EXPECT_FALSE(ubuntu::app_launch::AppID::valid("com.test_a_1"));
+    EXPECT_FALSE(ubuntu::app_launch::AppID::valid("com.test_ app_1"));
+    EXPECT_FALSE(ubuntu::app_launch::AppID::valid("com.test_app_"));
+    EXPECT_FALSE(ubuntu::app_launch::AppID::valid("com.test_app_1 2"));
+    EXPECT_FALSE(ubuntu::app_launch::AppID::valid("com.test_app_1_2"));
+    EXPECT_FALSE(ubuntu::app_launch::AppID::valid("com.test_app"));
+    EXPECT_FALSE(ubuntu::app_launch::AppID::valid(""));
+
+    auto id = ubuntu::app_launch::AppID::parse("com.test+foo-bar_my app,2:~_1:2.3~rc-1+b4");
+    EXPECT_EQ("com.test+foo-bar", id.package.value());
+    EXPECT_EQ("my app,2:~", id.appname.value());
+    EXPECT_EQ("1:2.3~rc-1+b4", id.version.value());
+}
+
+TEST_F(LibUAL, AppIdString)
+{
+    auto id = ubuntu::app_launch::AppID::parse("com.ubuntu.test_test_123");
+    EXPECT_EQ("com.ubuntu.test_test_123", id.str());
+    EXPECT_EQ(std::string(id), id.str());
+
+    auto copy = id;
+    EXPECT_EQ(id.str(), copy.str());
+
+    copy.version = ubuntu::app_launch::AppID::Version::from_raw("124");
+    EXPECT_EQ("com.ubuntu.test_test_124", copy.str());
+    EXPECT_EQ("com.ubuntu.test_test_123", id.str());
+
+    ubuntu::app_launch::AppID legacy{ubuntu::app_launch::AppID::Package::from_raw({}),
+                                     ubuntu::app_launch::AppID::AppName::from_raw("gedit"),
+                                     ubuntu::app_launch::AppID::Version::from_raw({})};
+    EXPECT_EQ("gedit", legacy.str());
+    EXPECT_EQ("", ubuntu::app_launch::AppID{}.str());
+}
+
 TEST_F(LibUAL, PersistentID)
 {
     auto id = ubuntu::app_launch::AppID::parse("container-name_test_0.0");
@@ -624,6 +747,76 @@ TEST_F(LibUAL, ApplicationList)
     EXPECT_EQ("unity8-package_foo_x123", (std::string)apps.back()->appId());
 }
 
+TEST_F(LibUAL, SharedBackend)
+{
+    auto other = std::make_shared<ubuntu::app_launch::Registry>();
+
+    /* Both APIs get the same backend */
+    EXPECT_EQ(registry->impl, other->impl);
+    EXPECT_EQ(registry->impl, ubuntu::app_launch::Registry::getDefault()->impl);
+
+    /* Dropping one doesn't take it away from the others */
+    ubuntu::app_launch::Registry::clearDefault();
+    other.reset();
+
+    auto appid = ubuntu::app_launch::AppID::find(registry, "single");
+    auto app = ubuntu::app_launch::Application::create(appid, registry);
+    EXPECT_TRUE(app->hasInstances());
+}
+
+TEST_F(LibUAL, SharedBackendManager)
+{
+    /* The fixture's registry set the manager */
+    auto other = std::make_shared<ubuntu::app_launch::Registry>();
+    auto othermanager = std::make_shared<ManagerMock>();
+
+    EXPECT_THROW(ubuntu::app_launch::Registry::setManager(othermanager, other), std::runtime_error);
+
+    /* Only the registry that set it can clear it */
+    other->clearManager();
+    EXPECT_THROW(ubuntu::app_launch::Registry::setManager(othermanager, other), std::runtime_error);
+
+    registry->clearManager();
+    EXPECT_NO_THROW(ubuntu::app_launch::Registry::setManager(othermanager, other));
+    EXPECT_THROW(ubuntu::app_launch::Registry::setManager(manager, registry), std::runtime_error);
+
+    /* It goes away with the registry that set it */
+    other.reset();
+    EXPECT_NO_THROW(ubuntu::app_launch::Registry::setManager(manager, registry));
+
+    othermanager->quit();
+}
+
+TEST_F(LibUAL, SharedBackendSignals)
+{
+    auto other = std::make_shared<ubuntu::app_launch::Registry>();
+
+    /* Each registry hands out its own signals */
+    EXPECT_NE(&registry->changed(), &other->changed());
+    EXPECT_NE(&ubuntu::app_launch::Registry::appStarted(registry),
+              &ubuntu::app_launch::Registry::appStarted(other));
+
+    unsigned int registryCount = 0;
+    unsigned int otherCount = 0;
+    registry->changed().connect([&registryCount](const ubuntu::app_launch::Registry::Change&) { registryCount++; });
+    other->changed().connect([&otherCount](const ubuntu::app_launch::Registry::Change&) { otherCount++; });
+
+    ubuntu::app_launch::Registry::Change change{};
+    change.type = ubuntu::app_launch::Registry::Change::Type::STARTED;
+    change.appid = ubuntu::app_launch::AppID::parse("com.test.good_application_1.2.3");
+    change.job = "application-click";
+
+    registry->impl->addChange(change);
+    EXPECT_EQ(1u, registryCount);
+    EXPECT_EQ(1u, otherCount);
+
+    /* Connections made through a registry go away with it */
+    other.reset();
+    registry->impl->addChange(change);
+    EXPECT_EQ(2u, registryCount);
+    EXPECT_EQ(1u, otherCount);
+}
+
 TEST_F(LibUAL, Equality)
 {
     auto appid = ubuntu::app_launch::AppID::find(registry, "single");
@@ -877,6 +1070,108 @@ TEST_F(LibUAL, StartHelper)
     return;
 }
 
+TEST_F(LibUAL, HelperPool)
+{
+    /* Pretend we're in a snap that has an exec-tool so that the helpers
+       go through systemd-helper-helper and can be parked */
+    std::string snapdir{CMAKE_BINARY_DIR "/helper-pool-snap"};
+    std::string tooldir{snapdir + HELPER_EXEC_TOOL_DIR "/untrusted-type"};
+    g_mkdir_with_parents(tooldir.c_str(), 0700);
+    ASSERT_TRUE(g_file_set_contents((tooldir + "/exec-tool").c_str(), "#!/bin/sh\n", -1, nullptr));
+    ASSERT_EQ(0, g_chmod((tooldir + "/exec-tool").c_str(), 0700));
+    g_setenv("SNAP", snapdir.c_str(), TRUE);
+
+    auto appid = ubuntu::app_launch::AppID::parse("com.test.multiple_first_1.2.3");
+    auto untrusted = ubuntu::app_launch::Helper::Type::from_raw("untrusted-type");
+
+    storeForHelper(appid);
+
+    registry->setHelperPoolSize(untrusted, 2);
+
+    auto helper = ubuntu::app_launch::Helper::create(untrusted, appid, registry);
+    auto inst = helper->launch();
+
+    /* The one we asked for and two parked ones */
+    std::list<SystemdMock::TransientUnit> calls;
+    EXPECT_EVENTUALLY_FUNC_EQ(3u, std::function<unsigned int()>([&]() {
+                                  calls = systemd->unitCalls();
+                                  return calls.size();
+                              }));
+
+    /* In the order they went into the pool */
+    std::vector<std::string> sockets;
+    for (auto& unit : calls)
+    {
+        auto socketenv = find_env(unit.environment, "UBUNTU_APP_LAUNCH_HELPER_PARK_SOCKET");
+        if (!socketenv.empty())
+        {
+            sockets.push_back(split_env(socketenv).second);
+        }
+    }
+    ASSERT_EQ(2u, sockets.size());
+
+    /* The socket name is /ual-helper-park-<instance>-<random> */
+    auto socketInstance = [](const std::string& socket) {
+        std::string prefix{"/ual-helper-park-"};
+        return socket.substr(prefix.size(), socket.rfind('-') - prefix.size());
+    };
+    auto startingInstance = socketInstance(sockets[0]);
+    auto readyInstance = socketInstance(sockets[1]);
+
+    EXPECT_TRUE(registry->impl->helperPool.unclaimed(untrusted.value(), appid.str(), startingInstance));
+    EXPECT_TRUE(registry->impl->helperPool.unclaimed(untrusted.value(), appid.str(), readyInstance));
+
+    /* Only the second one is listening, the first is still starting */
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    ASSERT_LE(0, listener);
+    struct sockaddr_un socketaddr = {};
+    socketaddr.sun_family = AF_UNIX;
+    strncpy(socketaddr.sun_path, sockets[1].c_str(), sizeof(socketaddr.sun_path) - 1);
+    socketaddr.sun_path[0] = 0;
+    ASSERT_EQ(0, bind(listener, reinterpret_cast<const struct sockaddr*>(&socketaddr), sizeof(struct sockaddr_un)));
+    ASSERT_EQ(0, listen(listener, 1));
+
+    std::vector<ubuntu::app_launch::Helper::URL> urls{ubuntu::app_launch::Helper::URL::from_raw("http://ubuntu.com"),
+                                                      ubuntu::app_launch::Helper::URL::from_raw("file:///tmp/foo")};
+    auto claimed = helper->launch(urls);
+    ASSERT_NE(nullptr, claimed);
+
+    auto claimedImpl = std::dynamic_pointer_cast<ubuntu::app_launch::helper_impls::BaseInstance>(claimed);
+    ASSERT_NE(nullptr, claimedImpl);
+    EXPECT_EQ(readyInstance, claimedImpl->getInstanceId());
+
+    int conn = accept(listener, nullptr, nullptr);
+    ASSERT_LE(0, conn);
+    std::string message;
+    char buffer[256];
+    ssize_t len;
+    while ((len = read(conn, buffer, sizeof(buffer))) > 0)
+    {
+        message.append(buffer, len);
+    }
+    close(conn);
+    close(listener);
+
+    std::string expected{"URLS", 5};
+    for (const auto& url : urls)
+    {
+        expected.append(url.value());
+        expected.push_back('\0');
+    }
+    EXPECT_EQ(expected, message);
+
+    /* The claimed one is a helper now, the starting one is still waiting */
+    EXPECT_FALSE(registry->impl->helperPool.unclaimed(untrusted.value(), appid.str(), readyInstance));
+    EXPECT_TRUE(registry->impl->helperPool.unclaimed(untrusted.value(), appid.str(), startingInstance));
+    EXPECT_LE(1u, registry->impl->helperPool.parked(untrusted, appid));
+
+    /* Shrinking the pool lets them go */
+    registry->setHelperPoolSize(untrusted, 0);
+    EXPECT_EQ(0u, registry->impl->helperPool.parked(untrusted, appid));
+
+    g_unsetenv("SNAP");
+}
+
 TEST_F(LibUAL, StopHelper)
 {
     /* Multi helper */
@@ -1051,9 +1346,11 @@ TEST_F(LibUAL, DISABLED_PauseResume)
     EXPECT_EVENTUALLY_EQ(1u, paused_count);
     EXPECT_EQ(0u, spew.dataCnt());
 
-    /* Check to make sure we sent the event to ZG */
-    auto inserts = zgmock->insertCalls();
-    EXPECT_EQ(1u, inserts.size());
+    /* Check to make sure we sent the event to ZG, they're batched so it
+       might take a bit */
+    EXPECT_EVENTUALLY_FUNC_EQ(std::size_t(1), std::function<std::size_t()>{[zgmock] {
+                                  return zgmock->insertCalls().size();
+                              }});
 
     zgmock->clear();
 
@@ -1068,9 +1365,11 @@ TEST_F(LibUAL, DISABLED_PauseResume)
     EXPECT_EVENTUALLY_EQ(1u, resumed_count);
     EXPECT_NE(0u, spew.dataCnt());
 
-    /* Check to make sure we sent the event to ZG */
-    auto inserts2 = zgmock->insertCalls();
-    EXPECT_EQ(1u, inserts2.size());
+    /* Check to make sure we sent the event to ZG, they're batched so it
+       might take a bit */
+    EXPECT_EVENTUALLY_FUNC_EQ(std::size_t(1), std::function<std::size_t()>{[zgmock] {
+                                  return zgmock->insertCalls().size();
+                              }});
 
     zgmock->clear();
 
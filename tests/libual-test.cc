@@ -291,6 +291,53 @@ TEST_F(LibUAL, ApplicationPid)
     EXPECT_EQ(0, ubuntu_app_launch_get_primary_pid("chatter.robert-ancell_chatter_2"));
 }
 
+TEST_F(LibUAL, Snapshot)
+{
+    EXPECT_EQ(nullptr, ubuntu_app_launch_get_snapshot(nullptr));
+
+    guint count = 0;
+    auto snapshot = ubuntu_app_launch_get_snapshot(&count);
+    ASSERT_NE(nullptr, snapshot);
+    EXPECT_EQ(5u, count);
+
+    const UbuntuAppLaunchInstanceSnapshot *single = nullptr;
+    const UbuntuAppLaunchInstanceSnapshot *multiple = nullptr;
+    const UbuntuAppLaunchInstanceSnapshot *helper = nullptr;
+    for (guint i = 0; i < count; i++)
+    {
+        if (g_strcmp0(snapshot[i].appid, "single") == 0)
+            single = &snapshot[i];
+        if (g_strcmp0(snapshot[i].appid, "multiple") == 0)
+            multiple = &snapshot[i];
+        if (g_strcmp0(snapshot[i].appid, "com.bar_foo_8432.13.1") == 0)
+            helper = &snapshot[i];
+    }
+
+    ASSERT_NE(nullptr, single);
+    EXPECT_STREQ("application-legacy", single->job);
+    EXPECT_STREQ("", single->instance_id);
+    EXPECT_FALSE(single->helper);
+    EXPECT_EQ(UBUNTU_APP_LAUNCH_INSTANCE_STATE_RUNNING, single->state);
+    EXPECT_EQ(getpid(), single->primary_pid);
+    ASSERT_EQ(1u, single->n_pids);
+    EXPECT_EQ(getpid(), single->pids[0]);
+
+    ASSERT_NE(nullptr, multiple);
+    EXPECT_STREQ("2342345", multiple->instance_id);
+    EXPECT_EQ(5678, multiple->primary_pid);
+    ASSERT_EQ(3u, multiple->n_pids);
+    EXPECT_EQ(100, multiple->pids[0]);
+    EXPECT_EQ(200, multiple->pids[1]);
+    EXPECT_EQ(300, multiple->pids[2]);
+
+    ASSERT_NE(nullptr, helper);
+    EXPECT_STREQ("untrusted-helper", helper->job);
+    EXPECT_STREQ("24034582324132", helper->instance_id);
+    EXPECT_TRUE(helper->helper);
+
+    g_free(snapshot);
+}
+
 TEST_F(LibUAL, ApplicationId)
 {
     SnapdMock snapd{LOCAL_SNAPD_TEST_SOCKET,
@@ -443,6 +490,92 @@ TEST_F(LibUAL, StartStopObserver)
     ASSERT_TRUE(ubuntu_app_launch_observer_delete_app_stop(observer_cb, &stop_data));
 }
 
+TEST_F(LibUAL, FilteredStartStopObserver)
+{
+    observer_data_t start_data = {.count = 0, .name = nullptr};
+    observer_data_t stop_data = {.count = 0, .name = nullptr};
+    observer_data_t package_data = {.count = 0, .name = nullptr};
+
+    ASSERT_TRUE(ubuntu_app_launch_observer_add_app_started_filtered(observer_cb, "foo", &start_data));
+    ASSERT_TRUE(ubuntu_app_launch_observer_add_app_stop_filtered(observer_cb, "foo", &stop_data));
+    ASSERT_TRUE(
+        ubuntu_app_launch_observer_add_app_started_filtered(observer_cb, "com.test.good", &package_data));
+
+    /* Noise that shouldn't match */
+    systemd->managerEmitNew(SystemdMock::instanceName({"application-legacy", "foobar", {}, 0, {}}), "/foo");
+    systemd->managerEmitRemoved(SystemdMock::instanceName({"application-legacy", "foobar", {}, 0, {}}), "/foo");
+    systemd->managerEmitNew(SystemdMock::instanceName({"application-legacy", "elephant", {}, 0, {}}), "/foo");
+    systemd->managerEmitNew(SystemdMock::instanceName({"application-snap", "com.test.goodbye_app_1", {}, 0, {}}),
+                            "/foo");
+
+    /* The ones we're looking for */
+    systemd->managerEmitNew(SystemdMock::instanceName({"application-legacy", "foo", {}, 0, {}}), "/foo");
+    systemd->managerEmitRemoved(SystemdMock::instanceName({"application-legacy", "foo", {}, 0, {}}), "/foo");
+    systemd->managerEmitNew(
+        SystemdMock::instanceName({"application-snap", "com.test.good_application_1.2.3", {}, 0, {}}), "/foo");
+
+    EXPECT_EVENTUALLY_EQ(1, package_data.count);
+    EXPECT_EQ(1, start_data.count);
+    EXPECT_EQ(1, stop_data.count);
+
+    /* Filters are part of the key */
+    EXPECT_FALSE(ubuntu_app_launch_observer_delete_app_started_filtered(observer_cb, "bar", &start_data));
+
+    ASSERT_TRUE(ubuntu_app_launch_observer_delete_app_started_filtered(observer_cb, "foo", &start_data));
+    ASSERT_TRUE(ubuntu_app_launch_observer_delete_app_stop_filtered(observer_cb, "foo", &stop_data));
+    ASSERT_TRUE(
+        ubuntu_app_launch_observer_delete_app_started_filtered(observer_cb, "com.test.good", &package_data));
+
+    /* Removed observers don't get called */
+    systemd->managerEmitNew(SystemdMock::instanceName({"application-legacy", "foo", {}, 0, {}}), "/foo");
+    pause(100);
+    EXPECT_EQ(1, start_data.count);
+}
+
+static void paused_observer_cb(const gchar *appid, GPid *pids, gpointer user_data)
+{
+    observer_data_t *data = (observer_data_t *)user_data;
+    g_debug("Paused observer called for: %s", appid);
+
+    if (g_strcmp0(data->name, appid) == 0 && pids[0] == 100 && pids[1] == 0)
+    {
+        data->count++;
+    }
+}
+
+TEST_F(LibUAL, FilteredPausedObserver)
+{
+    observer_data_t paused_data = {.count = 0, .name = "com.test.good_application_1.2.3"};
+    observer_data_t resumed_data = {.count = 0, .name = "com.test.good_application_1.2.3"};
+
+    ASSERT_TRUE(ubuntu_app_launch_observer_add_app_paused_filtered(paused_observer_cb,
+                                                                   "com.test.good_application_1.2.3", &paused_data));
+    ASSERT_TRUE(ubuntu_app_launch_observer_add_app_resumed_filtered(paused_observer_cb, "com.test.good",
+                                                                    &resumed_data));
+
+    auto emit = [this](const gchar *signal, const gchar *appid) {
+        guint64 pid = 100;
+        g_dbus_connection_emit_signal(
+            bus, nullptr, "/", "com.canonical.UbuntuAppLaunch", signal,
+            g_variant_new("(ss@at)", appid, "",
+                          g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64, &pid, 1, sizeof(guint64))),
+            nullptr);
+    };
+
+    emit("ApplicationPaused", "com.test.good_other_1.2.3");
+    emit("ApplicationResumed", "com.test.goodbye_application_1.2.3");
+    emit("ApplicationPaused", "com.test.good_application_1.2.3");
+    emit("ApplicationResumed", "com.test.good_application_1.2.3");
+
+    EXPECT_EVENTUALLY_EQ(1, paused_data.count);
+    EXPECT_EVENTUALLY_EQ(1, resumed_data.count);
+
+    ASSERT_TRUE(ubuntu_app_launch_observer_delete_app_paused_filtered(
+        paused_observer_cb, "com.test.good_application_1.2.3", &paused_data));
+    ASSERT_TRUE(
+        ubuntu_app_launch_observer_delete_app_resumed_filtered(paused_observer_cb, "com.test.good", &resumed_data));
+}
+
 static GDBusMessage *filter_starting(GDBusConnection *conn,
                                      GDBusMessage *message,
                                      gboolean incomming,
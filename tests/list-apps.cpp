@@ -20,9 +20,12 @@
 #include <gio/gio.h>
 #include <glib/gstdio.h>
 #include <gtest/gtest.h>
+#include <mutex>
 #include <numeric>
+#include <set>
 
 #include "eventually-fixture.h"
+#include "libertine-fixtures.h"
 #include "libertine-service.h"
 
 #include "app-store-legacy.h"
@@ -31,6 +34,7 @@
 #include "application-impl-snap.h"
 #include "application.h"
 #include "registry.h"
+#include "string-util.h"
 
 #include "snapd-mock.h"
 #define SNAPD_LIST_APPS_SOCKET SNAPD_TEST_SOCKET "-list-apps"
@@ -48,8 +52,7 @@ protected:
         g_unlink(SNAPD_LIST_APPS_SOCKET);
 
         g_setenv("XDG_DATA_DIRS", CMAKE_SOURCE_DIR, TRUE);
-        g_setenv("XDG_CACHE_HOME", CMAKE_SOURCE_DIR "/libertine-data", TRUE);
-        g_setenv("XDG_DATA_HOME", CMAKE_SOURCE_DIR "/libertine-home", TRUE);
+        libertineFixtures().setEnv();
 
         g_setenv("UBUNTU_APP_LAUNCH_SNAPD_SOCKET", SNAPD_LIST_APPS_SOCKET, TRUE);
         g_setenv("UBUNTU_APP_LAUNCH_SNAP_BASEDIR", SNAP_BASEDIR, TRUE);
@@ -69,6 +72,13 @@ protected:
         ASSERT_EVENTUALLY_FUNC_EQ(false, std::function<bool()>{[&] { return libertine->getUniqueName().empty(); }});
     }
 
+    /** Some tests add apps to the containers so they use a copy */
+    static LibertineFixtures& libertineFixtures()
+    {
+        static LibertineFixtures fixtures;
+        return fixtures;
+    }
+
     virtual void TearDown()
     {
         g_unlink(SNAPD_LIST_APPS_SOCKET);
@@ -166,6 +176,58 @@ TEST_F(ListApps, ListLibertine)
     EXPECT_TRUE(findApp(apps, "container-name_user-app_0.0"));
 }
 
+TEST_F(ListApps, LibertineContainerChanged)
+{
+    std::string added{libertineFixtures().cacheHome() +
+                      "/libertine-container/container-name/rootfs/usr/share/applications/added"};
+    auto removeAdded = [&added]() {
+        g_unlink((added + "/test-added.desktop").c_str());
+        g_rmdir(added.c_str());
+    };
+    removeAdded();
+
+    auto registry = std::make_shared<ubuntu::app_launch::Registry>();
+    ubuntu::app_launch::app_store::Libertine store(registry->impl);
+    EXPECT_EQ(3, int(store.list().size()));
+
+    /* The changes get signaled so the registry drops what it cached */
+    std::mutex signaled_lock;
+    std::set<std::string> added_apps;
+    std::set<std::string> removed_apps;
+    store.appAdded().connect(
+        [&signaled_lock, &added_apps](const std::shared_ptr<ubuntu::app_launch::Application>& app) {
+            std::lock_guard<std::mutex> lock(signaled_lock);
+            added_apps.insert(app->appId());
+        });
+    store.appRemoved().connect([&signaled_lock, &removed_apps](const ubuntu::app_launch::AppID& appid) {
+        std::lock_guard<std::mutex> lock(signaled_lock);
+        removed_apps.insert(appid);
+    });
+
+    /* A new directory gets watched, so an app put in it after the
+       list is cached again still shows up */
+    ASSERT_EQ(0, g_mkdir(added.c_str(), 0700));
+    pause(100);
+    EXPECT_EQ(3, int(store.list().size()));
+
+    ASSERT_TRUE(g_file_set_contents((added + "/test-added.desktop").c_str(),
+                                    "[Desktop Entry]\nName=Added\nType=Application\nExec=added\nIcon=added\n", -1,
+                                    nullptr));
+    EXPECT_EVENTUALLY_FUNC_EQ(4, std::function<int()>([&store]() { return int(store.list().size()); }));
+    EXPECT_EVENTUALLY_FUNC_EQ(true, std::function<bool()>([&signaled_lock, &added_apps]() {
+                                  std::lock_guard<std::mutex> lock(signaled_lock);
+                                  return added_apps.count("container-name_test-added_0.0") == 1;
+                              }));
+
+    /* And it goes away again */
+    removeAdded();
+    EXPECT_EVENTUALLY_FUNC_EQ(3, std::function<int()>([&store]() { return int(store.list().size()); }));
+    EXPECT_EVENTUALLY_FUNC_EQ(true, std::function<bool()>([&signaled_lock, &removed_apps]() {
+                                  std::lock_guard<std::mutex> lock(signaled_lock);
+                                  return removed_apps.count("container-name_test-added_0.0") == 1;
+                              }));
+}
+
 static std::pair<std::string, std::string> interfaces{
     "GET /v2/interfaces HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
     SnapdMock::httpJsonResponse(
@@ -0,0 +1,298 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include "second-exec-core.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gio/gio.h>
+#include <libdbustest/dbus-test.h>
+#include <unistd.h>
+
+/* Benchmark for handing URLs to an application that is already running.
+   Runs a private session bus with a helper process holding a number of
+   peer connections, and a number of application connections in this
+   process that answer Open. We then drive second_exec() and time how long
+   it takes to ask Unity to resume, to deliver Open to the application
+   and to ask Unity for focus.
+
+   Each launch is done twice: once letting second_exec() find the
+   connections by asking the bus about every peer, and once passing in
+   the connections like the registry's bus index does. The difference
+   in the Open times is the cost of finding the application's PID.
+
+   Usage: second-exec-benchmark [peers] [apps] [iterations]
+
+   The applications all share our PID so every Open is sent to all of
+   them, and the ones that don't own the path reply with an error. */
+
+using Clock = std::chrono::steady_clock;
+
+static const char* peersName{"com.canonical.UbuntuAppLaunch.BenchmarkPeers"};
+
+static const char* applicationXml{
+    "<node>"
+    "  <interface name='org.freedesktop.Application'>"
+    "    <method name='Open'>"
+    "      <arg type='as' name='uris' direction='in'/>"
+    "      <arg type='a{sv}' name='platform-data' direction='in'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>"};
+
+static double usec(const Clock::duration& duration)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / 1000.0;
+}
+
+static void printPercentiles(const std::string& name, std::vector<Clock::duration>& samples)
+{
+    if (samples.empty())
+    {
+        std::cout << name << ": no samples" << std::endl;
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&samples](double pct) {
+        auto index = std::min(samples.size() - 1, std::size_t(samples.size() * pct / 100.0));
+        return usec(samples[index]);
+    };
+
+    std::cout << name << ": p50 " << percentile(50) << "us  p90 " << percentile(90) << "us  p99 " << percentile(99)
+              << "us  max " << usec(samples.back()) << "us" << std::endl;
+}
+
+static GDBusConnection* newConnection()
+{
+    GError* error{nullptr};
+    auto address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, nullptr, &error);
+    if (error != nullptr)
+    {
+        std::cerr << "Unable to get session bus address: " << error->message << std::endl;
+        g_error_free(error);
+        exit(1);
+    }
+
+    auto con = g_dbus_connection_new_for_address_sync(
+        address,
+        GDBusConnectionFlags(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                             G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr, nullptr, &error);
+    g_free(address);
+
+    if (error != nullptr)
+    {
+        std::cerr << "Unable to connect to session bus: " << error->message << std::endl;
+        g_error_free(error);
+        exit(1);
+    }
+
+    return con;
+}
+
+/* Run as a child on the test bus, opens all the peer connections and then
+   takes a name so the benchmark knows we're ready */
+static int peerProcess(int peers)
+{
+    std::vector<GDBusConnection*> connections;
+    for (int i = 0; i < peers; i++)
+    {
+        connections.push_back(newConnection());
+    }
+
+    auto loop = g_main_loop_new(nullptr, FALSE);
+    g_bus_own_name_on_connection(connections.empty() ? g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, nullptr)
+                                                     : connections[0],
+                                 peersName, G_BUS_NAME_OWNER_FLAGS_NONE, nullptr, nullptr, nullptr, nullptr);
+    g_main_loop_run(loop);
+
+    return 0;
+}
+
+/** What we've seen for the launch that is running */
+struct Launch
+{
+    std::string appid;
+    Clock::time_point start;
+    Clock::time_point resume;
+    Clock::time_point open;
+    Clock::time_point focus;
+    bool opened = false;
+    bool focused = false;
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc == 3 && std::string{argv[1]} == "--peers")
+    {
+        return peerProcess(atoi(argv[2]));
+    }
+
+    int peers = argc > 1 ? atoi(argv[1]) : 200;
+    int apps = argc > 2 ? atoi(argv[2]) : 1;
+    int iterations = argc > 3 ? atoi(argv[3]) : 100;
+    if (peers < 0 || apps < 1 || iterations < 1)
+    {
+        std::cerr << "Usage: " << argv[0] << " [peers] [apps] [iterations]" << std::endl;
+        return 1;
+    }
+
+    auto service = dbus_test_service_new(nullptr);
+
+    auto peerproc = dbus_test_process_new(argv[0]);
+    dbus_test_process_append_param(peerproc, "--peers");
+    dbus_test_process_append_param(peerproc, std::to_string(peers).c_str());
+    dbus_test_task_set_name(DBUS_TEST_TASK(peerproc), "Peers");
+    dbus_test_task_set_return(DBUS_TEST_TASK(peerproc), DBUS_TEST_TASK_RETURN_IGNORE);
+    dbus_test_task_set_wait_finished(DBUS_TEST_TASK(peerproc), FALSE);
+    dbus_test_service_add_task(service, DBUS_TEST_TASK(peerproc));
+
+    dbus_test_service_start_tasks(service);
+
+    auto bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, nullptr);
+    g_dbus_connection_set_exit_on_close(bus, FALSE);
+
+    /* Wait for the peers to all be connected */
+    bool peersReady = false;
+    auto peerswatch = g_bus_watch_name_on_connection(
+        bus, peersName, G_BUS_NAME_WATCHER_FLAGS_NONE,
+        [](GDBusConnection*, const gchar*, const gchar*, gpointer user_data) { *static_cast<bool*>(user_data) = true; },
+        nullptr, &peersReady, nullptr);
+    while (!peersReady)
+    {
+        g_main_context_iteration(nullptr, TRUE);
+    }
+    g_bus_unwatch_name(peerswatch);
+
+    Launch launch;
+
+    /* Application connections answering Open on their own paths */
+    auto nodeinfo = g_dbus_node_info_new_for_xml(applicationXml, nullptr);
+    GDBusInterfaceVTable vtable{
+        [](GDBusConnection*, const gchar*, const gchar*, const gchar*, const gchar*, GVariant*,
+           GDBusMethodInvocation* invocation, gpointer user_data) {
+            auto launch = static_cast<Launch*>(user_data);
+            if (!launch->opened)
+            {
+                launch->open = Clock::now();
+                launch->opened = true;
+            }
+            g_dbus_method_invocation_return_value(invocation, nullptr);
+        },
+        nullptr, nullptr};
+
+    std::vector<GDBusConnection*> appcons;
+    std::vector<std::string> appids;
+    for (int i = 0; i < apps; i++)
+    {
+        auto appid = std::string{"benchmark"} + std::to_string(i);
+        auto con = newConnection();
+        g_dbus_connection_register_object(con, ("/" + appid).c_str(), nodeinfo->interfaces[0], &vtable, &launch,
+                                          nullptr, nullptr);
+        appcons.push_back(con);
+        appids.push_back(appid);
+    }
+
+    /* What the bus index would give us for our PID */
+    std::vector<const gchar*> known;
+    known.push_back(g_dbus_connection_get_unique_name(bus));
+    for (const auto& con : appcons)
+    {
+        known.push_back(g_dbus_connection_get_unique_name(con));
+    }
+    known.push_back(nullptr);
+
+    /* Play Unity, resume right away and note when we're asked for focus */
+    auto resumesub = g_dbus_connection_signal_subscribe(
+        bus, nullptr, "com.canonical.UbuntuAppLaunch", "UnityResumeRequest", "/", nullptr, G_DBUS_SIGNAL_FLAGS_NONE,
+        [](GDBusConnection* con, const gchar* sender, const gchar*, const gchar*, const gchar*, GVariant* params,
+           gpointer user_data) {
+            auto launch = static_cast<Launch*>(user_data);
+            launch->resume = Clock::now();
+            g_dbus_connection_emit_signal(con, sender, "/", "com.canonical.UbuntuAppLaunch", "UnityResumeResponse",
+                                          params, nullptr);
+        },
+        &launch, nullptr);
+    auto focussub = g_dbus_connection_signal_subscribe(
+        bus, nullptr, "com.canonical.UbuntuAppLaunch", "UnityFocusRequest", "/", nullptr, G_DBUS_SIGNAL_FLAGS_NONE,
+        [](GDBusConnection*, const gchar*, const gchar*, const gchar*, const gchar*, GVariant*, gpointer user_data) {
+            auto launch = static_cast<Launch*>(user_data);
+            launch->focus = Clock::now();
+            launch->focused = true;
+        },
+        &launch, nullptr);
+
+    gchar* uris[] = {const_cast<gchar*>("http://ubuntu.com"), nullptr};
+
+    std::cout << "Second exec with " << peers << " peers and " << apps << " applications, " << iterations
+              << " launches" << std::endl;
+
+    for (const auto& mode : {"Scanning the bus", "Known connections"})
+    {
+        std::vector<Clock::duration> resume, open, focus;
+        bool scan = std::string{mode} == "Scanning the bus";
+
+        for (int i = 0; i < iterations; i++)
+        {
+            launch = Launch{};
+            launch.appid = appids[i % apps];
+            launch.start = Clock::now();
+
+            second_exec(bus, nullptr, getpid(), launch.appid.c_str(), "", uris, scan ? nullptr : known.data());
+
+            while (!launch.focused)
+            {
+                g_main_context_iteration(nullptr, TRUE);
+            }
+
+            resume.push_back(launch.resume - launch.start);
+            if (launch.opened)
+            {
+                open.push_back(launch.open - launch.start);
+            }
+            focus.push_back(launch.focus - launch.start);
+        }
+
+        std::cout << mode << ":" << std::endl;
+        printPercentiles("  Resume requested", resume);
+        printPercentiles("  Open delivered", open);
+        printPercentiles("  Focus requested", focus);
+    }
+
+    g_dbus_connection_signal_unsubscribe(bus, resumesub);
+    g_dbus_connection_signal_unsubscribe(bus, focussub);
+    for (auto con : appcons)
+    {
+        g_dbus_connection_close_sync(con, nullptr, nullptr);
+        g_object_unref(con);
+    }
+    g_dbus_node_info_unref(nodeinfo);
+    g_object_unref(bus);
+    g_object_unref(peerproc);
+    g_object_unref(service);
+
+    return 0;
+}
@@ -67,6 +67,24 @@ TEST_F(SnapdInfo, PackageInfo)
     EXPECT_NE(pkginfo->appnames.end(), pkginfo->appnames.find("bar"));
 }
 
+TEST_F(SnapdInfo, SocketAfterInit)
+{
+    /* The registry backend can be built before snapd is running */
+    auto info = std::make_shared<ubuntu::app_launch::snapd::Info>();
+
+    SnapdMock mock{LOCAL_SNAPD_TEST_SOCKET,
+                   {{"GET /v2/snaps/test-package HTTP/1.1\r\nHost: snapd\r\nAccept: */*\r\n\r\n",
+                     SnapdMock::httpJsonResponse(SnapdMock::snapdOkay(SnapdMock::packageJson(
+                         "test-package", "active", "app", "1.2.3.4", "x123", {"foo", "bar"})))}}};
+
+    auto pkginfo = info->pkgInfo(ubuntu::app_launch::AppID::Package::from_raw("test-package"));
+
+    mock.result();
+
+    ASSERT_NE(nullptr, pkginfo);
+    EXPECT_EQ("test-package", pkginfo->name);
+}
+
 TEST_F(SnapdInfo, AppsForInterface)
 {
     SnapdMock mock{LOCAL_SNAPD_TEST_SOCKET,
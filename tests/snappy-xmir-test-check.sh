@@ -27,6 +27,11 @@ if [ ! -z ${MIR_SOCKET} ] ; then
 	exit 1
 fi
 
+if [ ! -z ${SNAPPY_XMIR_TEST_GDK_BACKEND_SIZE} ] && [ ${#GDK_BACKEND} != ${SNAPPY_XMIR_TEST_GDK_BACKEND_SIZE} ] ; then
+	echo GDK_BACKEND was not passed whole
+	exit 1
+fi
+
 if [ ! -z ${UBUNTU_APP_LAUNCH_SNAPPY_XMIR_ENVVARS_PID} ] ; then
 	kill -TERM ${UBUNTU_APP_LAUNCH_SNAPPY_XMIR_ENVVARS_PID}
 fi
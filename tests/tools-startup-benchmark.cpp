@@ -0,0 +1,173 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Startup time of the command line tools. Each one is run a number of
+   times and we record when its first output shows up, which is when the
+   user gets their first result, and when it exits. Tools that only look
+   at installed applications shouldn't be waiting on the buses or the
+   list of running units.
+
+   Usage: tools-startup-benchmark [runs] */
+
+using Clock = std::chrono::steady_clock;
+
+struct Sample
+{
+    Clock::duration firstResult;
+    Clock::duration exit;
+};
+
+static double msec(const Clock::duration& duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000.0;
+}
+
+static void printResults(const std::string& name, std::vector<Clock::duration> samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&samples](double pct) {
+        auto index = std::min(samples.size() - 1, std::size_t(samples.size() * pct / 100.0));
+        return msec(samples[index]);
+    };
+
+    std::cout << name << ": p50 " << percentile(50) << "ms  p90 " << percentile(90) << "ms  max "
+              << msec(samples.back()) << "ms" << std::endl;
+}
+
+/* Runs the tool and times its first output and its exit */
+static Sample run(const std::vector<std::string>& command)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        throw std::runtime_error{"Unable to create pipe"};
+    }
+
+    std::vector<char*> argv;
+    for (const auto& arg : command)
+    {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    auto start = Clock::now();
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+
+        execv(argv[0], argv.data());
+        _exit(EXIT_FAILURE);
+    }
+    close(fds[1]);
+
+    Sample sample;
+    bool first{true};
+    char buffer[4096];
+    ssize_t thisread;
+    while ((thisread = read(fds[0], buffer, sizeof(buffer))) > 0)
+    {
+        if (first)
+        {
+            sample.firstResult = Clock::now() - start;
+            first = false;
+        }
+    }
+    close(fds[0]);
+
+    int status{0};
+    waitpid(pid, &status, 0);
+    sample.exit = Clock::now() - start;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+    {
+        throw std::runtime_error{"Tool failed: " + command[0]};
+    }
+
+    if (first)
+    {
+        sample.firstResult = sample.exit;
+    }
+
+    return sample;
+}
+
+static void benchmark(const std::vector<std::string>& command, int runs)
+{
+    std::vector<Clock::duration> firstResults;
+    std::vector<Clock::duration> exits;
+
+    for (int i = 0; i < runs; i++)
+    {
+        auto sample = run(command);
+        firstResults.emplace_back(sample.firstResult);
+        exits.emplace_back(sample.exit);
+    }
+
+    std::cout << command[0].substr(command[0].rfind('/') + 1) << std::endl;
+    printResults("  First result", firstResults);
+    printResults("  Exit", exits);
+}
+
+int main(int argc, char* argv[])
+{
+    int runs = argc > 1 ? std::atoi(argv[1]) : 20;
+    if (runs <= 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [runs]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::vector<std::vector<std::string>> commands{
+        {TOOLS_DIR "/ubuntu-app-triplet", "gedit"}, /* Installed applications only */
+        {TOOLS_DIR "/ubuntu-app-launch-appids"},    /* Installed applications only */
+        {TOOLS_DIR "/ubuntu-app-list"},             /* Needs the running units */
+    };
+
+    try
+    {
+        std::cout << runs << " runs each" << std::endl;
+        for (const auto& command : commands)
+        {
+            benchmark(command, runs);
+        }
+    }
+    catch (std::runtime_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,23 @@
+#!/bin/bash
+
+if [ $1 != "-displayfd" ]; then
+	echo "-displayfd missing"
+	exit 1
+fi
+
+if [ $3 != "-mir" ]; then
+	echo "-mir missing"
+	exit 1
+fi
+
+# Don't hold onto the output of the test
+exec > /dev/null
+
+# Take as long as we're told to start up
+sleep ${XMIR_MOCK_STARTUP:-0}
+
+echo "${XMIR_MOCK_DISPLAY:-42}" >&$2
+
+# Stick around like a real XMir, the pool or the
+# application's unit cleans us up
+exec sleep 10
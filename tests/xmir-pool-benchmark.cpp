@@ -0,0 +1,190 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranties of
+ * MERCHANTABILITY, SATISFACTORY QUALITY, or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Ted Gould <ted.gould@canonical.com>
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <limits.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Time to first window for X11 applications started through xmir-helper,
+   with and without the XMir pool. The mock XMir takes a configurable time
+   to come up, like a real one loading and connecting to Mir, and the
+   application is this binary again which reports the time it got control
+   with a DISPLAY to connect to.
+
+   The first launch with the pool starts the pool, so it isn't counted.
+   Every launch is followed by the same pause so the pool has time to
+   start a replacement server.
+
+   Usage: xmir-pool-benchmark [launches] [XMir startup seconds] */
+
+using Clock = std::chrono::steady_clock;
+
+static const char* appId{"com.test.xmirpool_benchmark_1.2.3"};
+
+static double msec(const Clock::duration& duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000.0;
+}
+
+static void printResults(const std::string& name, std::vector<Clock::duration>& samples)
+{
+    if (samples.empty())
+    {
+        std::cout << name << ": no samples" << std::endl;
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&samples](double pct) {
+        auto index = std::min(samples.size() - 1, std::size_t(samples.size() * pct / 100.0));
+        return msec(samples[index]);
+    };
+
+    std::cout << name << ": p50 " << percentile(50) << "ms  p90 " << percentile(90) << "ms  max "
+              << msec(samples.back()) << "ms" << std::endl;
+}
+
+/* Application side, tell the benchmark when we got started */
+static int firstWindow()
+{
+    if (getenv("DISPLAY") == nullptr)
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::cout << std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count()
+              << std::endl;
+    return EXIT_SUCCESS;
+}
+
+/* Runs xmir-helper and returns the time until the application had a DISPLAY */
+static Clock::duration launch(const std::string& self)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        throw std::runtime_error{"Unable to create pipe"};
+    }
+
+    auto start = Clock::now();
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        setpgid(0, 0);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+
+        execl(XMIR_HELPER_UTILITY, XMIR_HELPER_UTILITY, appId, self.c_str(), "--first-window", nullptr);
+        _exit(EXIT_FAILURE);
+    }
+    close(fds[1]);
+
+    std::string output;
+    char buffer[64];
+    ssize_t thisread;
+    while (output.find('\n') == std::string::npos && (thisread = read(fds[0], buffer, sizeof(buffer))) > 0)
+    {
+        output.append(buffer, thisread);
+    }
+    close(fds[0]);
+
+    int status{0};
+    waitpid(pid, &status, 0);
+
+    /* Our own XMir stays around until its unit would be stopped */
+    kill(-pid, SIGTERM);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS || output.empty())
+    {
+        throw std::runtime_error{"Application didn't start"};
+    }
+
+    return Clock::time_point{std::chrono::nanoseconds{std::stoll(output)}} - start;
+}
+
+static std::vector<Clock::duration> launches(const std::string& self, int count, const Clock::duration& pause)
+{
+    std::vector<Clock::duration> samples;
+
+    for (int i = 0; i < count; i++)
+    {
+        samples.emplace_back(launch(self));
+        std::this_thread::sleep_for(pause);
+    }
+
+    return samples;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc == 2 && std::string{argv[1]} == "--first-window")
+    {
+        return firstWindow();
+    }
+
+    int count = argc > 1 ? std::atoi(argv[1]) : 20;
+    double startup = argc > 2 ? std::atof(argv[2]) : 0.3;
+
+    char self[PATH_MAX] = {0};
+    if (readlink("/proc/self/exe", self, sizeof(self) - 1) <= 0)
+    {
+        std::cerr << "Unable to find our own binary" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    setenv("UBUNTU_APP_LAUNCH_XMIR_PATH", CMAKE_SOURCE_DIR "/xmir-mock-pool.sh", 1);
+    setenv("XMIR_MOCK_STARTUP", std::to_string(startup).c_str(), 1);
+    setenv("UBUNTU_APP_LAUNCH_XMIR_POOL_TIMEOUT", "2", 1);
+
+    auto pause = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>{startup * 2 + 0.1});
+
+    try
+    {
+        unsetenv("UBUNTU_APP_LAUNCH_XMIR_POOL");
+        auto direct = launches(self, count, pause);
+
+        setenv("UBUNTU_APP_LAUNCH_XMIR_POOL", "1", 1);
+        launches(self, 1, pause);
+        auto pooled = launches(self, count, pause);
+
+        std::cout << count << " launches, XMir startup " << startup * 1000 << "ms" << std::endl;
+        printResults("No pool", direct);
+        printResults("Pool   ", pooled);
+    }
+    catch (std::runtime_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
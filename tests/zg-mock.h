@@ -28,7 +28,8 @@ private:
     DbusTestDbusMockObject* zgobj = nullptr;
 
 public:
-    ZeitgeistMock()
+    /** \param findEvents Python that sets the 'ret' of FindEvents */
+    ZeitgeistMock(const std::string& findEvents = "ret = [ ]")
     {
         zgmock = dbus_test_dbus_mock_new("org.gnome.zeitgeist.Engine");
         dbus_test_task_set_name(DBUS_TEST_TASK(zgmock), "Zeitgeist");
@@ -38,6 +39,8 @@ public:
 
         dbus_test_dbus_mock_object_add_method(zgmock, zgobj, "InsertEvents", G_VARIANT_TYPE("a(asaasay)"),
                                               G_VARIANT_TYPE("au"), "ret = [ 0 ]", NULL);
+        dbus_test_dbus_mock_object_add_method(zgmock, zgobj, "FindEvents", G_VARIANT_TYPE("((xx)a(asaasay)uuu)"),
+                                              G_VARIANT_TYPE("a(asaasay)"), findEvents.c_str(), NULL);
     }
 
     ~ZeitgeistMock()
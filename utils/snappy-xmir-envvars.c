@@ -19,44 +19,70 @@
 
 #define _POSIX_C_SOURCE 200212L
 
+#include <errno.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <sys/wait.h>
 #include <signal.h>
 #include <string.h>
 
+#define ENV_COUNT 5
+
+/* Adds a variable to the frame, each one is sent as "name\0value\0" */
 void
-copyenv (int fd, const char * envname, const char * envval)
+copyenv (struct iovec * iov, uint32_t * framesize, const char * envname, const char * envval)
 {
 	if (envval == NULL) {
 		fprintf(stderr, "Unable to get environment variable '%s'\n", envname);
 		exit(EXIT_FAILURE);
 	}
 
-	int writesize;
-
-	writesize = write(fd, envname, strlen(envname) + 1);
-
-	if (writesize <= 0) {
-		fprintf(stderr, "Unable to write to socket '%s'\n", envname);
-		exit(EXIT_FAILURE);
-	}
-
-	writesize = write(fd, envval, strlen(envval) + 1);
+	iov[0].iov_base = (void *)envname;
+	iov[0].iov_len = strlen(envname) + 1;
+	iov[1].iov_base = (void *)envval;
+	iov[1].iov_len = strlen(envval) + 1;
 
-	if (writesize <= 0) {
-		fprintf(stderr, "Unable to write to socket '%s'\n", envval);
-		exit(EXIT_FAILURE);
-	}
+	*framesize += iov[0].iov_len + iov[1].iov_len;
 
 	if (getenv("G_MESSAGES_DEBUG") != NULL)
 		printf("Wrote envvar '%s=%s'\n", envname, envval);
 }
 
+/* Sends the length of the frame and then the frame with a single
+   writev(), only looping if the socket takes less than all of it */
+void
+sendframe (int fd, struct iovec * iov, int iovcnt)
+{
+	while (iovcnt > 0) {
+		ssize_t writesize = writev(fd, iov, iovcnt);
+
+		if (writesize <= 0) {
+			if (writesize < 0 && errno == EINTR)
+				continue;
+
+			fprintf(stderr, "Unable to write environment to socket: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		while (iovcnt > 0 && (size_t)writesize >= iov[0].iov_len) {
+			writesize -= iov[0].iov_len;
+			iov++;
+			iovcnt--;
+		}
+
+		if (iovcnt > 0) {
+			iov[0].iov_base = (char *)iov[0].iov_base + writesize;
+			iov[0].iov_len -= writesize;
+		}
+	}
+}
+
 void
 termhandler (int sig)
 {
@@ -90,17 +116,24 @@ main (int argc, char * argv[])
 		return EXIT_FAILURE;
 	}
 
-	/* Dump envvars to socket */
-	copyenv(socketfd, "DISPLAY", getenv("DISPLAY"));
-	copyenv(socketfd, "DBUS_SESSION_BUS_ADDRESS", getenv("DBUS_SESSION_BUS_ADDRESS"));
+	/* Dump envvars to socket, the frame starts with its length */
+	uint32_t framesize = 0;
+	struct iovec iov[1 + ENV_COUNT * 2];
+	iov[0].iov_base = &framesize;
+	iov[0].iov_len = sizeof(framesize);
+
+	copyenv(&iov[1], &framesize, "DISPLAY", getenv("DISPLAY"));
+	copyenv(&iov[3], &framesize, "DBUS_SESSION_BUS_ADDRESS", getenv("DBUS_SESSION_BUS_ADDRESS"));
 
 	char mypid[16];
 	snprintf(mypid, 16, "%ld", (long)getpid());
-	copyenv(socketfd, "UBUNTU_APP_LAUNCH_SNAPPY_XMIR_ENVVARS_PID", mypid);
+	copyenv(&iov[5], &framesize, "UBUNTU_APP_LAUNCH_SNAPPY_XMIR_ENVVARS_PID", mypid);
 
 	/* TODO: See xmir-helper */
-	copyenv(socketfd, "GDK_BACKEND", getenv("GDK_BACKEND"));
-	copyenv(socketfd, "QT_QPA_PLATFORM", getenv("QT_QPA_PLATFORM"));
+	copyenv(&iov[7], &framesize, "GDK_BACKEND", getenv("GDK_BACKEND"));
+	copyenv(&iov[9], &framesize, "QT_QPA_PLATFORM", getenv("QT_QPA_PLATFORM"));
+
+	sendframe(socketfd, iov, 1 + ENV_COUNT * 2);
 
 	/* Close the socket */
 	close(socketfd);
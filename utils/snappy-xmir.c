@@ -20,6 +20,7 @@
 #define _POSIX_C_SOURCE 200212L
 
 #include <errno.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,9 +32,9 @@
 #include <fcntl.h>
 #include <time.h>
 
-#define ENVVAR_SIZE 4096
 #define SOCKETNAME_SIZE 256
-#define ENVNAME_SIZE 64
+/* Far more than the handful of variables snappy-xmir-envvars sends */
+#define FRAMESIZE_MAX (64 * 1024)
 
 void
 sigchild_handler (int signal)
@@ -47,6 +48,101 @@ struct sigaction sigchild_action = {
 	.sa_flags = SA_NOCLDWAIT
 };
 
+/* Reads exactly size bytes, the other side closing early is an error */
+int
+readall (int fd, void * buf, size_t size)
+{
+	size_t amountread = 0;
+
+	while (amountread < size) {
+		ssize_t thisread = read(fd, (char *)buf + amountread, size - amountread);
+
+		if (thisread < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (thisread <= 0) {
+			if (thisread < 0) {
+				fprintf(stderr, "Unable to read from socket: %s\n", strerror(errno));
+			}
+			return -1;
+		}
+
+		amountread += thisread;
+	}
+
+	return 0;
+}
+
+/* Turns the "name\0value\0" pairs of the frame into "name=value"
+   in place and builds the environment out of them and ours */
+char **
+buildenv (char * frame, uint32_t framesize, int debug)
+{
+	unsigned int framecnt = 0;
+	char * framevar;
+	for (framevar = frame; framevar < frame + framesize; framevar += strlen(framevar) + 1) {
+		framecnt++;
+	}
+
+	unsigned int envcnt = 0;
+	while (__environ[envcnt] != NULL) {
+		envcnt++;
+	}
+
+	char ** newenv = calloc(envcnt + framecnt / 2 + 1, sizeof(char *));
+	size_t * namelens = calloc(framecnt / 2 + 1, sizeof(size_t));
+	if (newenv == NULL || namelens == NULL) {
+		fprintf(stderr, "Unable to allocate the environment\n");
+		exit(EXIT_FAILURE);
+	}
+
+	unsigned int newcnt = 0;
+	unsigned int varcnt = 0;
+	framevar = frame;
+	while (varcnt < framecnt / 2) {
+		size_t namelen = strlen(framevar);
+		char * value = framevar + namelen + 1;
+
+		if (debug) {
+			printf("Got env: %s=%s\n", framevar, value);
+		}
+
+		framevar[namelen] = '=';
+		namelens[varcnt++] = namelen;
+		newenv[newcnt++] = framevar;
+
+		framevar = value + strlen(value) + 1;
+	}
+
+	unsigned int i;
+	for (i = 0; i < envcnt; i++) {
+		const char * env = __environ[i];
+
+		/* Not checking the length becasue imagining that block
+		   size will always be larger than 4 bytes on 32-bit systems.
+		   Compiler should fold this into one comparison. */
+		if (env[0] == 'M' && env[1] == 'I' && env[2] == 'R' && env[3] == '_') {
+			continue;
+		}
+
+		unsigned int j;
+		for (j = 0; j < varcnt; j++) {
+			if (strncmp(env, newenv[j], namelens[j] + 1) == 0) {
+				break;
+			}
+		}
+
+		if (j == varcnt) {
+			newenv[newcnt++] = (char *)env;
+		}
+	}
+
+	free(namelens);
+
+	return newenv;
+}
+
 int
 main (int argc, char * argv[])
 {
@@ -79,6 +175,9 @@ main (int argc, char * argv[])
 		return EXIT_FAILURE;
 	}
 
+	/* Listen before the child can try to connect */
+	listen(socketfd, 1); /* 1 is the number of people who can connect */
+
 	/* Fork and exec the x11 setup under it's confiment */
 	if (sigaction(SIGCHLD, &sigchild_action, NULL) != 0) {
 		fprintf(stderr, "Unable to setup child signal handler\n");
@@ -119,94 +218,52 @@ main (int argc, char * argv[])
 		return execv(xmirexec[0], xmirexec);
 	}
 
-	listen(socketfd, 1); /* 1 is the number of people who can connect */
 	int readsocket = accept(socketfd, NULL, NULL);
 
 	if (getenv("G_MESSAGES_DEBUG") != NULL) {
 		printf("Got a socket connection on: %s\n", socketname);
 	}
 
-	/* Read our socket until we get all of the environment */
-	char readbuf[ENVVAR_SIZE] = {0};
-	int amountread = 0;
-	int thisread = 0;
-	while ((thisread = read(readsocket, readbuf + amountread, ENVVAR_SIZE - amountread)) > 0) {
-		amountread += thisread;
-
-		if (amountread == ENVVAR_SIZE) {
-			fprintf(stderr, "Environment is too large, abort!\n");
-			exit(EXIT_FAILURE);
-		}
+	/* Read the length of the environment frame and then all of it */
+	uint32_t framesize = 0;
+	if (readall(readsocket, &framesize, sizeof(framesize)) != 0) {
+		fprintf(stderr, "Error reading environment size from Xmir utilities\n");
+		exit(EXIT_FAILURE);
 	}
 
-	if (thisread < 0) {
-		fprintf(stderr, "Error reading environment variables from Xmir utilities: %s", strerror(errno));
+	if (framesize > FRAMESIZE_MAX) {
+		fprintf(stderr, "Environment frame of %u bytes is larger than the %d byte limit\n", framesize, FRAMESIZE_MAX);
 		exit(EXIT_FAILURE);
 	}
 
-	close(readsocket);
-	close(socketfd);
-
-	/* Parse the environment into variables we can insert */
-	if (amountread > 0) {
-		char * startvar = readbuf;
-		int debug = (getenv("G_MESSAGES_DEBUG") != NULL);
+	char * frame = malloc((size_t)framesize + 1);
+	if (frame == NULL) {
+		fprintf(stderr, "Unable to allocate %u bytes for the environment\n", framesize);
+		exit(EXIT_FAILURE);
+	}
 
-		do {
-			char * startval = startvar + strlen(startvar) + 1;
-			setenv(startvar, startval, 1);
+	if (readall(readsocket, frame, framesize) != 0) {
+		fprintf(stderr, "Error reading environment variables from Xmir utilities\n");
+		exit(EXIT_FAILURE);
+	}
+	frame[framesize] = '\0';
 
-			if (debug) {
-				printf("Got env: %s=%s\n", startvar, startval);
-			}
+	/* Every variable ends in a NUL, anything else would have buildenv()
+	   reading past the end of the frame */
+	if (framesize > 0 && frame[framesize - 1] != '\0') {
+		fprintf(stderr, "Environment frame from Xmir utilities is not terminated\n");
+		exit(EXIT_FAILURE);
+	}
 
-			startvar = startval + strlen(startval) + 1;
-		}
-		while (startvar < readbuf + amountread);
-	}
-
-	/* Clear MIR_* variables from the environment */
-	/* Unfortunately calling unsetenv resets the environ array so
-	   it can become invalid. So we need to start over, though this
-	   is fast */
-	int unset = 1;
-	while (unset) {
-		unset = 0;
-
-		unsigned int i;
-		for (i = 0; __environ[i] != NULL; i++) {
-			const char * env = __environ[i];
-			/* Not checking the length becasue imagining that block
-			   size will always be larger than 4 bytes on 32-bit systems.
-			   Compiler should fold this into one comparison. */
-			if (env[0] == 'M' && env[1] == 'I' && env[2] == 'R' && env[3] == '_') {
-				char envname[ENVNAME_SIZE] = {0};
-				unset = 1;
-
-				strncpy(envname, env, ENVNAME_SIZE - 1);
-				unsigned int j;
-				for (j = 0; j < ENVNAME_SIZE && envname[j] != '\0'; j++) {
-					if (envname[j] == '=') {
-						envname[j] = '\0';
-
-						if (unsetenv(envname) != 0) {
-							/* Shouldn't happen unless we're out of memory,
-							   might as well bail now if that's the case. */
-							fprintf(stderr, "Unable to unset '%s' environment variable\n", envname);
-							exit(EXIT_FAILURE);
-						}
-
-						break;
-					}
-				}
+	close(readsocket);
+	close(socketfd);
 
-				break;
-			}
-		}
-	}
+	/* Build the application's environment in one pass, dropping the
+	   MIR_* variables and the ones we got a new value for */
+	char ** newenv = buildenv(frame, framesize, getenv("G_MESSAGES_DEBUG") != NULL);
 
 	fflush(stdout);
 
 	/* Exec the application with the new environment under its confinement */
-	return execv(argv[2], &(argv[2]));
+	return execve(argv[2], &(argv[2]), newenv);
 }
@@ -17,10 +17,10 @@
  *     Ted Gould <ted.gould@canonical.com>
  */
 
-#define _POSIX_C_SOURCE 200212L
-#define _XOPEN_SOURCE 700
+#define _GNU_SOURCE
 
 #include <errno.h>
+#include <poll.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -37,6 +37,8 @@
 #define PARAMS_COUNT 32
 #define SOCKETNAME_SIZE 256
 #define ENVNAME_SIZE 64
+#define PARK_HEADER "URLS"
+#define PARK_TIMEOUT_DEFAULT 600
 
 void
 sigchild_handler (int signal, siginfo_t * sigdata, void * data)
@@ -156,6 +158,93 @@ get_params (char * readbuf, char ** exectool)
 	return amountread;
 }
 
+/* When we're started for the helper pool we listen on an abstract socket
+   before running the exec-tool, so the library can connect as soon as
+   the unit is up and its message just waits in the backlog. */
+int
+park_open (const char * socketname)
+{
+	int parkfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (parkfd < 0) {
+		fprintf(stderr, "Unable to create park socket\n");
+		exit(EXIT_FAILURE);
+	}
+
+	struct sockaddr_un socketaddr = {0};
+	socketaddr.sun_family = AF_UNIX;
+	strncpy(socketaddr.sun_path, socketname, sizeof(socketaddr.sun_path) - 1);
+	socketaddr.sun_path[0] = 0;
+
+	if (bind(parkfd, (const struct sockaddr *)&socketaddr, sizeof(struct sockaddr_un)) < 0) {
+		fprintf(stderr, "Unable to bind park socket '%s'\n", socketname);
+		exit(EXIT_FAILURE);
+	}
+
+	listen(parkfd, 1);
+
+	return parkfd;
+}
+
+/* Wait for the library to claim us. It sends the header and then the
+   URLs, each one NUL terminated. Anything else, or nobody showing up
+   before the timeout, means we're not needed and should exit quietly. */
+int
+park_wait (int parkfd, char * urlbuf, char ** urls, int maxurls)
+{
+	int timeout = PARK_TIMEOUT_DEFAULT;
+	const char * timeoutenv = getenv("UBUNTU_APP_LAUNCH_HELPER_PARK_TIMEOUT");
+	if (timeoutenv != NULL) {
+		timeout = atoi(timeoutenv);
+	}
+
+	struct pollfd pollparked = { .fd = parkfd, .events = POLLIN };
+	if (poll(&pollparked, 1, timeout * 1000) <= 0) {
+		fprintf(stderr, "Parked helper was not claimed\n");
+		exit(EXIT_SUCCESS);
+	}
+
+	int readsocket = accept(parkfd, NULL, NULL);
+	close(parkfd);
+	if (readsocket < 0) {
+		fprintf(stderr, "Unable to accept on park socket\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Only our user gets to tell us what to open */
+	struct ucred cred = {0};
+	socklen_t credlen = sizeof(cred);
+	if (getsockopt(readsocket, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) != 0 || cred.uid != getuid()) {
+		fprintf(stderr, "Park socket connection from another user\n");
+		exit(EXIT_FAILURE);
+	}
+
+	int amountread = 0;
+	int thisread = 0;
+	while ((thisread = read(readsocket, urlbuf + amountread, PARAMS_SIZE - amountread)) > 0) {
+		amountread += thisread;
+
+		if (amountread == PARAMS_SIZE) {
+			fprintf(stderr, "URLs are too large, abort!\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	close(readsocket);
+
+	if (amountread < (int)sizeof(PARK_HEADER) || memcmp(urlbuf, PARK_HEADER, sizeof(PARK_HEADER)) != 0) {
+		fprintf(stderr, "Parked helper released\n");
+		exit(EXIT_SUCCESS);
+	}
+
+	int count = 0;
+	char * url = urlbuf + sizeof(PARK_HEADER);
+	while (url < urlbuf + amountread && count < maxurls) {
+		urls[count++] = url;
+		url = url + strlen(url) + 1;
+	}
+
+	return count;
+}
+
 int
 main (int argc, char * argv[])
 {
@@ -170,6 +259,12 @@ main (int argc, char * argv[])
 		printf("Getting parameters from exec-tool: %s\n", argv[1]);
 	}
 
+	int parkfd = -1;
+	const char * parkname = getenv("UBUNTU_APP_LAUNCH_HELPER_PARK_SOCKET");
+	if (parkname != NULL) {
+		parkfd = park_open(parkname);
+	}
+
 	char readbuf[PARAMS_SIZE] = {0};
 	int amountread = get_params(readbuf, &argv[1]);
 
@@ -228,6 +323,17 @@ main (int argc, char * argv[])
 		apparray[currentparam] = argv[currentargc];
 	}
 
+	/* Everything is ready, a parked helper gets its URLs now */
+	char urlbuf[PARAMS_SIZE] = {0};
+	if (parkfd >= 0) {
+		if (debug) {
+			printf("Parked on: %s\n", parkname);
+		}
+		fflush(stdout);
+
+		currentparam += park_wait(parkfd, urlbuf, &apparray[currentparam], PARAMS_COUNT - 1 - currentparam);
+	}
+
 	if (debug) {
 		printf("Exec:");
 		int i;
@@ -17,15 +17,28 @@
  *     Ted Gould <ted.gould@canonical.com>
  */
 
-#define _POSIX_C_SOURCE 200212L
+#define _GNU_SOURCE
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <signal.h>
 
+#define SOCKETNAME_SIZE 256
+#define CGROUP_PATH_SIZE 1024
+#define POOL_MAX 8
+#define POOL_CLAIMED_MAX 32
+#define POOL_TIMEOUT_DEFAULT 600
+
 void
 sigchild_handler (int signal)
 {
@@ -38,76 +51,562 @@ struct sigaction sigchild_action = {
 	.sa_flags = SA_NOCLDWAIT
 };
 
-int
-main (int argc, char * argv[])
+/* Forks off an XMir for the appid and returns its PID, the socket
+   it'll write the display number to is put in helpersocket */
+pid_t
+xmir_start (const char * xmir, const char * appid, int * helpersocket)
 {
-	if (argc < 3) {
-		fprintf(stderr, "xmir-helper needs more arguments: xmir-helper $(appid) $(thing to exec) ... \n");
-		return EXIT_FAILURE;
-	}
-
-	/* Make nice variables for the things we need */
-	char * appid = argv[1];
-	char * xmir = getenv("UBUNTU_APP_LAUNCH_XMIR_PATH");
-	if (xmir == NULL) {
-		xmir = "/usr/bin/Xmir";
-	}
-
 	/* Build a socket pair to get the connection back from XMir */
 	int sockets[2];
 	if (socketpair(AF_LOCAL, SOCK_STREAM, 0, sockets) != 0) {
 		fprintf(stderr, "Unable to create socketpair for communicating with XMir\n");
-		return EXIT_FAILURE;
+		return -1;
 	}
 
 	/* Give them nice names, the compiler will optimize out */
 	int xmirsocket = sockets[0];
-	int helpersocket = sockets[1];
+	*helpersocket = sockets[1];
+	fcntl(*helpersocket, F_SETFD, FD_CLOEXEC);
 
-	/* Watch for the child dying */
-	if (sigaction(SIGCHLD, &sigchild_action, NULL) != 0) {
-		fprintf(stderr, "Unable to setup child signal handler\n");
-		return EXIT_FAILURE;
-	}
-
-	/* Start XMir */
-	if (fork() == 0) {
+	pid_t pid = fork();
+	if (pid == 0) {
 		/* XMir start here */
 		/* GOAL: XMir -displayfd ${xmirsocket} -mir ${appid} */
 		char socketbuf[16] = {0};
 		snprintf(socketbuf, 16, "%d", xmirsocket);
 
 		char * xmirexec[6] = {
-			xmir,
+			(char *)xmir,
 			"-displayfd",
 			socketbuf,
 			"-mir",
-			appid,
+			(char *)appid,
 			NULL
 		};
 
 		printf("Executing XMir on PID: %d", getpid());
 
-		return execv(xmir, xmirexec);
+		execv(xmir, xmirexec);
+		exit(EXIT_FAILURE);
 	}
 
-	/* Wait to get the display number from XMir */
+	close(xmirsocket);
+
+	if (pid < 0) {
+		fprintf(stderr, "Unable to fork XMir\n");
+		close(*helpersocket);
+	}
+
+	return pid;
+}
+
+/* Get the display number from XMir and turn it into a DISPLAY value */
+int
+xmir_display (int helpersocket, char * display, size_t size)
+{
 	char readbuf[16] = {0};
-	if (read(helpersocket, readbuf, 16) == 0) {
-		fprintf(stderr, "Not reading anything from XMir\n");
-		return 1;
+	if (read(helpersocket, readbuf, sizeof(readbuf) - 1) <= 0) {
+		return -1;
+	}
+
+	readbuf[strcspn(readbuf, "\n")] = '\0';
+	snprintf(display, size, ":%s", readbuf);
+
+	return 0;
+}
+
+/* The pool for an appid is found on an abstract socket named after it */
+void
+pool_address (const char * appid, struct sockaddr_un * socketaddr)
+{
+	char socketname[SOCKETNAME_SIZE] = {0};
+	snprintf(socketname, sizeof(socketname), "/ual-xmir-pool-%s", appid);
+
+	memset(socketaddr, 0, sizeof(struct sockaddr_un));
+	socketaddr->sun_family = AF_UNIX;
+	strncpy(socketaddr->sun_path, socketname, sizeof(socketaddr->sun_path) - 1);
+	socketaddr->sun_path[0] = 0;
+}
+
+/* Both sides of the pool only talk to our own user */
+int
+pool_peer (int fd, struct ucred * cred)
+{
+	socklen_t credlen = sizeof(struct ucred);
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, cred, &credlen) != 0 || cred->uid != getuid()) {
+		fprintf(stderr, "XMir pool connection from another user\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Finds the cgroup that systemd tracks the process in, preferring the
+   named systemd hierarchy over the unified one on hybrid systems */
+int
+cgroup_path (pid_t pid, char * path, size_t size)
+{
+	char procpath[32] = {0};
+	snprintf(procpath, sizeof(procpath), "/proc/%d/cgroup", (int)pid);
+
+	FILE * file = fopen(procpath, "r");
+	if (file == NULL) {
+		return -1;
+	}
+
+	int found = -1;
+	char line[CGROUP_PATH_SIZE];
+	while (fgets(line, sizeof(line), file) != NULL) {
+		line[strcspn(line, "\n")] = '\0';
+
+		char * controllers = strchr(line, ':');
+		if (controllers == NULL) {
+			continue;
+		}
+		char * cgroup = strchr(controllers + 1, ':');
+		if (cgroup == NULL) {
+			continue;
+		}
+		*cgroup = '\0';
+		cgroup++;
+
+		if (strcmp(controllers + 1, "name=systemd") == 0) {
+			snprintf(path, size, "/sys/fs/cgroup/systemd%s", cgroup);
+			found = 0;
+			break;
+		}
+
+		if (controllers == line + 1 && line[0] == '0' && controllers[1] == '\0') {
+			snprintf(path, size, "/sys/fs/cgroup%s", cgroup);
+			found = 0;
+		}
+	}
+
+	fclose(file);
+	return found;
+}
+
+/* A pooled XMir was started in the cgroup of the pool, move it into
+   ours so that it lives and dies with the application it serves.
+   Returns -1 if it is still in the pool's cgroup. */
+int
+pool_adopt (pid_t xmirpid)
+{
+	char ours[CGROUP_PATH_SIZE] = {0};
+	char theirs[CGROUP_PATH_SIZE] = {0};
+
+	if (cgroup_path(getpid(), ours, sizeof(ours)) != 0 || cgroup_path(xmirpid, theirs, sizeof(theirs)) != 0) {
+		fprintf(stderr, "Unable to find the cgroup of pooled XMir %d\n", (int)xmirpid);
+		return -1;
+	}
+
+	if (strcmp(ours, theirs) == 0) {
+		return 0;
+	}
+
+	char procs[CGROUP_PATH_SIZE + 16] = {0};
+	snprintf(procs, sizeof(procs), "%s/cgroup.procs", ours);
+
+	FILE * file = fopen(procs, "w");
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open '%s': %s\n", procs, strerror(errno));
+		return -1;
+	}
+
+	fprintf(file, "%d\n", (int)xmirpid);
+	if (fclose(file) != 0) {
+		fprintf(stderr, "Unable to move pooled XMir %d to '%s': %s\n", (int)xmirpid, procs, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Ask the pool for a running XMir, on success the DISPLAY for it is
+   put in display. Any failure just means we start our own. */
+int
+pool_claim (const char * appid, char * display, size_t size)
+{
+	int socketfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (socketfd < 0) {
+		return -1;
+	}
+
+	struct sockaddr_un socketaddr;
+	pool_address(appid, &socketaddr);
+
+	struct ucred cred = {0};
+	if (connect(socketfd, (const struct sockaddr *)&socketaddr, sizeof(struct sockaddr_un)) < 0 ||
+			pool_peer(socketfd, &cred) != 0 ||
+			write(socketfd, appid, strlen(appid) + 1) <= 0) {
+		close(socketfd);
+		return -1;
+	}
+
+	/* Reply is "display\npid\n", empty when nothing is ready */
+	char readbuf[64] = {0};
+	int amountread = 0;
+	int thisread = 0;
+	while ((thisread = read(socketfd, readbuf + amountread, sizeof(readbuf) - 1 - amountread)) > 0) {
+		amountread += thisread;
+	}
+	close(socketfd);
+
+	char displaynumber[16] = {0};
+	int xmirpid = 0;
+	if (sscanf(readbuf, "%15[^\n]\n%d", displaynumber, &xmirpid) != 2 || xmirpid <= 0) {
+		return -1;
+	}
+
+	/* Left in the pool's cgroup it would be stopped with the pool's
+	   unit instead of ours, so give it back and start our own */
+	if (pool_adopt(xmirpid) != 0) {
+		fprintf(stderr, "Not using pooled XMir %d, starting our own\n", xmirpid);
+		kill(xmirpid, SIGTERM);
+		return -1;
+	}
+
+	snprintf(display, size, ":%s", displaynumber);
+
+	return 0;
+}
+
+enum pool_state {
+	POOL_FREE,
+	POOL_STARTING,
+	POOL_READY
+};
+
+struct pool_server {
+	enum pool_state state;
+	pid_t pid;
+	int fd;
+	char display[16];
+};
+
+struct pool_claimed {
+	pid_t xmir;
+	pid_t client;
+};
+
+/* Hands a ready XMir to the connection, or closes it without an answer */
+void
+pool_serve (int clientfd, const char * appid, struct pool_server * servers, int size,
+            struct pool_claimed * claimed, int * claimedcnt)
+{
+	struct ucred cred = {0};
+	if (pool_peer(clientfd, &cred) != 0) {
+		return;
+	}
+
+	char readbuf[SOCKETNAME_SIZE] = {0};
+	int amountread = 0;
+	int thisread = 0;
+	while (memchr(readbuf, '\0', amountread) == NULL &&
+			(thisread = read(clientfd, readbuf + amountread, sizeof(readbuf) - amountread)) > 0) {
+		amountread += thisread;
+	}
+
+	if (memchr(readbuf, '\0', amountread) == NULL || strcmp(readbuf, appid) != 0) {
+		fprintf(stderr, "XMir pool for '%s' asked for another application\n", appid);
+		return;
+	}
+
+	int i;
+	for (i = 0; i < size; i++) {
+		if (servers[i].state == POOL_READY) {
+			break;
+		}
+	}
+
+	if (i == size || *claimedcnt == POOL_CLAIMED_MAX) {
+		return;
+	}
+
+	char reply[64] = {0};
+	int replylen = snprintf(reply, sizeof(reply), "%s\n%d\n", servers[i].display + 1, (int)servers[i].pid);
+	if (send(clientfd, reply, replylen, MSG_NOSIGNAL) != replylen) {
+		return;
+	}
+
+	claimed[*claimedcnt].xmir = servers[i].pid;
+	claimed[*claimedcnt].client = cred.pid;
+	(*claimedcnt)++;
+
+	close(servers[i].fd);
+	servers[i].state = POOL_FREE;
+}
+
+/* Set when the unit the pool runs in is stopped */
+volatile sig_atomic_t pool_stopping = 0;
+
+void
+pool_stop_handler (int signal)
+{
+	pool_stopping = 1;
+}
+
+/* Keeps size XMir servers running for the appid until nobody has
+   asked for one in the timeout, or the unit we're in is stopped.
+   Servers that were handed out are watched so that they're cleaned
+   up when their application exits. */
+void
+pool_run (const char * appid, const char * xmir, int size)
+{
+	/* Stopping our unit sends us SIGTERM, no SA_RESTART so that it
+	   interrupts the poll */
+	struct sigaction stopaction = {
+		.sa_handler = pool_stop_handler
+	};
+	sigaction(SIGTERM, &stopaction, NULL);
+	sigaction(SIGINT, &stopaction, NULL);
+
+	int listenfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listenfd < 0) {
+		return;
+	}
+
+	struct sockaddr_un socketaddr;
+	pool_address(appid, &socketaddr);
+
+	/* Someone else already has a pool running */
+	if (bind(listenfd, (const struct sockaddr *)&socketaddr, sizeof(struct sockaddr_un)) < 0) {
+		close(listenfd);
+		return;
+	}
+
+	listen(listenfd, POOL_MAX);
+
+	int timeout = POOL_TIMEOUT_DEFAULT;
+	const char * timeoutenv = getenv("UBUNTU_APP_LAUNCH_XMIR_POOL_TIMEOUT");
+	if (timeoutenv != NULL) {
+		timeout = atoi(timeoutenv);
 	}
 
+	struct pool_server servers[POOL_MAX] = {{0}};
+	struct pool_claimed claimed[POOL_CLAIMED_MAX] = {{0}};
+	int claimedcnt = 0;
+	time_t lastclaim = time(NULL);
+	int failed = 0;
 	int i;
-	for (i = 0; i < sizeof(readbuf); i++) {
-		if (readbuf[i] == '\n') {
-			readbuf[i] = '\0';
+
+	for (;;) {
+		/* Reap whatever exited, handed out or not */
+		pid_t reaped;
+		while ((reaped = waitpid(-1, NULL, WNOHANG)) > 0) {
+			for (i = 0; i < size; i++) {
+				if (servers[i].state != POOL_FREE && servers[i].pid == reaped) {
+					close(servers[i].fd);
+					servers[i].state = POOL_FREE;
+				}
+			}
+			for (i = 0; i < claimedcnt; i++) {
+				if (claimed[i].xmir == reaped) {
+					claimed[i--] = claimed[--claimedcnt];
+				}
+			}
+		}
+
+		/* Applications that are gone don't need their XMir */
+		for (i = 0; i < claimedcnt; i++) {
+			if (claimed[i].client != 0 && kill(claimed[i].client, 0) != 0 && errno == ESRCH) {
+				kill(claimed[i].xmir, SIGTERM);
+				claimed[i].client = 0;
+			}
+		}
+
+		if (pool_stopping) {
 			break;
 		}
+
+		if (claimedcnt == 0 && (failed || time(NULL) - lastclaim > timeout)) {
+			break;
+		}
+
+		/* Refill, unless XMir is failing on us */
+		for (i = 0; i < size && !failed; i++) {
+			if (servers[i].state == POOL_FREE) {
+				servers[i].pid = xmir_start(xmir, appid, &servers[i].fd);
+				if (servers[i].pid > 0) {
+					servers[i].state = POOL_STARTING;
+				}
+			}
+		}
+
+		struct pollfd pollfds[POOL_MAX + 1];
+		int starting[POOL_MAX];
+		int pollcnt = 0;
+
+		pollfds[pollcnt].fd = listenfd;
+		pollfds[pollcnt].events = POLLIN;
+		pollcnt++;
+
+		for (i = 0; i < size; i++) {
+			if (servers[i].state == POOL_STARTING) {
+				starting[pollcnt - 1] = i;
+				pollfds[pollcnt].fd = servers[i].fd;
+				pollfds[pollcnt].events = POLLIN;
+				pollcnt++;
+			}
+		}
+
+		if (poll(pollfds, pollcnt, 1000) <= 0) {
+			continue;
+		}
+
+		int j;
+		for (j = 1; j < pollcnt; j++) {
+			if (pollfds[j].revents == 0) {
+				continue;
+			}
+
+			struct pool_server * server = &servers[starting[j - 1]];
+			if (xmir_display(server->fd, server->display, sizeof(server->display)) == 0) {
+				server->state = POOL_READY;
+			} else {
+				fprintf(stderr, "Pooled XMir %d failed to start\n", (int)server->pid);
+				kill(server->pid, SIGTERM);
+				failed = 1;
+			}
+		}
+
+		if (pollfds[0].revents & POLLIN) {
+			int clientfd = accept4(listenfd, NULL, NULL, SOCK_CLOEXEC);
+			if (clientfd >= 0) {
+				pool_serve(clientfd, appid, servers, size, claimed, &claimedcnt);
+				close(clientfd);
+				lastclaim = time(NULL);
+			}
+		}
+	}
+
+	/* Nobody can ask for one of the servers we're stopping */
+	close(listenfd);
+
+	for (i = 0; i < size; i++) {
+		if (servers[i].state != POOL_FREE) {
+			kill(servers[i].pid, SIGTERM);
+		}
+	}
+
+	/* Give them a second to go before making sure they do */
+	int tries;
+	for (tries = 0; tries < 10; tries++) {
+		int remaining = 0;
+		for (i = 0; i < size; i++) {
+			if (servers[i].state == POOL_FREE) {
+				continue;
+			}
+
+			if (waitpid(servers[i].pid, NULL, WNOHANG) != 0) {
+				close(servers[i].fd);
+				servers[i].state = POOL_FREE;
+			} else {
+				remaining++;
+			}
+		}
+
+		if (remaining == 0) {
+			break;
+		}
+
+		usleep(100000);
+	}
+
+	for (i = 0; i < size; i++) {
+		if (servers[i].state != POOL_FREE) {
+			kill(servers[i].pid, SIGKILL);
+			waitpid(servers[i].pid, NULL, 0);
+			close(servers[i].fd);
+			servers[i].state = POOL_FREE;
+		}
+	}
+}
+
+/* Starts the pool as a daemon that we don't have to wait on */
+void
+pool_spawn (const char * appid, const char * xmir, int size)
+{
+	pid_t pid = fork();
+	if (pid == 0) {
+		if (fork() == 0) {
+			setsid();
+
+			/* Don't hold onto the output of the application */
+			int devnull = open("/dev/null", O_RDONLY);
+			if (devnull >= 0) {
+				dup2(devnull, STDIN_FILENO);
+				close(devnull);
+			}
+			dup2(STDERR_FILENO, STDOUT_FILENO);
+
+			pool_run(appid, xmir, size);
+			exit(EXIT_SUCCESS);
+		}
+
+		_exit(EXIT_SUCCESS);
+	}
+
+	if (pid > 0) {
+		waitpid(pid, NULL, 0);
+	}
+}
+
+int
+main (int argc, char * argv[])
+{
+	if (argc < 3) {
+		fprintf(stderr, "xmir-helper needs more arguments: xmir-helper $(appid) $(thing to exec) ... \n");
+		return EXIT_FAILURE;
+	}
+
+	/* Make nice variables for the things we need */
+	char * appid = argv[1];
+	char * xmir = getenv("UBUNTU_APP_LAUNCH_XMIR_PATH");
+	if (xmir == NULL) {
+		xmir = "/usr/bin/Xmir";
+	}
+
+	int poolsize = 0;
+	char * poolenv = getenv("UBUNTU_APP_LAUNCH_XMIR_POOL");
+	if (poolenv != NULL) {
+		poolsize = atoi(poolenv);
+		if (poolsize > POOL_MAX) {
+			poolsize = POOL_MAX;
+		}
 	}
 
 	char displaynumber[16] = {0};
-	snprintf(displaynumber, 16, ":%s", readbuf);
+
+	if (poolsize > 0 && pool_claim(appid, displaynumber, sizeof(displaynumber)) == 0) {
+		if (getenv("G_MESSAGES_DEBUG") != NULL) {
+			printf("Using pooled XMir on display: %s\n", displaynumber);
+		}
+	} else {
+		/* The pool runs in our cgroup so that its servers are trusted as
+		   this application, the next instance gets one of them */
+		if (poolsize > 0) {
+			pool_spawn(appid, xmir, poolsize);
+		}
+
+		/* Watch for the child dying */
+		if (sigaction(SIGCHLD, &sigchild_action, NULL) != 0) {
+			fprintf(stderr, "Unable to setup child signal handler\n");
+			return EXIT_FAILURE;
+		}
+
+		/* Start XMir */
+		int helpersocket;
+		if (xmir_start(xmir, appid, &helpersocket) < 0) {
+			return EXIT_FAILURE;
+		}
+
+		/* Wait to get the display number from XMir */
+		if (xmir_display(helpersocket, displaynumber, sizeof(displaynumber)) != 0) {
+			fprintf(stderr, "Not reading anything from XMir\n");
+			return 1;
+		}
+	}
 
 	/* Set up the display variable */
 	setenv("DISPLAY", displaynumber, 1);